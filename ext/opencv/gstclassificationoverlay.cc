@@ -121,6 +121,10 @@ gst_classification_overlay_process_meta (GstInferenceOverlay *
   /* Get the most probable label */
   index = 0;
   max = -1;
+  if (class_meta->num_top != 0) {
+    index = class_meta->top[0].label;
+    max = class_meta->top[0].prob;
+  }
   for (i = 0; i < class_meta->num_labels; ++i) {
     current = class_meta->label_probs[i];
     if (current > max) {
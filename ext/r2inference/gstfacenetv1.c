@@ -50,6 +50,9 @@ GST_DEBUG_CATEGORY_STATIC (gst_facenetv1_debug_category);
 #define GST_CAT_DEFAULT gst_facenetv1_debug_category
 
 #define MODEL_CHANNELS 3
+#define MODEL_WIDTH 160
+#define MODEL_HEIGHT 160
+#define MODEL_LAYOUT GST_INFERENCE_TENSOR_LAYOUT_NHWC
 
 /* prototypes */
 static void gst_facenetv1_set_property (GObject * object,
@@ -74,7 +77,8 @@ enum
 
 /* pad templates */
 
-#define CAPS "video/x-raw,format=RGB,width=160,height=160"
+#define CAPS "video/x-raw,format={RGB, NV12, I420, YUY2},width=" \
+  GST_VIDEO_SIZE_RANGE ",height=" GST_VIDEO_SIZE_RANGE
 
 static GstStaticPadTemplate sink_model_factory =
 GST_STATIC_PAD_TEMPLATE ("sink_model",
@@ -90,6 +94,20 @@ GST_STATIC_PAD_TEMPLATE ("src_model",
     GST_STATIC_CAPS (CAPS)
     );
 
+static GstStaticPadTemplate sink_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("sink_model_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
+static GstStaticPadTemplate src_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("src_model_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
 struct _GstFacenetv1
 {
   GstVideoInference parent;
@@ -117,6 +135,10 @@ gst_facenetv1_class_init (GstFacenetv1Class * klass)
   gst_element_class_add_static_pad_template (element_class,
       &sink_model_factory);
   gst_element_class_add_static_pad_template (element_class, &src_model_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &sink_model_stream_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &src_model_stream_factory);
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "facenetv1", "Filter",
@@ -135,6 +157,10 @@ gst_facenetv1_class_init (GstFacenetv1Class * klass)
   vi_class->preprocess = GST_DEBUG_FUNCPTR (gst_facenetv1_preprocess);
   vi_class->postprocess = GST_DEBUG_FUNCPTR (gst_facenetv1_postprocess);
   vi_class->inference_meta_info = gst_classification_meta_get_info ();
+  vi_class->model_channels = MODEL_CHANNELS;
+  vi_class->model_width = MODEL_WIDTH;
+  vi_class->model_height = MODEL_HEIGHT;
+  vi_class->tensor_layout = MODEL_LAYOUT;
 }
 
 static void
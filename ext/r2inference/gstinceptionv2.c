@@ -53,6 +53,14 @@ GST_DEBUG_CATEGORY_STATIC (gst_inceptionv2_debug_category);
 #define MEAN 128.0
 #define STD 1/128.0
 #define MODEL_CHANNELS 3
+#define MODEL_WIDTH 224
+#define MODEL_HEIGHT 224
+#define MODEL_LAYOUT GST_INFERENCE_TENSOR_LAYOUT_NHWC
+
+/* Most probable labels kept in the meta, 0 keeps all of them */
+#define MIN_TOP_K 0
+#define MAX_TOP_K GST_CLASSIFICATION_META_MAX_TOP
+#define DEFAULT_TOP_K 0
 
 /* prototypes */
 static void gst_inceptionv2_set_property (GObject * object,
@@ -72,15 +80,17 @@ static gboolean gst_inceptionv2_stop (GstVideoInference * vi);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_TOP_K
 };
 
 /* pad templates */
 #define CAPS								\
   "video/x-raw, "							\
-  "width=224, "							\
-  "height=224, "							\
-  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR}"
+  "width=" GST_VIDEO_SIZE_RANGE ", "					\
+  "height=" GST_VIDEO_SIZE_RANGE ", "					\
+  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR, "	\
+  "NV12, I420, YUY2}"
 
 static GstStaticPadTemplate sink_model_factory =
 GST_STATIC_PAD_TEMPLATE ("sink_model",
@@ -96,9 +106,27 @@ GST_STATIC_PAD_TEMPLATE ("src_model",
     GST_STATIC_CAPS (CAPS)
     );
 
+static GstStaticPadTemplate sink_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("sink_model_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
+static GstStaticPadTemplate src_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("src_model_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
 struct _GstInceptionv2
 {
   GstVideoInference parent;
+
+  GstNormalizeLut *lut;
+
+  gint top_k;
 };
 
 struct _GstInceptionv2Class
@@ -123,6 +151,10 @@ gst_inceptionv2_class_init (GstInceptionv2Class * klass)
   gst_element_class_add_static_pad_template (element_class,
       &sink_model_factory);
   gst_element_class_add_static_pad_template (element_class, &src_model_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &sink_model_stream_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &src_model_stream_factory);
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "inceptionv2", "Filter",
@@ -136,16 +168,27 @@ gst_inceptionv2_class_init (GstInceptionv2Class * klass)
   gobject_class->dispose = gst_inceptionv2_dispose;
   gobject_class->finalize = gst_inceptionv2_finalize;
 
+  g_object_class_install_property (gobject_class, PROP_TOP_K,
+      g_param_spec_int ("top-k", "Top K",
+          "Most probable labels to keep in the meta, 0 keeps the "
+          "probability of every label", MIN_TOP_K, MAX_TOP_K,
+          DEFAULT_TOP_K, G_PARAM_READWRITE));
+
   vi_class->start = GST_DEBUG_FUNCPTR (gst_inceptionv2_start);
   vi_class->stop = GST_DEBUG_FUNCPTR (gst_inceptionv2_stop);
   vi_class->preprocess = GST_DEBUG_FUNCPTR (gst_inceptionv2_preprocess);
   vi_class->postprocess = GST_DEBUG_FUNCPTR (gst_inceptionv2_postprocess);
   vi_class->inference_meta_info = gst_classification_meta_get_info ();
+  vi_class->model_channels = MODEL_CHANNELS;
+  vi_class->model_width = MODEL_WIDTH;
+  vi_class->model_height = MODEL_HEIGHT;
+  vi_class->tensor_layout = MODEL_LAYOUT;
 }
 
 static void
 gst_inceptionv2_init (GstInceptionv2 * inceptionv2)
 {
+  inceptionv2->top_k = DEFAULT_TOP_K;
 }
 
 void
@@ -157,6 +200,10 @@ gst_inceptionv2_set_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (inceptionv2, "set_property");
 
   switch (property_id) {
+    case PROP_TOP_K:
+      inceptionv2->top_k = g_value_get_int (value);
+      GST_DEBUG_OBJECT (inceptionv2, "Changed top k to %d", inceptionv2->top_k);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -172,6 +219,9 @@ gst_inceptionv2_get_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (inceptionv2, "get_property");
 
   switch (property_id) {
+    case PROP_TOP_K:
+      g_value_set_int (value, inceptionv2->top_k);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -206,8 +256,11 @@ static gboolean
 gst_inceptionv2_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe)
 {
+  GstInceptionv2 *inceptionv2 = GST_INCEPTIONV2 (vi);
+
   GST_LOG_OBJECT (vi, "Preprocess");
-  return gst_normalize (inframe, outframe, MEAN, STD, MODEL_CHANNELS);
+  return gst_normalize_with_lut (inframe, outframe, inceptionv2->lut,
+      MODEL_CHANNELS);
 }
 
 static gboolean
@@ -219,7 +272,8 @@ gst_inceptionv2_postprocess (GstVideoInference * vi, const gpointer prediction,
   GstDebugLevel gst_debug_level = GST_LEVEL_LOG;
   GST_LOG_OBJECT (vi, "Postprocess");
 
-  gst_fill_classification_meta (class_meta, prediction, predsize);
+  gst_fill_classification_meta_top_k (class_meta, prediction, predsize,
+      GST_INCEPTIONV2 (vi)->top_k);
 
   gst_inference_print_highest_probability (vi, gst_inceptionv2_debug_category,
       class_meta, prediction, gst_debug_level);
@@ -231,15 +285,26 @@ gst_inceptionv2_postprocess (GstVideoInference * vi, const gpointer prediction,
 static gboolean
 gst_inceptionv2_start (GstVideoInference * vi)
 {
+  GstInceptionv2 *inceptionv2 = GST_INCEPTIONV2 (vi);
+
   GST_INFO_OBJECT (vi, "Starting Inception v2");
 
+  inceptionv2->lut = gst_normalize_lut_get (MEAN, MEAN, MEAN, STD, STD, STD);
+
   return TRUE;
 }
 
 static gboolean
 gst_inceptionv2_stop (GstVideoInference * vi)
 {
+  GstInceptionv2 *inceptionv2 = GST_INCEPTIONV2 (vi);
+
   GST_INFO_OBJECT (vi, "Stopping Inception v2");
 
+  if (inceptionv2->lut) {
+    gst_normalize_lut_unref (inceptionv2->lut);
+    inceptionv2->lut = NULL;
+  }
+
   return TRUE;
 }
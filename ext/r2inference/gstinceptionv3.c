@@ -52,7 +52,19 @@ GST_DEBUG_CATEGORY_STATIC (gst_inceptionv3_debug_category);
 #define MEAN 128.0
 #define STD 1/128.0
 #define MODEL_CHANNELS 3
+#define MODEL_WIDTH 299
+#define MODEL_HEIGHT 299
+#define MODEL_LAYOUT GST_INFERENCE_TENSOR_LAYOUT_NHWC
 
+/* Most probable labels kept in the meta, 0 keeps all of them */
+#define MIN_TOP_K 0
+#define MAX_TOP_K GST_CLASSIFICATION_META_MAX_TOP
+#define DEFAULT_TOP_K 0
+
+static void gst_inceptionv3_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_inceptionv3_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
 static gboolean gst_inceptionv3_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe);
 static gboolean gst_inceptionv3_postprocess (GstVideoInference * vi,
@@ -63,15 +75,17 @@ static gboolean gst_inceptionv3_stop (GstVideoInference * vi);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_TOP_K
 };
 
 /* pad templates */
 #define CAPS								\
   "video/x-raw, "							\
-  "width=299, "							\
-  "height=299, "							\
-  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR}"
+  "width=" GST_VIDEO_SIZE_RANGE ", "					\
+  "height=" GST_VIDEO_SIZE_RANGE ", "					\
+  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR, "	\
+  "NV12, I420, YUY2}"
 
 static GstStaticPadTemplate sink_model_factory =
 GST_STATIC_PAD_TEMPLATE ("sink_model",
@@ -87,9 +101,27 @@ GST_STATIC_PAD_TEMPLATE ("src_model",
     GST_STATIC_CAPS (CAPS)
     );
 
+static GstStaticPadTemplate sink_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("sink_model_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
+static GstStaticPadTemplate src_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("src_model_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
 struct _GstInceptionv3
 {
   GstVideoInference parent;
+
+  GstNormalizeLut *lut;
+
+  gint top_k;
 };
 
 struct _GstInceptionv3Class
@@ -107,12 +139,17 @@ G_DEFINE_TYPE_WITH_CODE (GstInceptionv3, gst_inceptionv3,
 static void
 gst_inceptionv3_class_init (GstInceptionv3Class * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
   GstVideoInferenceClass *vi_class = GST_VIDEO_INFERENCE_CLASS (klass);
 
   gst_element_class_add_static_pad_template (element_class,
       &sink_model_factory);
   gst_element_class_add_static_pad_template (element_class, &src_model_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &sink_model_stream_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &src_model_stream_factory);
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "inceptionv3", "Filter",
@@ -122,24 +159,78 @@ gst_inceptionv3_class_init (GstInceptionv3Class * klass)
       "   Michael Gruner <michael.gruner@ridgerun.com> \n\t\t\t"
       "   Mauricio Montero <mauricio.montero@ridgerun.com>");
 
+  gobject_class->set_property = gst_inceptionv3_set_property;
+  gobject_class->get_property = gst_inceptionv3_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_TOP_K,
+      g_param_spec_int ("top-k", "Top K",
+          "Most probable labels to keep in the meta, 0 keeps the "
+          "probability of every label", MIN_TOP_K, MAX_TOP_K,
+          DEFAULT_TOP_K, G_PARAM_READWRITE));
+
   vi_class->start = GST_DEBUG_FUNCPTR (gst_inceptionv3_start);
   vi_class->stop = GST_DEBUG_FUNCPTR (gst_inceptionv3_stop);
   vi_class->preprocess = GST_DEBUG_FUNCPTR (gst_inceptionv3_preprocess);
   vi_class->postprocess = GST_DEBUG_FUNCPTR (gst_inceptionv3_postprocess);
   vi_class->inference_meta_info = gst_classification_meta_get_info ();
+  vi_class->model_channels = MODEL_CHANNELS;
+  vi_class->model_width = MODEL_WIDTH;
+  vi_class->model_height = MODEL_HEIGHT;
+  vi_class->tensor_layout = MODEL_LAYOUT;
 }
 
 static void
 gst_inceptionv3_init (GstInceptionv3 * inceptionv3)
 {
+  inceptionv3->top_k = DEFAULT_TOP_K;
+}
+
+static void
+gst_inceptionv3_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstInceptionv3 *inceptionv3 = GST_INCEPTIONV3 (object);
+
+  GST_DEBUG_OBJECT (inceptionv3, "set_property");
+
+  switch (property_id) {
+    case PROP_TOP_K:
+      inceptionv3->top_k = g_value_get_int (value);
+      GST_DEBUG_OBJECT (inceptionv3, "Changed top k to %d", inceptionv3->top_k);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_inceptionv3_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstInceptionv3 *inceptionv3 = GST_INCEPTIONV3 (object);
+
+  GST_DEBUG_OBJECT (inceptionv3, "get_property");
+
+  switch (property_id) {
+    case PROP_TOP_K:
+      g_value_set_int (value, inceptionv3->top_k);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
 }
 
 static gboolean
 gst_inceptionv3_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe)
 {
+  GstInceptionv3 *inceptionv3 = GST_INCEPTIONV3 (vi);
+
   GST_LOG_OBJECT (vi, "Preprocess");
-  return gst_normalize (inframe, outframe, MEAN, STD, MODEL_CHANNELS);
+  return gst_normalize_with_lut (inframe, outframe, inceptionv3->lut,
+      MODEL_CHANNELS);
 }
 
 static gboolean
@@ -151,7 +242,8 @@ gst_inceptionv3_postprocess (GstVideoInference * vi, const gpointer prediction,
   GstDebugLevel gst_debug_level = GST_LEVEL_LOG;
   GST_LOG_OBJECT (vi, "Postprocess");
 
-  gst_fill_classification_meta (class_meta, prediction, predsize);
+  gst_fill_classification_meta_top_k (class_meta, prediction, predsize,
+      GST_INCEPTIONV3 (vi)->top_k);
 
   gst_inference_print_highest_probability (vi, gst_inceptionv3_debug_category,
       class_meta, prediction, gst_debug_level);
@@ -163,15 +255,26 @@ gst_inceptionv3_postprocess (GstVideoInference * vi, const gpointer prediction,
 static gboolean
 gst_inceptionv3_start (GstVideoInference * vi)
 {
+  GstInceptionv3 *inceptionv3 = GST_INCEPTIONV3 (vi);
+
   GST_INFO_OBJECT (vi, "Starting Inception v3");
 
+  inceptionv3->lut = gst_normalize_lut_get (MEAN, MEAN, MEAN, STD, STD, STD);
+
   return TRUE;
 }
 
 static gboolean
 gst_inceptionv3_stop (GstVideoInference * vi)
 {
+  GstInceptionv3 *inceptionv3 = GST_INCEPTIONV3 (vi);
+
   GST_INFO_OBJECT (vi, "Stopping Inception v3");
 
+  if (inceptionv3->lut) {
+    gst_normalize_lut_unref (inceptionv3->lut);
+    inceptionv3->lut = NULL;
+  }
+
   return TRUE;
 }
@@ -52,6 +52,14 @@ GST_DEBUG_CATEGORY_STATIC (gst_inceptionv4_debug_category);
 #define MEAN 128.0
 #define STD 1/128.0
 #define MODEL_CHANNELS 3
+#define MODEL_WIDTH 299
+#define MODEL_HEIGHT 299
+#define MODEL_LAYOUT GST_INFERENCE_TENSOR_LAYOUT_NHWC
+
+/* Most probable labels kept in the meta, 0 keeps all of them */
+#define MIN_TOP_K 0
+#define MAX_TOP_K GST_CLASSIFICATION_META_MAX_TOP
+#define DEFAULT_TOP_K 0
 
 /* prototypes */
 static void gst_inceptionv4_set_property (GObject * object,
@@ -71,15 +79,17 @@ static gboolean gst_inceptionv4_stop (GstVideoInference * vi);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_TOP_K
 };
 
 /* pad templates */
 #define CAPS								\
   "video/x-raw, "							\
-  "width=299, "							\
-  "height=299, "							\
-  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR}"
+  "width=" GST_VIDEO_SIZE_RANGE ", "					\
+  "height=" GST_VIDEO_SIZE_RANGE ", "					\
+  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR, "	\
+  "NV12, I420, YUY2}"
 
 static GstStaticPadTemplate sink_model_factory =
 GST_STATIC_PAD_TEMPLATE ("sink_model",
@@ -95,9 +105,27 @@ GST_STATIC_PAD_TEMPLATE ("src_model",
     GST_STATIC_CAPS (CAPS)
     );
 
+static GstStaticPadTemplate sink_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("sink_model_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
+static GstStaticPadTemplate src_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("src_model_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
 struct _GstInceptionv4
 {
   GstVideoInference parent;
+
+  GstNormalizeLut *lut;
+
+  gint top_k;
 };
 
 struct _GstInceptionv4Class
@@ -122,6 +150,10 @@ gst_inceptionv4_class_init (GstInceptionv4Class * klass)
   gst_element_class_add_static_pad_template (element_class,
       &sink_model_factory);
   gst_element_class_add_static_pad_template (element_class, &src_model_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &sink_model_stream_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &src_model_stream_factory);
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "inceptionv4", "Filter",
@@ -135,16 +167,27 @@ gst_inceptionv4_class_init (GstInceptionv4Class * klass)
   gobject_class->dispose = gst_inceptionv4_dispose;
   gobject_class->finalize = gst_inceptionv4_finalize;
 
+  g_object_class_install_property (gobject_class, PROP_TOP_K,
+      g_param_spec_int ("top-k", "Top K",
+          "Most probable labels to keep in the meta, 0 keeps the "
+          "probability of every label", MIN_TOP_K, MAX_TOP_K,
+          DEFAULT_TOP_K, G_PARAM_READWRITE));
+
   vi_class->start = GST_DEBUG_FUNCPTR (gst_inceptionv4_start);
   vi_class->stop = GST_DEBUG_FUNCPTR (gst_inceptionv4_stop);
   vi_class->preprocess = GST_DEBUG_FUNCPTR (gst_inceptionv4_preprocess);
   vi_class->postprocess = GST_DEBUG_FUNCPTR (gst_inceptionv4_postprocess);
   vi_class->inference_meta_info = gst_classification_meta_get_info ();
+  vi_class->model_channels = MODEL_CHANNELS;
+  vi_class->model_width = MODEL_WIDTH;
+  vi_class->model_height = MODEL_HEIGHT;
+  vi_class->tensor_layout = MODEL_LAYOUT;
 }
 
 static void
 gst_inceptionv4_init (GstInceptionv4 * inceptionv4)
 {
+  inceptionv4->top_k = DEFAULT_TOP_K;
 }
 
 void
@@ -156,6 +199,10 @@ gst_inceptionv4_set_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (inceptionv4, "set_property");
 
   switch (property_id) {
+    case PROP_TOP_K:
+      inceptionv4->top_k = g_value_get_int (value);
+      GST_DEBUG_OBJECT (inceptionv4, "Changed top k to %d", inceptionv4->top_k);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -171,6 +218,9 @@ gst_inceptionv4_get_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (inceptionv4, "get_property");
 
   switch (property_id) {
+    case PROP_TOP_K:
+      g_value_set_int (value, inceptionv4->top_k);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -205,8 +255,11 @@ static gboolean
 gst_inceptionv4_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe)
 {
+  GstInceptionv4 *inceptionv4 = GST_INCEPTIONV4 (vi);
+
   GST_LOG_OBJECT (vi, "Preprocess");
-  return gst_normalize (inframe, outframe, MEAN, STD, MODEL_CHANNELS);
+  return gst_normalize_with_lut (inframe, outframe, inceptionv4->lut,
+      MODEL_CHANNELS);
 }
 
 static gboolean
@@ -218,7 +271,8 @@ gst_inceptionv4_postprocess (GstVideoInference * vi, const gpointer prediction,
   GstDebugLevel gst_debug_level = GST_LEVEL_LOG;
   GST_LOG_OBJECT (vi, "Postprocess");
 
-  gst_fill_classification_meta (class_meta, prediction, predsize);
+  gst_fill_classification_meta_top_k (class_meta, prediction, predsize,
+      GST_INCEPTIONV4 (vi)->top_k);
 
   gst_inference_print_highest_probability (vi, gst_inceptionv4_debug_category,
       class_meta, prediction, gst_debug_level);
@@ -230,15 +284,26 @@ gst_inceptionv4_postprocess (GstVideoInference * vi, const gpointer prediction,
 static gboolean
 gst_inceptionv4_start (GstVideoInference * vi)
 {
+  GstInceptionv4 *inceptionv4 = GST_INCEPTIONV4 (vi);
+
   GST_INFO_OBJECT (vi, "Starting Inception v4");
 
+  inceptionv4->lut = gst_normalize_lut_get (MEAN, MEAN, MEAN, STD, STD, STD);
+
   return TRUE;
 }
 
 static gboolean
 gst_inceptionv4_stop (GstVideoInference * vi)
 {
+  GstInceptionv4 *inceptionv4 = GST_INCEPTIONV4 (vi);
+
   GST_INFO_OBJECT (vi, "Stopping Inception v4");
 
+  if (inceptionv4->lut) {
+    gst_normalize_lut_unref (inceptionv4->lut);
+    inceptionv4->lut = NULL;
+  }
+
   return TRUE;
 }
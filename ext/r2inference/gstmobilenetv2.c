@@ -51,7 +51,19 @@ GST_DEBUG_CATEGORY_STATIC (gst_mobilenetv2_debug_category);
 #define MEAN 128.0
 #define STD 1/128.0
 #define MODEL_CHANNELS 3
+#define MODEL_WIDTH 224
+#define MODEL_HEIGHT 224
+#define MODEL_LAYOUT GST_INFERENCE_TENSOR_LAYOUT_NHWC
 
+/* Most probable labels kept in the meta, 0 keeps all of them */
+#define MIN_TOP_K 0
+#define MAX_TOP_K GST_CLASSIFICATION_META_MAX_TOP
+#define DEFAULT_TOP_K 0
+
+static void gst_mobilenetv2_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_mobilenetv2_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
 static gboolean gst_mobilenetv2_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe);
 static gboolean gst_mobilenetv2_postprocess (GstVideoInference * vi,
@@ -62,15 +74,17 @@ static gboolean gst_mobilenetv2_stop (GstVideoInference * vi);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_TOP_K
 };
 
 /* pad templates */
 #define CAPS								\
   "video/x-raw, "							\
-  "width=224, "							\
-  "height=224, "							\
-  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR}"
+  "width=" GST_VIDEO_SIZE_RANGE ", "					\
+  "height=" GST_VIDEO_SIZE_RANGE ", "					\
+  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR, "	\
+  "NV12, I420, YUY2}"
 
 static GstStaticPadTemplate sink_model_factory =
 GST_STATIC_PAD_TEMPLATE ("sink_model",
@@ -86,9 +100,27 @@ GST_STATIC_PAD_TEMPLATE ("src_model",
     GST_STATIC_CAPS (CAPS)
     );
 
+static GstStaticPadTemplate sink_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("sink_model_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
+static GstStaticPadTemplate src_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("src_model_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
 struct _GstMobilenetv2
 {
   GstVideoInference parent;
+
+  GstNormalizeLut *lut;
+
+  gint top_k;
 };
 
 struct _GstMobilenetv2Class
@@ -106,12 +138,17 @@ G_DEFINE_TYPE_WITH_CODE (GstMobilenetv2, gst_mobilenetv2,
 static void
 gst_mobilenetv2_class_init (GstMobilenetv2Class * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
   GstVideoInferenceClass *vi_class = GST_VIDEO_INFERENCE_CLASS (klass);
 
   gst_element_class_add_static_pad_template (element_class,
       &sink_model_factory);
   gst_element_class_add_static_pad_template (element_class, &src_model_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &sink_model_stream_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &src_model_stream_factory);
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "mobilenetv2", "Filter",
@@ -121,24 +158,78 @@ gst_mobilenetv2_class_init (GstMobilenetv2Class * klass)
       "   Michael Gruner <michael.gruner@ridgerun.com>  \n\t\t\t"
       "   Mauricio Montero <mauricio.montero@ridgerun.com>");
 
+  gobject_class->set_property = gst_mobilenetv2_set_property;
+  gobject_class->get_property = gst_mobilenetv2_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_TOP_K,
+      g_param_spec_int ("top-k", "Top K",
+          "Most probable labels to keep in the meta, 0 keeps the "
+          "probability of every label", MIN_TOP_K, MAX_TOP_K,
+          DEFAULT_TOP_K, G_PARAM_READWRITE));
+
   vi_class->start = GST_DEBUG_FUNCPTR (gst_mobilenetv2_start);
   vi_class->stop = GST_DEBUG_FUNCPTR (gst_mobilenetv2_stop);
   vi_class->preprocess = GST_DEBUG_FUNCPTR (gst_mobilenetv2_preprocess);
   vi_class->postprocess = GST_DEBUG_FUNCPTR (gst_mobilenetv2_postprocess);
   vi_class->inference_meta_info = gst_classification_meta_get_info ();
+  vi_class->model_channels = MODEL_CHANNELS;
+  vi_class->model_width = MODEL_WIDTH;
+  vi_class->model_height = MODEL_HEIGHT;
+  vi_class->tensor_layout = MODEL_LAYOUT;
 }
 
 static void
 gst_mobilenetv2_init (GstMobilenetv2 * mobilenetv2)
 {
+  mobilenetv2->top_k = DEFAULT_TOP_K;
+}
+
+static void
+gst_mobilenetv2_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMobilenetv2 *mobilenetv2 = GST_MOBILENETV2 (object);
+
+  GST_DEBUG_OBJECT (mobilenetv2, "set_property");
+
+  switch (property_id) {
+    case PROP_TOP_K:
+      mobilenetv2->top_k = g_value_get_int (value);
+      GST_DEBUG_OBJECT (mobilenetv2, "Changed top k to %d", mobilenetv2->top_k);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_mobilenetv2_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstMobilenetv2 *mobilenetv2 = GST_MOBILENETV2 (object);
+
+  GST_DEBUG_OBJECT (mobilenetv2, "get_property");
+
+  switch (property_id) {
+    case PROP_TOP_K:
+      g_value_set_int (value, mobilenetv2->top_k);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
 }
 
 static gboolean
 gst_mobilenetv2_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe)
 {
+  GstMobilenetv2 *mobilenetv2 = GST_MOBILENETV2 (vi);
+
   GST_LOG_OBJECT (vi, "Preprocess");
-  return gst_normalize (inframe, outframe, MEAN, STD, MODEL_CHANNELS);
+  return gst_normalize_with_lut (inframe, outframe, mobilenetv2->lut,
+      MODEL_CHANNELS);
 }
 
 static gboolean
@@ -150,7 +241,8 @@ gst_mobilenetv2_postprocess (GstVideoInference * vi, const gpointer prediction,
   GstDebugLevel gst_debug_level = GST_LEVEL_LOG;
   GST_LOG_OBJECT (vi, "Postprocess");
 
-  gst_fill_classification_meta (class_meta, prediction, predsize);
+  gst_fill_classification_meta_top_k (class_meta, prediction, predsize,
+      GST_MOBILENETV2 (vi)->top_k);
 
   gst_inference_print_highest_probability (vi, gst_mobilenetv2_debug_category,
       class_meta, prediction, gst_debug_level);
@@ -162,15 +254,26 @@ gst_mobilenetv2_postprocess (GstVideoInference * vi, const gpointer prediction,
 static gboolean
 gst_mobilenetv2_start (GstVideoInference * vi)
 {
+  GstMobilenetv2 *mobilenetv2 = GST_MOBILENETV2 (vi);
+
   GST_INFO_OBJECT (vi, "Starting Mobilenet v2");
 
+  mobilenetv2->lut = gst_normalize_lut_get (MEAN, MEAN, MEAN, STD, STD, STD);
+
   return TRUE;
 }
 
 static gboolean
 gst_mobilenetv2_stop (GstVideoInference * vi)
 {
+  GstMobilenetv2 *mobilenetv2 = GST_MOBILENETV2 (vi);
+
   GST_INFO_OBJECT (vi, "Stopping Mobilenet v2");
 
+  if (mobilenetv2->lut) {
+    gst_normalize_lut_unref (mobilenetv2->lut);
+    mobilenetv2->lut = NULL;
+  }
+
   return TRUE;
 }
@@ -23,7 +23,9 @@
  * SECTION:element-gsttinyyolov2
  *
  * The tinyyolov2 element allows the user to infer/execute a pretrained model
- * based on the TinyYolo architecture on incoming image frames.
+ * based on the TinyYolo architecture on incoming image frames. The
+ * input-width, input-height, classes, grids and anchors properties
+ * describe the model, for ones trained with other sizes or classes.
  *
  * <refsect2>
  * <title>Example launch line</title>
@@ -52,6 +54,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_tinyyolov2_debug_category);
 #define MEAN 0
 #define STD 1/255.0
 #define MODEL_CHANNELS 3
+#define MODEL_LAYOUT GST_INFERENCE_TENSOR_LAYOUT_NHWC
 
 /* Objectness threshold */
 #define MAX_OBJ_THRESH 1
@@ -66,8 +69,18 @@ GST_DEBUG_CATEGORY_STATIC (gst_tinyyolov2_debug_category);
 #define MIN_IOU_THRESH 0
 #define DEFAULT_IOU_THRESH 0.30
 
-const gfloat box_anchors[] =
-    { 1.08, 1.19, 3.42, 4.41, 6.63, 11.38, 9.42, 5.11, 16.62, 10.52 };
+/* Model descriptor, by default a 13x13 grid of boxes relative to their
+ * cell and 5 anchors, for the 20 VOC classes
+ */
+#define MIN_INPUT_SIZE 1
+#define MAX_INPUT_SIZE GST_YOLO_MAX_INPUT_SIZE
+#define DEFAULT_INPUT_WIDTH 416
+#define DEFAULT_INPUT_HEIGHT 416
+#define MIN_CLASSES 1
+#define MAX_CLASSES GST_YOLO_MAX_CLASSES
+#define DEFAULT_CLASSES 20
+#define DEFAULT_GRIDS "13x13"
+#define DEFAULT_ANCHORS "1.08,1.19,3.42,4.41,6.63,11.38,9.42,5.11,16.62,10.52"
 
 /* prototypes */
 static void gst_tinyyolov2_set_property (GObject * object,
@@ -92,14 +105,20 @@ enum
   PROP_OBJ_THRESH,
   PROP_PROB_THRESH,
   PROP_IOU_THRESH,
+  PROP_INPUT_WIDTH,
+  PROP_INPUT_HEIGHT,
+  PROP_CLASSES,
+  PROP_GRIDS,
+  PROP_ANCHORS,
 };
 
 /* pad templates */
 #define CAPS								\
   "video/x-raw, "							\
-  "width=416, "							\
-  "height=416, "							\
-  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR}"
+  "width=" GST_VIDEO_SIZE_RANGE ", "					\
+  "height=" GST_VIDEO_SIZE_RANGE ", "					\
+  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR, "	\
+  "NV12, I420, YUY2}"
 
 static GstStaticPadTemplate sink_model_factory =
 GST_STATIC_PAD_TEMPLATE ("sink_model",
@@ -115,13 +134,33 @@ GST_STATIC_PAD_TEMPLATE ("src_model",
     GST_STATIC_CAPS (CAPS)
     );
 
+static GstStaticPadTemplate sink_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("sink_model_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
+static GstStaticPadTemplate src_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("src_model_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
 struct _GstTinyyolov2
 {
   GstVideoInference parent;
 
+  GstNormalizeLut *lut;
+  GstYoloDecoder *decoder;
+
   gdouble obj_thresh;
   gdouble prob_thresh;
   gdouble iou_thresh;
+
+  /* Model descriptor, the decoder is built from it on start */
+  GstYoloDescriptor descriptor;
 };
 
 struct _GstTinyyolov2Class
@@ -146,6 +185,10 @@ gst_tinyyolov2_class_init (GstTinyyolov2Class * klass)
   gst_element_class_add_static_pad_template (element_class,
       &sink_model_factory);
   gst_element_class_add_static_pad_template (element_class, &src_model_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &sink_model_stream_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &src_model_stream_factory);
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "tinyyolov2", "Filter",
@@ -175,12 +218,38 @@ gst_tinyyolov2_class_init (GstTinyyolov2Class * klass)
           "Intersection over union threshold to merge similar boxes",
           MIN_IOU_THRESH, MAX_IOU_THRESH, DEFAULT_IOU_THRESH,
           G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_INPUT_WIDTH,
+      g_param_spec_int ("input-width", "Input Width",
+          "Width of the model input, frames are scaled to it",
+          MIN_INPUT_SIZE, MAX_INPUT_SIZE, DEFAULT_INPUT_WIDTH,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_INPUT_HEIGHT,
+      g_param_spec_int ("input-height", "Input Height",
+          "Height of the model input, frames are scaled to it",
+          MIN_INPUT_SIZE, MAX_INPUT_SIZE, DEFAULT_INPUT_HEIGHT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_CLASSES,
+      g_param_spec_int ("classes", "Classes",
+          "Number of classes the model scores every box for", MIN_CLASSES,
+          MAX_CLASSES, DEFAULT_CLASSES, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_GRIDS,
+      g_param_spec_string ("grids", "Grids",
+          "Size of every output grid in the order of the tensor, separated "
+          "by ';'. For example: 13x13;26x26", DEFAULT_GRIDS,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_ANCHORS,
+      g_param_spec_string ("anchors", "Anchors",
+          "Width and height pairs of the anchors of every grid, in cells "
+          "of that grid. Separated by ',' within a grid and by ';' between "
+          "grids", DEFAULT_ANCHORS, G_PARAM_READWRITE));
 
   vi_class->start = GST_DEBUG_FUNCPTR (gst_tinyyolov2_start);
   vi_class->stop = GST_DEBUG_FUNCPTR (gst_tinyyolov2_stop);
   vi_class->preprocess = GST_DEBUG_FUNCPTR (gst_tinyyolov2_preprocess);
   vi_class->postprocess = GST_DEBUG_FUNCPTR (gst_tinyyolov2_postprocess);
   vi_class->inference_meta_info = gst_detection_meta_get_info ();
+  vi_class->model_channels = MODEL_CHANNELS;
+  vi_class->tensor_layout = MODEL_LAYOUT;
 }
 
 static void
@@ -189,6 +258,11 @@ gst_tinyyolov2_init (GstTinyyolov2 * tinyyolov2)
   tinyyolov2->obj_thresh = DEFAULT_OBJ_THRESH;
   tinyyolov2->prob_thresh = DEFAULT_PROB_THRESH;
   tinyyolov2->iou_thresh = DEFAULT_IOU_THRESH;
+  tinyyolov2->descriptor.input_width = DEFAULT_INPUT_WIDTH;
+  tinyyolov2->descriptor.input_height = DEFAULT_INPUT_HEIGHT;
+  tinyyolov2->descriptor.classes = DEFAULT_CLASSES;
+  tinyyolov2->descriptor.grids = g_strdup (DEFAULT_GRIDS);
+  tinyyolov2->descriptor.anchors = g_strdup (DEFAULT_ANCHORS);
 }
 
 void
@@ -216,6 +290,14 @@ gst_tinyyolov2_set_property (GObject * object, guint property_id,
           "Changed intersection over union threshold to %lf",
           tinyyolov2->iou_thresh);
       break;
+    case PROP_INPUT_WIDTH:
+    case PROP_INPUT_HEIGHT:
+    case PROP_CLASSES:
+    case PROP_GRIDS:
+    case PROP_ANCHORS:
+      gst_yolo_descriptor_set_property (GST_VIDEO_INFERENCE (tinyyolov2),
+          &tinyyolov2->descriptor, pspec, value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -240,6 +322,31 @@ gst_tinyyolov2_get_property (GObject * object, guint property_id,
     case PROP_IOU_THRESH:
       g_value_set_double (value, tinyyolov2->iou_thresh);
       break;
+    case PROP_INPUT_WIDTH:
+      GST_OBJECT_LOCK (tinyyolov2);
+      g_value_set_int (value, tinyyolov2->descriptor.input_width);
+      GST_OBJECT_UNLOCK (tinyyolov2);
+      break;
+    case PROP_INPUT_HEIGHT:
+      GST_OBJECT_LOCK (tinyyolov2);
+      g_value_set_int (value, tinyyolov2->descriptor.input_height);
+      GST_OBJECT_UNLOCK (tinyyolov2);
+      break;
+    case PROP_CLASSES:
+      GST_OBJECT_LOCK (tinyyolov2);
+      g_value_set_int (value, tinyyolov2->descriptor.classes);
+      GST_OBJECT_UNLOCK (tinyyolov2);
+      break;
+    case PROP_GRIDS:
+      GST_OBJECT_LOCK (tinyyolov2);
+      g_value_set_string (value, tinyyolov2->descriptor.grids);
+      GST_OBJECT_UNLOCK (tinyyolov2);
+      break;
+    case PROP_ANCHORS:
+      GST_OBJECT_LOCK (tinyyolov2);
+      g_value_set_string (value, tinyyolov2->descriptor.anchors);
+      GST_OBJECT_UNLOCK (tinyyolov2);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -266,6 +373,8 @@ gst_tinyyolov2_finalize (GObject * object)
   GST_DEBUG_OBJECT (tinyyolov2, "finalize");
 
   /* clean up object here */
+  g_free (tinyyolov2->descriptor.grids);
+  g_free (tinyyolov2->descriptor.anchors);
 
   G_OBJECT_CLASS (gst_tinyyolov2_parent_class)->finalize (object);
 }
@@ -274,8 +383,11 @@ static gboolean
 gst_tinyyolov2_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe)
 {
+  GstTinyyolov2 *tinyyolov2 = GST_TINYYOLOV2 (vi);
+
   GST_LOG_OBJECT (vi, "Preprocess");
-  return gst_normalize (inframe, outframe, MEAN, STD, MODEL_CHANNELS);
+  return gst_normalize_with_lut (inframe, outframe, tinyyolov2->lut,
+      MODEL_CHANNELS);
 }
 
 static gboolean
@@ -285,13 +397,17 @@ gst_tinyyolov2_postprocess (GstVideoInference * vi, const gpointer prediction,
 {
   GstTinyyolov2 *tinyyolov2;
   GstDetectionMeta *detect_meta = (GstDetectionMeta *) meta_model;
+  gboolean ret;
   GST_LOG_OBJECT (vi, "Postprocess");
   detect_meta->num_boxes = 0;
   tinyyolov2 = GST_TINYYOLOV2 (vi);
 
-  gst_create_boxes (vi, prediction, detect_meta, info_model, valid_prediction,
-      &detect_meta->boxes, &detect_meta->num_boxes, tinyyolov2->obj_thresh,
-      tinyyolov2->prob_thresh, tinyyolov2->iou_thresh);
+  ret = gst_yolo_decoder_create_boxes (tinyyolov2->decoder, prediction,
+      predsize, detect_meta, tinyyolov2->obj_thresh, tinyyolov2->prob_thresh,
+      tinyyolov2->iou_thresh);
+  if (!ret) {
+    return FALSE;
+  }
 
   gst_inference_print_boxes (vi, gst_tinyyolov2_debug_category, detect_meta);
 
@@ -303,15 +419,38 @@ gst_tinyyolov2_postprocess (GstVideoInference * vi, const gpointer prediction,
 static gboolean
 gst_tinyyolov2_start (GstVideoInference * vi)
 {
+  GstTinyyolov2 *tinyyolov2 = GST_TINYYOLOV2 (vi);
+
   GST_INFO_OBJECT (vi, "Starting TinyYolo");
 
+  tinyyolov2->decoder =
+      gst_yolo_descriptor_new_decoder (vi, &tinyyolov2->descriptor,
+      GST_YOLO_BOX_FORMAT_CELL);
+  if (NULL == tinyyolov2->decoder) {
+    return FALSE;
+  }
+
+  tinyyolov2->lut = gst_normalize_lut_get (MEAN, MEAN, MEAN, STD, STD, STD);
+
   return TRUE;
 }
 
 static gboolean
 gst_tinyyolov2_stop (GstVideoInference * vi)
 {
+  GstTinyyolov2 *tinyyolov2 = GST_TINYYOLOV2 (vi);
+
   GST_INFO_OBJECT (vi, "Stopping TinyYolo");
 
+  if (tinyyolov2->lut) {
+    gst_normalize_lut_unref (tinyyolov2->lut);
+    tinyyolov2->lut = NULL;
+  }
+
+  if (tinyyolov2->decoder) {
+    gst_yolo_decoder_free (tinyyolov2->decoder);
+    tinyyolov2->decoder = NULL;
+  }
+
   return TRUE;
 }
@@ -23,7 +23,9 @@
  * SECTION:element-gsttinyyolov3
  *
  * The tinyyolov3 element allows the user to infer/execute a pretrained model
- * based on the TinyYolo architecture on incoming image frames.
+ * based on the TinyYolo architecture on incoming image frames. The
+ * input-width, input-height, classes, grids and anchors properties
+ * describe the model, for ones trained with other sizes or classes.
  *
  * <refsect2>
  * <title>Example launch line</title>
@@ -48,7 +50,10 @@
 GST_DEBUG_CATEGORY_STATIC (gst_tinyyolov3_debug_category);
 #define GST_CAT_DEFAULT gst_tinyyolov3_debug_category
 
+#define MEAN 0
+#define STD 1.0
 #define MODEL_CHANNELS 3
+#define MODEL_LAYOUT GST_INFERENCE_TENSOR_LAYOUT_NHWC
 
 /* Objectness threshold */
 #define MAX_OBJ_THRESH 1
@@ -63,11 +68,28 @@ GST_DEBUG_CATEGORY_STATIC (gst_tinyyolov3_debug_category);
 #define MIN_IOU_THRESH 0
 #define DEFAULT_IOU_THRESH 0.40
 
+/* Model descriptor, by default 13x13 and 26x26 grids of 3 anchors each,
+ * the graph already outputs the corners of the boxes for the 80 COCO
+ * classes. The anchors are only counted for this format.
+ */
+#define MIN_INPUT_SIZE 1
+#define MAX_INPUT_SIZE GST_YOLO_MAX_INPUT_SIZE
+#define DEFAULT_INPUT_WIDTH 416
+#define DEFAULT_INPUT_HEIGHT 416
+#define MIN_CLASSES 1
+#define MAX_CLASSES GST_YOLO_MAX_CLASSES
+#define DEFAULT_CLASSES 80
+#define DEFAULT_GRIDS "13x13;26x26"
+#define DEFAULT_ANCHORS \
+  "2.53125,2.5625,4.21875,5.28125,10.75,9.96875;" \
+  "0.625,0.875,1.4375,1.6875,2.3125,3.625"
+
 /* prototypes */
 static void gst_tinyyolov3_set_property (GObject * object,
     guint property_id, const GValue * value, GParamSpec * pspec);
 static void gst_tinyyolov3_get_property (GObject * object,
     guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_tinyyolov3_finalize (GObject * object);
 
 static gboolean gst_tinyyolov3_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe);
@@ -84,14 +106,20 @@ enum
   PROP_OBJ_THRESH,
   PROP_PROB_THRESH,
   PROP_IOU_THRESH,
+  PROP_INPUT_WIDTH,
+  PROP_INPUT_HEIGHT,
+  PROP_CLASSES,
+  PROP_GRIDS,
+  PROP_ANCHORS,
 };
 
 /* pad templates */
 #define CAPS								\
   "video/x-raw, "							\
-  "width=416, "								\
-  "height=416, "							\
-  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR}"
+  "width=" GST_VIDEO_SIZE_RANGE ", "					\
+  "height=" GST_VIDEO_SIZE_RANGE ", "					\
+  "format={RGB, RGBx, RGBA, BGR, BGRx, BGRA, xRGB, ARGB, xBGR, ABGR, "	\
+  "NV12, I420, YUY2}"
 
 static GstStaticPadTemplate sink_model_factory =
 GST_STATIC_PAD_TEMPLATE ("sink_model",
@@ -107,13 +135,33 @@ GST_STATIC_PAD_TEMPLATE ("src_model",
     GST_STATIC_CAPS (CAPS)
     );
 
+static GstStaticPadTemplate sink_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("sink_model_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
+static GstStaticPadTemplate src_model_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("src_model_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (CAPS)
+    );
+
 struct _GstTinyyolov3
 {
   GstVideoInference parent;
 
+  GstNormalizeLut *lut;
+  GstYoloDecoder *decoder;
+
   gdouble obj_thresh;
   gdouble prob_thresh;
   gdouble iou_thresh;
+
+  /* Model descriptor, the decoder is built from it on start */
+  GstYoloDescriptor descriptor;
 };
 
 struct _GstTinyyolov3Class
@@ -138,6 +186,10 @@ gst_tinyyolov3_class_init (GstTinyyolov3Class * klass)
   gst_element_class_add_static_pad_template (element_class,
       &sink_model_factory);
   gst_element_class_add_static_pad_template (element_class, &src_model_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &sink_model_stream_factory);
+  gst_element_class_add_static_pad_template (element_class,
+      &src_model_stream_factory);
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS (klass),
       "tinyyolov3", "Filter",
@@ -151,6 +203,7 @@ gst_tinyyolov3_class_init (GstTinyyolov3Class * klass)
 
   gobject_class->set_property = gst_tinyyolov3_set_property;
   gobject_class->get_property = gst_tinyyolov3_get_property;
+  gobject_class->finalize = gst_tinyyolov3_finalize;
 
   g_object_class_install_property (gobject_class, PROP_OBJ_THRESH,
       g_param_spec_double ("object-threshold", "obj-thresh",
@@ -165,12 +218,38 @@ gst_tinyyolov3_class_init (GstTinyyolov3Class * klass)
           "Intersection over union threshold to merge similar boxes",
           MIN_IOU_THRESH, MAX_IOU_THRESH, DEFAULT_IOU_THRESH,
           G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_INPUT_WIDTH,
+      g_param_spec_int ("input-width", "Input Width",
+          "Width of the model input, frames are scaled to it",
+          MIN_INPUT_SIZE, MAX_INPUT_SIZE, DEFAULT_INPUT_WIDTH,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_INPUT_HEIGHT,
+      g_param_spec_int ("input-height", "Input Height",
+          "Height of the model input, frames are scaled to it",
+          MIN_INPUT_SIZE, MAX_INPUT_SIZE, DEFAULT_INPUT_HEIGHT,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_CLASSES,
+      g_param_spec_int ("classes", "Classes",
+          "Number of classes the model scores every box for", MIN_CLASSES,
+          MAX_CLASSES, DEFAULT_CLASSES, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_GRIDS,
+      g_param_spec_string ("grids", "Grids",
+          "Size of every output grid in the order of the tensor, separated "
+          "by ';'. For example: 13x13;26x26", DEFAULT_GRIDS,
+          G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, PROP_ANCHORS,
+      g_param_spec_string ("anchors", "Anchors",
+          "Width and height pairs of the anchors of every grid, in cells "
+          "of that grid. Separated by ',' within a grid and by ';' between "
+          "grids", DEFAULT_ANCHORS, G_PARAM_READWRITE));
 
   vi_class->start = GST_DEBUG_FUNCPTR (gst_tinyyolov3_start);
   vi_class->stop = GST_DEBUG_FUNCPTR (gst_tinyyolov3_stop);
   vi_class->preprocess = GST_DEBUG_FUNCPTR (gst_tinyyolov3_preprocess);
   vi_class->postprocess = GST_DEBUG_FUNCPTR (gst_tinyyolov3_postprocess);
   vi_class->inference_meta_info = gst_detection_meta_get_info ();
+  vi_class->model_channels = MODEL_CHANNELS;
+  vi_class->tensor_layout = MODEL_LAYOUT;
 }
 
 static void
@@ -179,6 +258,11 @@ gst_tinyyolov3_init (GstTinyyolov3 * tinyyolov3)
   tinyyolov3->obj_thresh = DEFAULT_OBJ_THRESH;
   tinyyolov3->prob_thresh = DEFAULT_PROB_THRESH;
   tinyyolov3->iou_thresh = DEFAULT_IOU_THRESH;
+  tinyyolov3->descriptor.input_width = DEFAULT_INPUT_WIDTH;
+  tinyyolov3->descriptor.input_height = DEFAULT_INPUT_HEIGHT;
+  tinyyolov3->descriptor.classes = DEFAULT_CLASSES;
+  tinyyolov3->descriptor.grids = g_strdup (DEFAULT_GRIDS);
+  tinyyolov3->descriptor.anchors = g_strdup (DEFAULT_ANCHORS);
 }
 
 static void
@@ -206,6 +290,14 @@ gst_tinyyolov3_set_property (GObject * object, guint property_id,
           "Changed intersection over union threshold to %lf",
           tinyyolov3->iou_thresh);
       break;
+    case PROP_INPUT_WIDTH:
+    case PROP_INPUT_HEIGHT:
+    case PROP_CLASSES:
+    case PROP_GRIDS:
+    case PROP_ANCHORS:
+      gst_yolo_descriptor_set_property (GST_VIDEO_INFERENCE (tinyyolov3),
+          &tinyyolov3->descriptor, pspec, value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -230,18 +322,59 @@ gst_tinyyolov3_get_property (GObject * object, guint property_id,
     case PROP_IOU_THRESH:
       g_value_set_double (value, tinyyolov3->iou_thresh);
       break;
+    case PROP_INPUT_WIDTH:
+      GST_OBJECT_LOCK (tinyyolov3);
+      g_value_set_int (value, tinyyolov3->descriptor.input_width);
+      GST_OBJECT_UNLOCK (tinyyolov3);
+      break;
+    case PROP_INPUT_HEIGHT:
+      GST_OBJECT_LOCK (tinyyolov3);
+      g_value_set_int (value, tinyyolov3->descriptor.input_height);
+      GST_OBJECT_UNLOCK (tinyyolov3);
+      break;
+    case PROP_CLASSES:
+      GST_OBJECT_LOCK (tinyyolov3);
+      g_value_set_int (value, tinyyolov3->descriptor.classes);
+      GST_OBJECT_UNLOCK (tinyyolov3);
+      break;
+    case PROP_GRIDS:
+      GST_OBJECT_LOCK (tinyyolov3);
+      g_value_set_string (value, tinyyolov3->descriptor.grids);
+      GST_OBJECT_UNLOCK (tinyyolov3);
+      break;
+    case PROP_ANCHORS:
+      GST_OBJECT_LOCK (tinyyolov3);
+      g_value_set_string (value, tinyyolov3->descriptor.anchors);
+      GST_OBJECT_UNLOCK (tinyyolov3);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
 }
 
+static void
+gst_tinyyolov3_finalize (GObject * object)
+{
+  GstTinyyolov3 *tinyyolov3 = GST_TINYYOLOV3 (object);
+
+  GST_DEBUG_OBJECT (tinyyolov3, "finalize");
+
+  g_free (tinyyolov3->descriptor.grids);
+  g_free (tinyyolov3->descriptor.anchors);
+
+  G_OBJECT_CLASS (gst_tinyyolov3_parent_class)->finalize (object);
+}
+
 static gboolean
 gst_tinyyolov3_preprocess (GstVideoInference * vi,
     GstVideoFrame * inframe, GstVideoFrame * outframe)
 {
+  GstTinyyolov3 *tinyyolov3 = GST_TINYYOLOV3 (vi);
+
   GST_LOG_OBJECT (vi, "Preprocess");
-  return gst_pixel_to_float (inframe, outframe, MODEL_CHANNELS);
+  return gst_normalize_with_lut (inframe, outframe, tinyyolov3->lut,
+      MODEL_CHANNELS);
 }
 
 static gboolean
@@ -251,13 +384,17 @@ gst_tinyyolov3_postprocess (GstVideoInference * vi, const gpointer prediction,
 {
   GstTinyyolov3 *tinyyolov3;
   GstDetectionMeta *detect_meta = (GstDetectionMeta *) meta_model;
+  gboolean ret;
   GST_LOG_OBJECT (vi, "Postprocess");
   detect_meta->num_boxes = 0;
   tinyyolov3 = GST_TINYYOLOV3 (vi);
 
-  gst_create_boxes_float (vi, prediction, detect_meta, info_model,
-      valid_prediction, &detect_meta->boxes, &detect_meta->num_boxes,
-      tinyyolov3->obj_thresh, tinyyolov3->prob_thresh, tinyyolov3->iou_thresh);
+  ret = gst_yolo_decoder_create_boxes (tinyyolov3->decoder, prediction,
+      predsize, detect_meta, tinyyolov3->obj_thresh, tinyyolov3->prob_thresh,
+      tinyyolov3->iou_thresh);
+  if (!ret) {
+    return FALSE;
+  }
 
   gst_inference_print_boxes (vi, gst_tinyyolov3_debug_category, detect_meta);
 
@@ -269,15 +406,38 @@ gst_tinyyolov3_postprocess (GstVideoInference * vi, const gpointer prediction,
 static gboolean
 gst_tinyyolov3_start (GstVideoInference * vi)
 {
+  GstTinyyolov3 *tinyyolov3 = GST_TINYYOLOV3 (vi);
+
   GST_INFO_OBJECT (vi, "Starting TinyYolo");
 
+  tinyyolov3->decoder =
+      gst_yolo_descriptor_new_decoder (vi, &tinyyolov3->descriptor,
+      GST_YOLO_BOX_FORMAT_CORNERS);
+  if (NULL == tinyyolov3->decoder) {
+    return FALSE;
+  }
+
+  tinyyolov3->lut = gst_normalize_lut_get (MEAN, MEAN, MEAN, STD, STD, STD);
+
   return TRUE;
 }
 
 static gboolean
 gst_tinyyolov3_stop (GstVideoInference * vi)
 {
+  GstTinyyolov3 *tinyyolov3 = GST_TINYYOLOV3 (vi);
+
   GST_INFO_OBJECT (vi, "Stopping TinyYolo");
 
+  if (tinyyolov3->lut) {
+    gst_normalize_lut_unref (tinyyolov3->lut);
+    tinyyolov3->lut = NULL;
+  }
+
+  if (tinyyolov3->decoder) {
+    gst_yolo_decoder_free (tinyyolov3->decoder);
+    tinyyolov3->decoder = NULL;
+  }
+
   return TRUE;
 }
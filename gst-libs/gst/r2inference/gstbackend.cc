@@ -27,6 +27,9 @@
 #include <cstring>
 #include <memory>
 #include <list>
+#include <map>
+#include <string>
+#include <vector>
 
 GST_DEBUG_CATEGORY_STATIC (gst_backend_debug_category);
 #define GST_CAT_DEFAULT gst_backend_debug_category
@@ -78,8 +81,76 @@ class InferenceProperty {
   const gchar *get_name() {
     return apspec->name;
   }
+
+  std::string get_value() {
+    gchar *contents = g_strdup_value_contents (avalue);
+    std::string value (contents);
+
+    g_free (contents);
+    return value;
+  }
+};
+
+/* An engine, with its model and parameters, shared by every backend
+   started with the same framework, model location and properties */
+class SharedEngine {
+ public:
+
+  std::string key;
+  std::shared_ptr < r2i::IEngine > engine;
+  std::shared_ptr < r2i::IModel > model;
+  std::shared_ptr < r2i::IParameters > params;
+  std::vector < r2i::ParameterMeta > params_meta;
+  /* Serializes Start, Stop and Predict among the sharing backends */
+  GMutex mutex;
+  guint started;
+  /* Batches waiting for or running on the engine */
+  gint load;
+
+  SharedEngine(const std::string &engine_key) : key(engine_key), started(0),
+    load(0) {
+    g_mutex_init (&mutex);
+  }
+
+  ~SharedEngine();
 };
 
+/* Process wide registries, entries go away with their last user. The
+   lock is recursive since failed engines are released while holding it */
+static GRecMutex registry_mutex;
+static std::map < std::string, std::weak_ptr < SharedEngine > > engine_registry;
+static std::map < std::string, std::weak_ptr < r2i::IModel > > model_registry;
+
+/* Drops the entries whose engine or model is gone. Entries still in use,
+   like a new engine registered under the key of a released one, stay */
+template < typename T > static void
+gst_backend_registry_prune (std::map < std::string, std::weak_ptr < T > >
+                            &registry) {
+  typename std::map < std::string, std::weak_ptr < T > >::iterator it;
+
+  for (it = registry.begin (); it != registry.end ();) {
+    if (it->second.expired ()) {
+      it = registry.erase (it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+SharedEngine::~SharedEngine() {
+  /* Released first so the model entry can go along with the engine */
+  params = nullptr;
+  engine = nullptr;
+  model = nullptr;
+
+  g_rec_mutex_lock (&registry_mutex);
+  gst_backend_registry_prune (engine_registry);
+  gst_backend_registry_prune (model_registry);
+  g_rec_mutex_unlock (&registry_mutex);
+
+  g_mutex_clear (&mutex);
+}
+
 typedef struct _GstBackendPrivate GstBackendPrivate;
 struct _GstBackendPrivate {
   r2i::FrameworkCode code;
@@ -88,8 +159,16 @@ struct _GstBackendPrivate {
   std::shared_ptr < r2i::IModel > model;
   std::shared_ptr < r2i::IParameters > params;
   std::unique_ptr < r2i::IFrameworkFactory > factory;
+  /* Frames are dispatched among the engines, the first one holds the
+     parameters reported to the user */
+  std::vector < std::shared_ptr < SharedEngine > > engines;
+  std::string engines_key;
+  guint num_engines;
+  GstBackendDispatch dispatch;
+  gint next_engine;
   GMutex backend_mutex;
   gboolean backend_started;
+  guint engines_started;
   std::shared_ptr < std::list<InferenceProperty *> > property_list;
   gboolean backend_created;
 
@@ -105,6 +184,18 @@ G_DEFINE_TYPE_WITH_CODE (GstBackend, gst_backend, G_TYPE_OBJECT,
 static GParamSpec *gst_backend_param_to_spec (r2i::ParameterMeta *param);
 static int gst_backend_param_flags (int flags);
 static void gst_backend_finalize (GObject *obj);
+static void gst_backend_prediction_free (gpointer data);
+static std::string gst_backend_engine_key (GstBackendPrivate *priv,
+    const gchar *model_location);
+static std::shared_ptr < r2i::IModel > gst_backend_load_model (
+  GstBackend *self, const gchar *model_location, r2i::RuntimeError &error);
+static std::shared_ptr < SharedEngine > gst_backend_make_engine (
+  GstBackend *self, const std::string &key, const gchar *model_location,
+  r2i::RuntimeError &error);
+static void gst_backend_set_params (GstBackend *self, const GValue *value,
+                                    GParamSpec *pspec);
+static std::shared_ptr < SharedEngine > gst_backend_acquire_engine (
+  GstBackendPrivate *priv);
 
 #define GST_BACKEND_ERROR gst_backend_error_quark()
 
@@ -124,6 +215,10 @@ gst_backend_init (GstBackend *self) {
   g_mutex_init(&priv->backend_mutex);
   priv->backend_started = false;
   priv->backend_created = false;
+  priv->num_engines = 1;
+  priv->dispatch = GST_BACKEND_DISPATCH_ROUND_ROBIN;
+  priv->next_engine = 0;
+  priv->engines_started = 0;
   priv->property_list = std::make_shared<std::list<InferenceProperty *>>();
 }
 
@@ -138,6 +233,7 @@ gst_backend_finalize (GObject *obj) {
   priv->model = nullptr;
   priv->params = nullptr;
   priv->factory = nullptr;
+  priv->engines.clear ();
   priv-> property_list = nullptr;
 
   G_OBJECT_CLASS (gst_backend_parent_class)->finalize (obj);
@@ -215,24 +311,35 @@ gst_backend_set_property (GObject *object, guint property_id,
 
   g_mutex_lock (&priv->backend_mutex);
   if (priv->backend_started) {
+    gst_backend_set_params (self, value, pspec);
+  } else {
+    property = new InferenceProperty(value, pspec);
+    priv->property_list->push_back(property);
+    GST_INFO_OBJECT (self, "Queueing property: %s\n", pspec->name);
+  }
+  g_mutex_unlock (&priv->backend_mutex);
+
+}
+
+static void
+gst_backend_set_params (GstBackend *self, const GValue *value,
+                        GParamSpec *pspec) {
+  GstBackendPrivate *priv = GST_BACKEND_PRIVATE (self);
+
+  /* Keep every engine of the pool configured the same */
+  for (auto &shared : priv->engines) {
     switch (pspec->value_type) {
       case G_TYPE_STRING:
-        priv->params->Set(pspec->name, g_value_get_string(value));
+        shared->params->Set(pspec->name, g_value_get_string(value));
         break;
       case G_TYPE_INT:
-        priv->params->Set(pspec->name, g_value_get_int(value));
+        shared->params->Set(pspec->name, g_value_get_int(value));
         break;
       default:
         GST_WARNING_OBJECT (self, "Invalid property type");
         break;
     }
-  } else {
-    property = new InferenceProperty(value, pspec);
-    priv->property_list->push_back(property);
-    GST_INFO_OBJECT (self, "Queueing property: %s\n", pspec->name);
   }
-  g_mutex_unlock (&priv->backend_mutex);
-
 }
 
 void
@@ -258,6 +365,147 @@ gst_backend_get_property (GObject *object, guint property_id,
   }
 }
 
+static std::string
+gst_backend_engine_key (GstBackendPrivate *priv, const gchar *model_location) {
+  std::map < std::string, std::string > values;
+  std::list<InferenceProperty *>::iterator property_it;
+  std::map < std::string, std::string >::iterator value_it;
+  std::string key;
+
+  /* The last value queued for a property is the one applied */
+  for (property_it = priv->property_list->begin();
+       property_it != priv->property_list->end(); ++property_it) {
+    values[(*property_it)->get_name()] = (*property_it)->get_value();
+  }
+
+  key = std::to_string (priv->code) + ":" + model_location;
+  for (value_it = values.begin(); value_it != values.end(); ++value_it) {
+    key += ":" + value_it->first + "=" + value_it->second;
+  }
+
+  return key;
+}
+
+static std::shared_ptr < r2i::IModel >
+gst_backend_load_model (GstBackend *self, const gchar *model_location,
+                        r2i::RuntimeError &error) {
+  GstBackendPrivate *priv = GST_BACKEND_PRIVATE (self);
+  std::shared_ptr < r2i::ILoader > loader;
+  std::shared_ptr < r2i::IModel > model;
+  std::map < std::string, std::weak_ptr < r2i::IModel > >::iterator it;
+  std::string key;
+
+  /* Called with the registry lock held */
+  key = std::to_string (priv->code) + ":" + model_location;
+  it = model_registry.find (key);
+  if (it != model_registry.end ()) {
+    model = it->second.lock ();
+    if (model) {
+      GST_INFO_OBJECT (self, "Reusing loaded model %s", model_location);
+      return model;
+    }
+    model_registry.erase (it);
+  }
+
+  loader = priv->factory->MakeLoader (error);
+  if (error.IsError ()) {
+    GST_ERROR_OBJECT (self, "Failed to start the model loader");
+    return nullptr;
+  }
+
+  model = loader->Load (model_location, error);
+  if (error.IsError ()) {
+    GST_ERROR_OBJECT (self, "Failed to load model");
+    return nullptr;
+  }
+
+  model_registry[key] = model;
+
+  return model;
+}
+
+static std::shared_ptr < SharedEngine >
+gst_backend_make_engine (GstBackend *self, const std::string &key,
+                         const gchar *model_location, r2i::RuntimeError &error) {
+  GstBackendPrivate *priv = GST_BACKEND_PRIVATE (self);
+  std::shared_ptr < SharedEngine > shared;
+  std::map < std::string, std::weak_ptr < SharedEngine > >::iterator it;
+  InferenceProperty *property;
+  std::list<InferenceProperty *>::iterator property_it;
+  std::vector<r2i::ParameterMeta>::iterator param_it;
+
+  /* Called with the registry lock held. Engines that fail to be made are
+     never registered, and their model entry goes with them */
+  it = engine_registry.find (key);
+  if (it != engine_registry.end ()) {
+    shared = it->second.lock ();
+    if (shared) {
+      GST_INFO_OBJECT (self, "Sharing engine %s", key.c_str ());
+      return shared;
+    }
+    engine_registry.erase (it);
+  }
+
+  shared = std::make_shared < SharedEngine > (key);
+
+  shared->engine = priv->factory->MakeEngine (error);
+  if (error.IsError ()) {
+    GST_ERROR_OBJECT (self, "Failed to start the backend engine");
+    return nullptr;
+  }
+
+  shared->model = gst_backend_load_model (self, model_location, error);
+  if (error.IsError ()) {
+    return nullptr;
+  }
+
+  error = shared->engine->SetModel (shared->model);
+  if (error.IsError ()) {
+    GST_ERROR_OBJECT (self, "Failed to set model to engine");
+    return nullptr;
+  }
+
+  shared->params = priv->factory->MakeParameters (error);
+  if (error.IsError ()) {
+    GST_ERROR_OBJECT (self, "Failed to set get parameters for backend");
+    return nullptr;
+  }
+  error = shared->params->Configure(shared->engine, shared->model);
+  if (error.IsError ()) {
+    GST_ERROR_OBJECT (self, "Failed to configure mode to backend");
+    return nullptr;
+  }
+  error = shared->params->List (shared->params_meta);
+  if (error.IsError ()) {
+    GST_ERROR_OBJECT (self, "Failed to list the backend parameters");
+    return nullptr;
+  }
+
+  /* Properties that can't change once started are part of the key, so
+     they only need to be applied to new engines */
+  for (property_it = priv->property_list->begin();
+       property_it != priv->property_list->end(); ++property_it) {
+    property = *property_it;
+    for (param_it = shared->params_meta.begin();
+         param_it != shared->params_meta.end(); ++param_it) {
+      if (!g_strcmp0(property->get_name(), param_it->name.c_str())) {
+        if (r2i::ParameterMeta::Flags::WRITE_BEFORE_START & param_it->flags) {
+          property->apply_inference_property(self, shared->params, error);
+          if (error.IsError ()) {
+            GST_ERROR_OBJECT (self, "Failed to set backend parameters");
+            return nullptr;
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  engine_registry[key] = shared;
+
+  return shared;
+}
+
 gboolean
 gst_backend_start (GstBackend *self, const gchar *model_location,
                    GError **err) {
@@ -265,98 +513,105 @@ gst_backend_start (GstBackend *self, const gchar *model_location,
   r2i::RuntimeError error;
   InferenceProperty *property;
   std::list<InferenceProperty *>::iterator property_it;
-  static std::vector<r2i::ParameterMeta> params;
-  static std::vector<r2i::ParameterMeta>::iterator param_it;
+  std::vector<r2i::ParameterMeta>::iterator param_it;
+  std::shared_ptr < SharedEngine > shared;
+  std::string key;
+  guint i;
 
   g_return_val_if_fail (priv, FALSE);
   g_return_val_if_fail (model_location, FALSE);
   g_return_val_if_fail (err, FALSE);
 
+  g_mutex_lock (&priv->backend_mutex);
 
   if (!priv->backend_created) {
     priv->factory = r2i::IFrameworkFactory::MakeFactory (priv->code,
                     error);
     if (error.IsError ()) {
       GST_ERROR_OBJECT (self, "Failed to start the backend library");
-      goto error;
-    }
-
-    priv->engine = priv->factory->MakeEngine (error);
-    if (error.IsError ()) {
-      GST_ERROR_OBJECT (self, "Failed to start the backend engine");
-      goto error;
+      goto start_error;
     }
 
-    priv->loader = priv->factory->MakeLoader (error);
-    if (error.IsError ()) {
-      GST_ERROR_OBJECT (self, "Failed to start the model loader");
-      goto error;
-    }
+    /* Backends with the same model and properties share the engine,
+       otherwise they still share the loaded model */
+    priv->engines_key = gst_backend_engine_key (priv, model_location);
+    priv->backend_created = true;
+  }
 
-    priv->model = priv->loader->Load (model_location, error);
-    if (error.IsError ()) {
-      GST_ERROR_OBJECT (self, "Failed to load model");
-      goto error;
-    }
+  /* The pool may have been resized since the last start, every extra
+     engine gets its own key so it is never shared with the first one */
+  if (priv->engines.size () > priv->num_engines) {
+    priv->engines.resize (priv->num_engines);
+  }
 
-    error = priv->engine->SetModel (priv->model);
-    if (error.IsError ()) {
-      GST_ERROR_OBJECT (self, "Failed to set model to engine");
-      goto error;
+  g_rec_mutex_lock (&registry_mutex);
+  for (i = priv->engines.size (); i < priv->num_engines; ++i) {
+    key = priv->engines_key;
+    if (i > 0) {
+      key += "#" + std::to_string (i);
     }
 
-    priv->params = priv->factory->MakeParameters (error);
-    if (error.IsError ()) {
-      GST_ERROR_OBJECT (self, "Failed to set get parameters for backend");
-      goto error;
-    }
-    error = priv->params->Configure(priv->engine, priv->model);
-    if (error.IsError ()) {
-      GST_ERROR_OBJECT (self, "Failed to configure mode to backend");
-      goto error;
+    shared = gst_backend_make_engine (self, key, model_location, error);
+    if (!shared) {
+      g_rec_mutex_unlock (&registry_mutex);
+      goto start_error;
     }
-    error = priv->params->List (params);
-    if (error.IsError ()) {
-      GST_ERROR_OBJECT (self, "Failed to list the backend parameters");
-      goto error;
-    }
-    priv->backend_created = true;
+    priv->engines.push_back (shared);
   }
+  g_rec_mutex_unlock (&registry_mutex);
 
-  g_mutex_lock (&priv->backend_mutex);
+  priv->engine = priv->engines[0]->engine;
+  priv->model = priv->engines[0]->model;
+  priv->params = priv->engines[0]->params;
+
+  /* Properties before start were applied when the engine was made */
   for (property_it = priv->property_list->begin();
        property_it != priv->property_list->end(); ++property_it) {
     property = *property_it;
-    for (param_it = params.begin(); param_it != params.end(); ++param_it) {
+    for (param_it = priv->engines[0]->params_meta.begin();
+         param_it != priv->engines[0]->params_meta.end(); ++param_it) {
       if (!g_strcmp0(property->get_name(), param_it->name.c_str())) {
         if (r2i::ParameterMeta::Flags::WRITE_BEFORE_START & param_it->flags) {
-          property->apply_inference_property(self, priv->params, error);
           property->~InferenceProperty();
           priv->property_list->erase(property_it--);
-          if (error.IsError ()) {
-            GST_ERROR_OBJECT (self, "Failed to set backend parameters");
-            goto error;
-          }
         }
         break;
       }
     }
   }
 
-  error = priv->engine->Start ();
-  if (error.IsError ()) {
-    GST_ERROR_OBJECT (self, "Failed to start the backend engine");
-    goto start_error;
+  for (; priv->engines_started < priv->engines.size ();
+       ++priv->engines_started) {
+    shared = priv->engines[priv->engines_started];
+
+    g_mutex_lock (&shared->mutex);
+    if (0 == shared->started) {
+      error = shared->engine->Start ();
+    }
+    if (!error.IsError ()) {
+      shared->started++;
+    }
+    g_mutex_unlock (&shared->mutex);
+
+    if (error.IsError ()) {
+      GST_ERROR_OBJECT (self, "Failed to start the backend engine");
+      goto start_error;
+    }
   }
 
   while (!priv->property_list->empty()) {
     property = priv->property_list->front();
-    property->apply_inference_property(self, priv->params, error);
+    for (auto &engine : priv->engines) {
+      property->apply_inference_property(self, engine->params, error);
+      if (error.IsError ()) {
+        break;
+      }
+    }
     property->~InferenceProperty();
     priv->property_list->pop_front();
     if (error.IsError ()) {
       GST_ERROR_OBJECT (self, "Failed to set backend parameters");
-      goto error;
+      goto start_error;
     }
   }
   priv->backend_started = true;
@@ -366,7 +621,7 @@ gst_backend_start (GstBackend *self, const gchar *model_location,
 
 start_error:
   g_mutex_unlock (&priv->backend_mutex);
-error:
+
   g_set_error (err, GST_BACKEND_ERROR, error.GetCode (),
                "R2Inference Error: (Code:%d) %s", error.GetCode (),
                error.GetDescription ().c_str ());
@@ -376,16 +631,36 @@ error:
 gboolean
 gst_backend_stop (GstBackend *self, GError **err) {
   GstBackendPrivate *priv = GST_BACKEND_PRIVATE (self);
+  std::shared_ptr < SharedEngine > shared;
   r2i::RuntimeError error;
 
   g_return_val_if_fail (priv, FALSE);
   g_return_val_if_fail (err, FALSE);
 
-  error = priv->engine->Stop ();
-  if (error.IsError ()) {
-    GST_ERROR_OBJECT (self, "Failed to stop the backend engine");
-    goto error;
+  g_mutex_lock (&priv->backend_mutex);
+
+  /* Engines keep running while other backends are using them */
+  while (priv->engines_started > 0) {
+    shared = priv->engines[priv->engines_started - 1];
+
+    g_mutex_lock (&shared->mutex);
+    if (1 == shared->started) {
+      error = shared->engine->Stop ();
+    }
+    if (!error.IsError ()) {
+      shared->started--;
+    }
+    g_mutex_unlock (&shared->mutex);
+
+    if (error.IsError ()) {
+      GST_ERROR_OBJECT (self, "Failed to stop the backend engine");
+      g_mutex_unlock (&priv->backend_mutex);
+      goto error;
+    }
+    priv->engines_started--;
   }
+  g_mutex_unlock (&priv->backend_mutex);
+
   return TRUE;
 
 error:
@@ -395,54 +670,131 @@ error:
   return FALSE;
 }
 
+static void
+gst_backend_prediction_free (gpointer data) {
+  std::shared_ptr < r2i::IPrediction > *holder =
+    static_cast < std::shared_ptr < r2i::IPrediction > *>(data);
+
+  delete holder;
+}
+
+static std::shared_ptr < SharedEngine >
+gst_backend_acquire_engine (GstBackendPrivate *priv) {
+  std::shared_ptr < SharedEngine > shared;
+  guint num_engines = priv->engines.size ();
+  guint index;
+  gint load;
+  guint i;
+
+  index = ((guint) g_atomic_int_add (&priv->next_engine, 1)) % num_engines;
+
+  /* Least loaded starts looking from the round robin choice, so idle
+     engines take turns */
+  if (GST_BACKEND_DISPATCH_LEAST_LOADED == priv->dispatch) {
+    load = G_MAXINT;
+    for (i = 0; i < num_engines; ++i) {
+      guint candidate = (index + i) % num_engines;
+      gint candidate_load = g_atomic_int_get (&priv->engines[candidate]->load);
+
+      if (candidate_load < load) {
+        load = candidate_load;
+        shared = priv->engines[candidate];
+      }
+    }
+  } else {
+    shared = priv->engines[index];
+  }
+
+  g_atomic_int_inc (&shared->load);
+
+  return shared;
+}
+
 gboolean
 gst_backend_process_frame (GstBackend *self, GstVideoFrame *input_frame,
-                           gpointer *prediction_data, gsize *prediction_size, GError **err) {
+                           GBytes **prediction_bytes, GError **err) {
+  return gst_backend_process_frames (self, &input_frame, 1, prediction_bytes,
+                                     err);
+}
+
+gboolean
+gst_backend_process_frames (GstBackend *self, GstVideoFrame **input_frames,
+                            guint num_frames, GBytes **predictions, GError **err) {
   GstBackendPrivate *priv = GST_BACKEND_PRIVATE (self);
+  std::vector < std::shared_ptr < r2i::IFrame > > frames (num_frames);
   std::shared_ptr < r2i::IPrediction > prediction;
-  std::shared_ptr < r2i::IFrame > frame;
+  std::shared_ptr < r2i::IPrediction > *holder;
+  std::shared_ptr < SharedEngine > shared;
   r2i::RuntimeError error;
+  guint i = 0;
 
   g_return_val_if_fail (priv, FALSE);
-  g_return_val_if_fail (input_frame, FALSE);
-  g_return_val_if_fail (prediction_data, FALSE);
-  g_return_val_if_fail (prediction_size, FALSE);
+  g_return_val_if_fail (input_frames, FALSE);
+  g_return_val_if_fail (num_frames > 0, FALSE);
+  g_return_val_if_fail (predictions, FALSE);
   g_return_val_if_fail (err, FALSE);
 
-  frame = priv->factory->MakeFrame (error);
-  if (error.IsError ()) {
-    goto error;
-  }
-
-  GST_LOG_OBJECT (self, "Processing Frame of size %d x %d",
-                  input_frame->info.width, input_frame->info.height);
+  GST_LOG_OBJECT (self, "Processing batch of %u frames of size %d x %d",
+                  num_frames, input_frames[0]->info.width,
+                  input_frames[0]->info.height);
 
-  error =
-    frame->Configure (input_frame->data[0], input_frame->info.width,
-                      input_frame->info.height, r2i::ImageFormat::Id::RGB);
-  if (error.IsError ()) {
-    goto error;
-  }
-
-  prediction = priv->engine->Predict (frame, error);
-  if (error.IsError ()) {
-    goto error;
+  for (i = 0; i < num_frames; ++i) {
+    predictions[i] = NULL;
   }
 
-  *prediction_size = prediction->GetResultSize ();
+  for (i = 0; i < num_frames; ++i) {
+    frames[i] = priv->factory->MakeFrame (error);
+    if (error.IsError ()) {
+      goto error;
+    }
 
-  /*could we avoid memory copy ?*/
-  *prediction_data = g_malloc(*prediction_size);
-  memcpy(*prediction_data, prediction->GetResultData(), *prediction_size);
+    error =
+      frames[i]->Configure (input_frames[i]->data[0],
+                            input_frames[i]->info.width,
+                            input_frames[i]->info.height,
+                            r2i::ImageFormat::Id::RGB);
+    if (error.IsError ()) {
+      goto error;
+    }
+  }
 
-  GST_LOG_OBJECT (self, "Size of prediction %p is %lu",
-                  *prediction_data, *prediction_size);
+  /* R2Inference frames have no batch dimension, so the batch is run
+     back to back on the engine within this single call. The engine may
+     be shared with other backends, keep the whole batch together. */
+  shared = gst_backend_acquire_engine (priv);
+  g_mutex_lock (&shared->mutex);
+  for (i = 0; i < num_frames; ++i) {
+    prediction = shared->engine->Predict (frames[i], error);
+    if (error.IsError ()) {
+      g_mutex_unlock (&shared->mutex);
+      g_atomic_int_add (&shared->load, -1);
+      goto error;
+    }
 
-  frame = nullptr;
-  prediction = nullptr;
+    /* Hand out the result without copying it, the bytes keep the
+       prediction alive until they are released */
+    holder = new std::shared_ptr < r2i::IPrediction > (prediction);
+    predictions[i] =
+      g_bytes_new_with_free_func (prediction->GetResultData (),
+                                  prediction->GetResultSize (),
+                                  gst_backend_prediction_free, holder);
+
+    GST_LOG_OBJECT (self, "Size of prediction %p is %lu",
+                    prediction->GetResultData (),
+                    (gulong) prediction->GetResultSize ());
+  }
+  g_mutex_unlock (&shared->mutex);
+  g_atomic_int_add (&shared->load, -1);
 
   return TRUE;
 error:
+  for (i = 0; i < num_frames; ++i) {
+    if (NULL != predictions[i]) {
+      g_bytes_unref (predictions[i]);
+      predictions[i] = NULL;
+    }
+  }
+
   g_set_error (err, GST_BACKEND_ERROR, error.GetCode (),
                "R2Inference Error: (Code:%d) %s", error.GetCode (),
                error.GetDescription ().c_str ());
@@ -459,6 +811,47 @@ gst_backend_set_framework_code (GstBackend *backend, r2i::FrameworkCode code) {
 
 }
 
+gboolean
+gst_backend_set_engines (GstBackend *backend, guint num_engines,
+                         GstBackendDispatch dispatch) {
+  GstBackendPrivate *priv = GST_BACKEND_PRIVATE (backend);
+  g_return_val_if_fail (priv, FALSE);
+  g_return_val_if_fail (num_engines > 0, FALSE);
+
+  g_mutex_lock (&priv->backend_mutex);
+  if (priv->engines_started > 0) {
+    g_mutex_unlock (&priv->backend_mutex);
+    GST_ERROR_OBJECT (backend, "Engines can't be changed while started");
+    return FALSE;
+  }
+
+  priv->num_engines = num_engines;
+  priv->dispatch = dispatch;
+  g_mutex_unlock (&priv->backend_mutex);
+
+  return TRUE;
+}
+
+gboolean
+gst_backend_supports_tensor_layout (GstBackend *backend,
+                                    GstInferenceTensorLayout layout) {
+  g_return_val_if_fail (backend, FALSE);
+
+  /* R2Inference frames are configured as interleaved RGB images, a
+     planar tensor can't be described to the engines */
+  return GST_INFERENCE_TENSOR_LAYOUT_NHWC == layout;
+}
+
+gboolean
+gst_backend_supports_tensor_type (GstBackend *backend,
+                                  GstInferenceTensorType type) {
+  g_return_val_if_fail (backend, FALSE);
+
+  /* R2Inference frames are configured with float data, the engines
+     can't take half or quantized tensors yet */
+  return GST_INFERENCE_TENSOR_TYPE_FLOAT32 == type;
+}
+
 guint
 gst_backend_get_framework_code (GstBackend *backend) {
   GstBackendPrivate *priv = GST_BACKEND_PRIVATE (backend);
@@ -467,6 +860,23 @@ gst_backend_get_framework_code (GstBackend *backend) {
   return priv->code;
 }
 
+GType
+gst_backend_dispatch_get_type (void) {
+  static GType dispatch_type = 0;
+  static const GEnumValue dispatch_desc[] = {
+    {GST_BACKEND_DISPATCH_ROUND_ROBIN, "Send batches to engines in turns", "round-robin"},
+    {GST_BACKEND_DISPATCH_LEAST_LOADED, "Send batches to the engine with less pending work", "least-loaded"},
+    {0, NULL, NULL}
+  };
+
+  if (!dispatch_type) {
+    dispatch_type =
+      g_enum_register_static ("GstBackendDispatch",
+                              (GEnumValue *) dispatch_desc);
+  }
+  return dispatch_type;
+}
+
 GQuark
 gst_backend_error_quark(void) {
   static GQuark q = 0;
@@ -24,9 +24,21 @@
 
 #include <gst/gst.h>
 #include <gst/video/video.h>
+#include <gst/r2inference/gstinferencemeta.h>
 
 G_BEGIN_DECLS
 #define GST_TYPE_BACKEND gst_backend_get_type ()
+#define GST_TYPE_BACKEND_DISPATCH (gst_backend_dispatch_get_type ())
+
+/**
+ * \brief How frames are distributed among the backend engines
+ */
+typedef enum
+{
+  GST_BACKEND_DISPATCH_ROUND_ROBIN,
+  GST_BACKEND_DISPATCH_LEAST_LOADED
+} GstBackendDispatch;
+
 G_DECLARE_DERIVABLE_TYPE (GstBackend, gst_backend, GST, BACKEND, GObject);
 
 struct _GstBackendClass
@@ -35,12 +47,20 @@ struct _GstBackendClass
 
 };
 
+GType gst_backend_dispatch_get_type (void);
 GQuark gst_backend_error_quark (void);
 gboolean gst_backend_start (GstBackend *, const gchar *, GError **);
 gboolean gst_backend_stop (GstBackend *, GError **);
 guint gst_backend_get_framework_code (GstBackend *);
+gboolean gst_backend_set_engines (GstBackend *, guint, GstBackendDispatch);
+gboolean gst_backend_supports_tensor_layout (GstBackend *,
+                                             GstInferenceTensorLayout);
+gboolean gst_backend_supports_tensor_type (GstBackend *,
+                                           GstInferenceTensorType);
 gboolean gst_backend_process_frame (GstBackend *, GstVideoFrame *,
-                                    gpointer *, gsize *, GError **);
+                                    GBytes **, GError **);
+gboolean gst_backend_process_frames (GstBackend *, GstVideoFrame **, guint,
+                                     GBytes **, GError **);
 
 G_END_DECLS
 #endif //__GST_BACKEND_H__
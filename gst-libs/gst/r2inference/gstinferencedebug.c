@@ -59,7 +59,11 @@ gst_inference_print_highest_probability (GstVideoInference * vi,
 
   /* Only compute the highest probability is label when debug >= 6 */
   level = gst_debug_category_get_threshold (category);
-  if (level >= gstlevel) {
+  if (level >= gstlevel && class_meta->num_top != 0) {
+    GST_CAT_LEVEL_LOG (category, gstlevel, vi,
+        "Highest probability is label %i : (%f)", class_meta->top[0].label,
+        class_meta->top[0].prob);
+  } else if (level >= gstlevel) {
     index = 0;
     max = -1;
     for (gint i = 0; i < class_meta->num_labels; ++i) {
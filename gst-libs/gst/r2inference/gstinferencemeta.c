@@ -16,6 +16,7 @@
 
 static gboolean gst_classification_meta_init (GstMeta * meta,
     gpointer params, GstBuffer * buffer);
+static gboolean gst_classification_meta_has_top (GstMeta * meta);
 static void gst_classification_meta_free (GstMeta * meta, GstBuffer * buffer);
 static void gst_detection_meta_free (GstMeta * meta, GstBuffer * buffer);
 static gboolean gst_detection_meta_init (GstMeta * meta,
@@ -31,6 +32,8 @@ static gboolean gst_detection_meta_scale (GstBuffer * transbuf,
     GstMeta * meta, GstBuffer * buffer, GstVideoMetaTransform * data);
 static gboolean gst_classification_meta_copy (GstBuffer * transbuf,
     GstMeta * meta, GstBuffer * buffer);
+static gboolean gst_inference_tensor_meta_init (GstMeta * meta,
+    gpointer params, GstBuffer * buffer);
 
 GType
 gst_embedding_meta_api_get_type (void)
@@ -46,7 +49,8 @@ gst_embedding_meta_api_get_type (void)
 }
 
 /* embedding metadata: As per now the embedding meta is ABI compatible
- * with classification. Reuse the meta methods.
+ * with the first fields of classification. Reuse the meta methods, they
+ * leave the top labels alone on embeddings.
  */
 const GstMetaInfo *
 gst_embedding_meta_get_info (void)
@@ -126,6 +130,79 @@ gst_detection_meta_get_info (void)
   return detection_meta_info;
 }
 
+GType
+gst_inference_tensor_meta_api_get_type (void)
+{
+  static volatile GType type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        gst_meta_api_type_register ("GstInferenceTensorMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+/* tensor metadata: describes the preprocessed buffer only, it is not
+ * carried over to copies.
+ */
+const GstMetaInfo *
+gst_inference_tensor_meta_get_info (void)
+{
+  static const GstMetaInfo *tensor_meta_info = NULL;
+
+  if (g_once_init_enter (&tensor_meta_info)) {
+    const GstMetaInfo *meta =
+        gst_meta_register (GST_INFERENCE_TENSOR_META_API_TYPE,
+        "GstInferenceTensorMeta", sizeof (GstInferenceTensorMeta),
+        gst_inference_tensor_meta_init, NULL, NULL);
+    g_once_init_leave (&tensor_meta_info, meta);
+  }
+  return tensor_meta_info;
+}
+
+gsize
+gst_inference_tensor_type_size (GstInferenceTensorType type)
+{
+  switch (type) {
+    case GST_INFERENCE_TENSOR_TYPE_FLOAT16:
+      return 2;
+    case GST_INFERENCE_TENSOR_TYPE_INT8:
+    case GST_INFERENCE_TENSOR_TYPE_UINT8:
+      return 1;
+    default:
+      return sizeof (gfloat);
+  }
+}
+
+BBox *
+gst_detection_meta_alloc_boxes (GstDetectionMeta * meta, gint num_boxes)
+{
+  g_return_val_if_fail (meta != NULL, NULL);
+  g_return_val_if_fail (num_boxes >= 0, NULL);
+  g_return_val_if_fail (meta->num_boxes == 0, NULL);
+
+  /* Most frames have a few detections, they live in the meta itself */
+  if (num_boxes <= GST_DETECTION_META_INLINE_BOXES) {
+    meta->boxes = meta->inline_boxes;
+  } else {
+    meta->boxes = g_new (BBox, num_boxes);
+  }
+  meta->num_boxes = num_boxes;
+
+  return meta->boxes;
+}
+
+/* Embeddings share the classification methods but end before the top
+ * labels
+ */
+static gboolean
+gst_classification_meta_has_top (GstMeta * meta)
+{
+  return meta->info->api == GST_CLASSIFICATION_META_API_TYPE;
+}
+
 static gboolean
 gst_classification_meta_init (GstMeta * meta, gpointer params,
     GstBuffer * buffer)
@@ -134,6 +211,10 @@ gst_classification_meta_init (GstMeta * meta, gpointer params,
 
   cmeta->label_probs = NULL;
   cmeta->num_labels = 0;
+  cmeta->box_index = -1;
+  if (gst_classification_meta_has_top (meta)) {
+    cmeta->num_top = 0;
+  }
 
   return TRUE;
 }
@@ -162,6 +243,20 @@ gst_detection_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
   return TRUE;
 }
 
+static gboolean
+gst_inference_tensor_meta_init (GstMeta * meta, gpointer params,
+    GstBuffer * buffer)
+{
+  GstInferenceTensorMeta *tmeta = (GstInferenceTensorMeta *) meta;
+
+  tmeta->layout = GST_INFERENCE_TENSOR_LAYOUT_NHWC;
+  tmeta->type = GST_INFERENCE_TENSOR_TYPE_FLOAT32;
+  tmeta->scale = 1;
+  tmeta->zero_point = 0;
+
+  return TRUE;
+}
+
 static void
 gst_detection_meta_free (GstMeta * meta, GstBuffer * buffer)
 {
@@ -170,7 +265,7 @@ gst_detection_meta_free (GstMeta * meta, GstBuffer * buffer)
   g_return_if_fail (meta != NULL);
   g_return_if_fail (buffer != NULL);
 
-  if (detect_meta->num_boxes != 0) {
+  if (detect_meta->boxes != detect_meta->inline_boxes) {
     g_free (detect_meta->boxes);
   }
 }
@@ -194,9 +289,8 @@ gst_detection_meta_copy (GstBuffer * dest, GstMeta * meta, GstBuffer * buffer)
     return FALSE;
   }
 
-  dmeta->num_boxes = smeta->num_boxes;
-  raw_size = dmeta->num_boxes * sizeof (BBox);
-  dmeta->boxes = (BBox *) g_malloc (raw_size);
+  raw_size = smeta->num_boxes * sizeof (BBox);
+  gst_detection_meta_alloc_boxes (dmeta, smeta->num_boxes);
   memcpy (dmeta->boxes, smeta->boxes, raw_size);
 
   return TRUE;
@@ -207,7 +301,6 @@ gst_detection_meta_scale (GstBuffer * dest,
     GstMeta * meta, GstBuffer * buffer, GstVideoMetaTransform * trans)
 {
   GstDetectionMeta *dmeta, *smeta;
-  gsize raw_size;
   gint ow, oh, nw, nh;
   gdouble hfactor, vfactor;
 
@@ -234,9 +327,7 @@ gst_detection_meta_scale (GstBuffer * dest,
   g_return_val_if_fail (ow, FALSE);
   g_return_val_if_fail (oh, FALSE);
 
-  dmeta->num_boxes = smeta->num_boxes;
-  raw_size = dmeta->num_boxes * sizeof (BBox);
-  dmeta->boxes = (BBox *) g_malloc (raw_size);
+  gst_detection_meta_alloc_boxes (dmeta, smeta->num_boxes);
 
   hfactor = nw * 1.0 / ow;
   vfactor = nh * 1.0 / oh;
@@ -287,10 +378,10 @@ gst_classification_meta_copy (GstBuffer * dest,
   GstClassificationMeta *dmeta, *smeta;
   gsize raw_size;
 
+  /* Embeddings share these methods, keep the type of the source */
   smeta = (GstClassificationMeta *) meta;
   dmeta =
-      (GstClassificationMeta *) gst_buffer_add_meta (dest,
-      GST_CLASSIFICATION_META_INFO, NULL);
+      (GstClassificationMeta *) gst_buffer_add_meta (dest, meta->info, NULL);
 
   if (!dmeta) {
     GST_ERROR ("Unable to add meta to buffer");
@@ -299,9 +390,17 @@ gst_classification_meta_copy (GstBuffer * dest,
 
   GST_LOG ("Copy classification metadata");
   dmeta->num_labels = smeta->num_labels;
-  raw_size = dmeta->num_labels * sizeof (gdouble);
-  dmeta->label_probs = (gdouble *) g_malloc (raw_size);
-  memcpy (dmeta->label_probs, smeta->label_probs, raw_size);
+  dmeta->box_index = smeta->box_index;
+  if (smeta->num_labels != 0) {
+    raw_size = dmeta->num_labels * sizeof (gdouble);
+    dmeta->label_probs = (gdouble *) g_malloc (raw_size);
+    memcpy (dmeta->label_probs, smeta->label_probs, raw_size);
+  }
+
+  if (gst_classification_meta_has_top (meta)) {
+    dmeta->num_top = smeta->num_top;
+    memcpy (dmeta->top, smeta->top, smeta->num_top * sizeof (GstLabelProb));
+  }
 
   return TRUE;
 }
@@ -21,6 +21,8 @@ G_BEGIN_DECLS
 #define GST_CLASSIFICATION_META_INFO  (gst_classification_meta_get_info())
 #define GST_DETECTION_META_API_TYPE (gst_detection_meta_api_get_type())
 #define GST_DETECTION_META_INFO  (gst_detection_meta_get_info())
+#define GST_INFERENCE_TENSOR_META_API_TYPE (gst_inference_tensor_meta_api_get_type())
+#define GST_INFERENCE_TENSOR_META_INFO  (gst_inference_tensor_meta_get_info())
 /**
  * Basic bounding box structure for detection
  */
@@ -36,7 +38,9 @@ struct _BBox
 };
 
 /**
- * Implements the placeholder for embedding information.
+ * Implements the placeholder for embedding information. The box index
+ * refers to the GstDetectionMeta box the embedding was computed on, or
+ * is -1 for the whole frame.
  */
 typedef struct _GstEmbeddingMeta GstEmbeddingMeta;
 struct _GstEmbeddingMeta
@@ -44,10 +48,28 @@ struct _GstEmbeddingMeta
   GstMeta meta;
   gint num_dimensions;
   gdouble *embedding;
+  gint box_index;
 };
 
 /**
- * Implements the placeholder for classification information.
+ * A label and its probability
+ */
+typedef struct _GstLabelProb GstLabelProb;
+struct _GstLabelProb
+{
+  gint label;
+  gfloat prob;
+};
+
+/* Most probable labels a classification meta can keep */
+#define GST_CLASSIFICATION_META_MAX_TOP 16
+
+/**
+ * Implements the placeholder for classification information. The box
+ * index refers to the GstDetectionMeta box that was classified, or is -1
+ * for the whole frame. Either label_probs holds the probability of each
+ * of the num_labels labels, or, if num_top is not 0, label_probs is NULL
+ * and top holds the num_top most probable labels, the highest first.
  */
 typedef struct _GstClassificationMeta GstClassificationMeta;
 struct _GstClassificationMeta
@@ -55,10 +77,18 @@ struct _GstClassificationMeta
   GstMeta meta;
   gint num_labels;
   gdouble *label_probs;
+  gint box_index;
+  gint num_top;
+  GstLabelProb top[GST_CLASSIFICATION_META_MAX_TOP];
 };
 
+/* Detections a meta holds without an allocation of its own */
+#define GST_DETECTION_META_INLINE_BOXES 16
+
 /**
- * Implements the placeholder for detection information.
+ * Implements the placeholder for detection information. Up to
+ * GST_DETECTION_META_INLINE_BOXES boxes are stored in inline_boxes, get
+ * room for them with gst_detection_meta_alloc_boxes.
  */
 typedef struct _GstDetectionMeta GstDetectionMeta;
 struct _GstDetectionMeta
@@ -66,6 +96,44 @@ struct _GstDetectionMeta
   GstMeta meta;
   gint num_boxes;
   BBox *boxes;
+  BBox inline_boxes[GST_DETECTION_META_INLINE_BOXES];
+};
+
+/**
+ * Order of the components in a preprocessed tensor
+ */
+typedef enum
+{
+  /* Interleaved, the channels of a pixel are next to each other */
+  GST_INFERENCE_TENSOR_LAYOUT_NHWC,
+  /* Planar, every channel is a contiguous plane */
+  GST_INFERENCE_TENSOR_LAYOUT_NCHW,
+} GstInferenceTensorLayout;
+
+/**
+ * Type of the components in a preprocessed tensor. Quantized types hold
+ * value / scale + zero point.
+ */
+typedef enum
+{
+  GST_INFERENCE_TENSOR_TYPE_FLOAT32,
+  GST_INFERENCE_TENSOR_TYPE_FLOAT16,
+  GST_INFERENCE_TENSOR_TYPE_INT8,
+  GST_INFERENCE_TENSOR_TYPE_UINT8,
+} GstInferenceTensorType;
+
+/**
+ * Describes the layout and type of a preprocessed tensor buffer. Tensors
+ * without it are interleaved 32 bit floats.
+ */
+typedef struct _GstInferenceTensorMeta GstInferenceTensorMeta;
+struct _GstInferenceTensorMeta
+{
+  GstMeta meta;
+  GstInferenceTensorLayout layout;
+  GstInferenceTensorType type;
+  gdouble scale;
+  gint zero_point;
 };
 
 GType gst_embedding_meta_api_get_type (void);
@@ -76,6 +144,13 @@ const GstMetaInfo *gst_classification_meta_get_info (void);
 
 GType gst_detection_meta_api_get_type (void);
 const GstMetaInfo *gst_detection_meta_get_info (void);
+BBox *gst_detection_meta_alloc_boxes (GstDetectionMeta * meta,
+    gint num_boxes);
+
+GType gst_inference_tensor_meta_api_get_type (void);
+const GstMetaInfo *gst_inference_tensor_meta_get_info (void);
+
+gsize gst_inference_tensor_type_size (GstInferenceTensorType type);
 
 G_END_DECLS
 #endif // GST_INFERENCE_META_H
@@ -20,26 +20,126 @@
  */
 #include "gstinferencepostprocess.h"
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
 
-#define TOTAL_BOXES_5 845
-#define TOTAL_BOXES_15 2535
+/* 4 coordinates and the objectness, the class scores follow */
+#define YOLO_BOX_DIM 5
+
+/* Boxes are indexed with gint, and the duplicate removal starts with 4
+ * pairs per box
+ */
+#define YOLO_MAX_BOXES (G_MAXINT / 4)
+
+/* Labels compared at once against the lowest of the top labels */
+#define TOP_LABELS_BLOCK 16
+
+/* Class scores compared at once against the class threshold */
+#define YOLO_CLASS_BLOCK 8
+
+#define BOX_IS_SUPPRESSED(mask, i) ((mask)[(i) / 32] & (1u << ((i) % 32)))
+#define BOX_SUPPRESS(mask, i) ((mask)[(i) / 32] |= (1u << ((i) % 32)))
+
+/* Boxes of a label sorted by their left edge, to find the intersecting
+ * ones in a single sweep
+ */
+typedef struct _BoxEdge BoxEdge;
+struct _BoxEdge
+{
+  gint label;
+  gint index;
+  gdouble left;
+  gdouble right;
+  gdouble top;
+  gdouble bottom;
+};
+
+/* Two boxes that may overlap, first is before second in the list */
+typedef struct _BoxPair BoxPair;
+struct _BoxPair
+{
+  gint first;
+  gint second;
+};
+
+/* Memory of the duplicate removal, kept from one prediction to the
+ * next. All of it is sized for the boxes of the model but the pairs,
+ * which only grow when a prediction has more than any before.
+ */
+typedef struct _BoxScratch BoxScratch;
+struct _BoxScratch
+{
+  guint32 *suppressed;
+  BoxEdge *edges;
+  /* Once found, the pairs are sorted by their position in the list,
+   * the ones of box i are pairs[offsets[i]] up to pairs[offsets[i + 1]]
+   */
+  gint *offsets;
+  BoxPair *pairs;
+  BoxPair *sorted_pairs;
+  guint pairs_size;
+};
+
+/* Where a box of the cell format lands in the model input, in pixels */
+typedef struct _YoloCell YoloCell;
+struct _YoloCell
+{
+  gdouble x;
+  gdouble y;
+  gdouble stride_x;
+  gdouble stride_y;
+  gdouble anchor_width;
+  gdouble anchor_height;
+};
+
+struct _GstYoloDecoder
+{
+  GstYoloModel model;
+  gint total_boxes;
+  gint box_size;
+  /* Size of the model output in bytes */
+  gsize output_size;
+  /* One per box in the order of the tensor, NULL for the corners format */
+  YoloCell *cells;
+  /* Room for every box of a prediction */
+  BBox *boxes;
+  BoxScratch scratch;
+};
 
 /* Functions declaration*/
 
+static void gst_insert_top_label (GstLabelProb * top, gint count,
+    gint label, gfloat prob);
+static gint gst_select_top_labels (const gfloat * probs, gint num_labels,
+    GstLabelProb * top, gint top_k);
 static gdouble gst_intersection_over_union (BBox box_1, BBox box_2);
-static void gst_delete_box (BBox * boxes, gint * num_boxes, gint index);
+static gint gst_box_edge_compare (gconstpointer a, gconstpointer b);
+static void gst_box_scratch_init (BoxScratch * scratch, gint num_boxes);
+static void gst_box_scratch_clear (BoxScratch * scratch);
+static guint gst_sweep_intersecting_boxes (BoxEdge * edges, gint count,
+    BoxScratch * scratch);
+static void gst_sort_box_pairs (BoxPair * pairs, BoxPair * sorted, guint len,
+    gint * offsets, gint num_boxes, gboolean by_first);
+static gboolean gst_find_intersecting_boxes (BBox * boxes, gint num_boxes,
+    BoxScratch * scratch);
+static gboolean gst_suppress_box (gfloat iou_thresh, BBox * boxes,
+    guint32 * suppressed, gint first, gint second);
 static void gst_remove_duplicated_boxes (gfloat iou_thresh, BBox * boxes,
-    gint * num_boxes);
-static void gst_box_to_pixels (BBox * normalized_box, gint row, gint col,
-    gint box);
+    gint * num_boxes, BoxScratch * scratch);
+static gboolean gst_any_class_above (const gfloat * scores, gint classes,
+    gfloat min_prob);
+static gint gst_get_max_class (const gfloat * scores, gint classes,
+    gdouble min_prob, gdouble * max_class_prob);
 static gdouble gst_sigmoid (gdouble x);
-static void gst_get_boxes_from_prediction (gfloat obj_thresh,
-    gfloat prob_thresh, gpointer prediction, BBox * boxes, gint * elements,
-    gint grid_h, gint grid_w, gint boxes_size);
-static void gst_get_boxes_from_prediction_float (gfloat obj_thresh,
-    gfloat prob_thresh, gpointer prediction, BBox * boxes, gint * elements,
-    gint total_boxes);
+static void gst_yolo_cell_to_pixels (const YoloCell * cell,
+    const gfloat * coords, BBox * box);
+static void gst_yolo_corners_to_pixels (const gfloat * coords, BBox * box);
+static gint gst_yolo_decoder_get_boxes (GstYoloDecoder * decoder,
+    const gfloat * prediction, gfloat obj_thresh, gfloat prob_thresh);
+static gboolean gst_yolo_grid_parse_size (GstYoloGrid * grid,
+    const gchar * size);
+static gboolean gst_yolo_grid_parse_anchors (GstYoloGrid * grid,
+    const gchar * anchors);
 
 gboolean
 gst_fill_classification_meta (GstClassificationMeta * class_meta,
@@ -48,6 +148,11 @@ gst_fill_classification_meta (GstClassificationMeta * class_meta,
   g_return_val_if_fail (class_meta != NULL, FALSE);
   g_return_val_if_fail (prediction != NULL, FALSE);
 
+  /* A meta filled before drops its labels */
+  if (class_meta->num_labels != 0) {
+    g_free (class_meta->label_probs);
+  }
+  class_meta->num_top = 0;
   class_meta->num_labels = predsize / sizeof (gfloat);
   class_meta->label_probs =
       g_malloc (class_meta->num_labels * sizeof (gdouble));
@@ -57,6 +162,99 @@ gst_fill_classification_meta (GstClassificationMeta * class_meta,
   return TRUE;
 }
 
+gboolean
+gst_fill_classification_meta_top_k (GstClassificationMeta * class_meta,
+    const gpointer prediction, gsize predsize, gint top_k)
+{
+  g_return_val_if_fail (class_meta != NULL, FALSE);
+  g_return_val_if_fail (prediction != NULL, FALSE);
+  g_return_val_if_fail (top_k >= 0, FALSE);
+  g_return_val_if_fail (top_k <= GST_CLASSIFICATION_META_MAX_TOP, FALSE);
+
+  if (top_k == 0) {
+    return gst_fill_classification_meta (class_meta, prediction, predsize);
+  }
+
+  if (class_meta->num_labels != 0) {
+    g_free (class_meta->label_probs);
+  }
+  class_meta->num_labels = 0;
+  class_meta->label_probs = NULL;
+  class_meta->num_top = gst_select_top_labels ((const gfloat *) prediction,
+      predsize / sizeof (gfloat), class_meta->top, top_k);
+
+  return TRUE;
+}
+
+/* Inserts a label in top, which is sorted and has room for it. Ties
+ * keep the label already there first.
+ */
+static void
+gst_insert_top_label (GstLabelProb * top, gint count, gint label,
+    gfloat prob)
+{
+  gint j;
+
+  for (j = count; j > 0 && prob > top[j - 1].prob; --j) {
+    top[j] = top[j - 1];
+  }
+  top[j].label = label;
+  top[j].prob = prob;
+}
+
+/* Keeps the top_k highest probabilities sorted in top with a single pass
+ * over the labels. Once top is full, most labels are below the lowest one
+ * kept and cost a single comparison, the rest replace it in place. NaN is
+ * never selected. Returns how many were kept.
+ */
+static gint
+gst_select_top_labels (const gfloat * probs, gint num_labels,
+    GstLabelProb * top, gint top_k)
+{
+  gfloat lowest;
+  gint count = 0;
+  gint block;
+  gint i;
+
+  for (i = 0; i < num_labels && count < top_k; ++i) {
+    if (!isnan (probs[i])) {
+      gst_insert_top_label (top, count++, i, probs[i]);
+    }
+  }
+
+  if (count == 0) {
+    return 0;
+  }
+
+  /* Blocks with no label above the lowest kept, the common case, are
+   * rejected with a comparison the compiler can vectorize
+   */
+  lowest = top[count - 1].prob;
+  for (; i < num_labels; i += block) {
+    gint above = 0;
+    gint j;
+
+    block = MIN (TOP_LABELS_BLOCK, num_labels - i);
+    if (block == TOP_LABELS_BLOCK) {
+      for (j = 0; j < TOP_LABELS_BLOCK; ++j) {
+        above |= probs[i + j] > lowest;
+      }
+      if (!above) {
+        continue;
+      }
+    }
+
+    for (j = i; j < i + block; ++j) {
+      if (probs[j] > lowest) {
+        gst_insert_top_label (top, count - 1, j, probs[j]);
+        lowest = top[count - 1].prob;
+      }
+    }
+  }
+
+  return count;
+}
+
 static gdouble
 gst_intersection_over_union (BBox box_1, BBox box_2)
 {
@@ -90,245 +288,676 @@ gst_intersection_over_union (BBox box_1, BBox box_2)
   return intersection_area / union_area;
 }
 
+static gint
+gst_box_edge_compare (gconstpointer a, gconstpointer b)
+{
+  const BoxEdge *edge_1 = (const BoxEdge *) a;
+  const BoxEdge *edge_2 = (const BoxEdge *) b;
+
+  if (edge_1->label != edge_2->label) {
+    return edge_1->label < edge_2->label ? -1 : 1;
+  }
+  if (edge_1->left != edge_2->left) {
+    return edge_1->left < edge_2->left ? -1 : 1;
+  }
+  return edge_1->index - edge_2->index;
+}
+
+
 static void
-gst_delete_box (BBox * boxes, gint * num_boxes, gint index)
+gst_box_scratch_init (BoxScratch * scratch, gint num_boxes)
 {
-  gint i, last_index;
+  /* A few overlapping boxes per box is the common case */
+  scratch->pairs_size = MAX (4 * num_boxes, 1);
+  scratch->suppressed = g_new (guint32, num_boxes / 32 + 1);
+  scratch->edges = g_new (BoxEdge, MAX (num_boxes, 1));
+  scratch->offsets = g_new (gint, num_boxes + 1);
+  scratch->pairs = g_new (BoxPair, scratch->pairs_size);
+  scratch->sorted_pairs = g_new (BoxPair, scratch->pairs_size);
+}
 
-  g_return_if_fail (boxes != NULL);
-  g_return_if_fail (num_boxes != NULL);
+static void
+gst_box_scratch_clear (BoxScratch * scratch)
+{
+  g_free (scratch->suppressed);
+  g_free (scratch->edges);
+  g_free (scratch->offsets);
+  g_free (scratch->pairs);
+  g_free (scratch->sorted_pairs);
+  memset (scratch, 0, sizeof (BoxScratch));
+}
 
-  if (*num_boxes > 0 && index < *num_boxes && index > -1) {
-    last_index = *num_boxes - 1;
-    for (i = index; i < last_index; i++) {
-      boxes[i] = boxes[i + 1];
+static guint
+gst_sweep_intersecting_boxes (BoxEdge * edges, gint count,
+    BoxScratch * scratch)
+{
+  /* Boxes after p in the sweep start at or right of it, they intersect
+   * it horizontally until one starts past its right edge. Returns the
+   * number of pairs stored.
+   */
+  BoxPair *pair;
+  guint len = 0;
+  gint p, q;
+
+  for (p = 0; p < count; p++) {
+    for (q = p + 1; q < count && edges[q].label == edges[p].label
+        && edges[q].left < edges[p].right; q++) {
+      if (edges[q].top < edges[p].bottom && edges[p].top < edges[q].bottom) {
+        if (len == scratch->pairs_size) {
+          scratch->pairs_size *= 2;
+          scratch->pairs = g_renew (BoxPair, scratch->pairs,
+              scratch->pairs_size);
+          scratch->sorted_pairs = g_renew (BoxPair, scratch->sorted_pairs,
+              scratch->pairs_size);
+        }
+        pair = &scratch->pairs[len++];
+        pair->first = MIN (edges[p].index, edges[q].index);
+        pair->second = MAX (edges[p].index, edges[q].index);
+      }
     }
-    *num_boxes -= 1;
   }
+
+  return len;
 }
 
 static void
-gst_remove_duplicated_boxes (gfloat iou_thresh, BBox * boxes, gint * num_boxes)
+gst_sort_box_pairs (BoxPair * pairs, BoxPair * sorted, guint len,
+    gint * offsets, gint num_boxes, gboolean by_first)
 {
-  /* Remove duplicated boxes. A box is considered a duplicate if its
-   * intersection over union metric is above a threshold
+  /* Stable counting sort by one of the boxes, offsets gets where the
+   * pairs of every box start
+   */
+  gint i, box, start, n;
+  guint p;
+
+  memset (offsets, 0, (num_boxes + 1) * sizeof (gint));
+  for (p = 0; p < len; p++) {
+    offsets[by_first ? pairs[p].first : pairs[p].second]++;
+  }
+  start = 0;
+  for (i = 0; i <= num_boxes; i++) {
+    n = offsets[i];
+    offsets[i] = start;
+    start += n;
+  }
+  for (p = 0; p < len; p++) {
+    box = by_first ? pairs[p].first : pairs[p].second;
+    sorted[offsets[box]++] = pairs[p];
+  }
+
+  /* Placing moved every offset to the start of the next box */
+  for (i = num_boxes; i > 0; i--) {
+    offsets[i] = offsets[i - 1];
+  }
+  offsets[0] = 0;
+}
+
+static gboolean
+gst_find_intersecting_boxes (BBox * boxes, gint num_boxes,
+    BoxScratch * scratch)
+{
+  /* Finds the boxes of the same label whose areas intersect. Empty
+   * boxes intersect none, so they are left out. Returns FALSE if a
+   * coordinate is not finite.
+   */
+  BoxEdge *edges = scratch->edges;
+  guint len;
+  gint i, count = 0;
+
+  for (i = 0; i < num_boxes; i++) {
+    if (!isfinite (boxes[i].x) || !isfinite (boxes[i].y)
+        || !isfinite (boxes[i].x + boxes[i].width)
+        || !isfinite (boxes[i].y + boxes[i].height)) {
+      return FALSE;
+    }
+  }
+
+  for (i = 0; i < num_boxes; i++) {
+    if (boxes[i].x + boxes[i].width > boxes[i].x
+        && boxes[i].y + boxes[i].height > boxes[i].y) {
+      edges[count].label = boxes[i].label;
+      edges[count].index = i;
+      edges[count].left = boxes[i].x;
+      edges[count].right = boxes[i].x + boxes[i].width;
+      edges[count].top = boxes[i].y;
+      edges[count].bottom = boxes[i].y + boxes[i].height;
+      count++;
+    }
+  }
+  qsort (edges, count, sizeof (BoxEdge), gst_box_edge_compare);
+
+  len = gst_sweep_intersecting_boxes (edges, count, scratch);
+
+  /* Sorting by the second box first leaves the pairs of every box in
+   * the order of the list
+   */
+  gst_sort_box_pairs (scratch->pairs, scratch->sorted_pairs, len,
+      scratch->offsets, num_boxes, FALSE);
+  gst_sort_box_pairs (scratch->sorted_pairs, scratch->pairs, len,
+      scratch->offsets, num_boxes, TRUE);
+
+  return TRUE;
+}
+
+static gboolean
+gst_suppress_box (gfloat iou_thresh, BBox * boxes, guint32 * suppressed,
+    gint first, gint second)
+{
+  /* Suppresses the box with the lowest probability if they are
+   * duplicated, returns TRUE if it is the first one
    */
   gdouble iou;
-  gint it1, it2;
+
+  iou = gst_intersection_over_union (boxes[first], boxes[second]);
+  if (iou > iou_thresh) {
+    if (boxes[first].prob > boxes[second].prob) {
+      BOX_SUPPRESS (suppressed, second);
+    } else {
+      BOX_SUPPRESS (suppressed, first);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void
+gst_remove_duplicated_boxes (gfloat iou_thresh, BBox * boxes, gint * num_boxes,
+    BoxScratch * scratch)
+{
+  /* Remove duplicated boxes. A box is considered a duplicate if its
+   * intersection over union metric is above a threshold. Every box left
+   * is compared with the ones left after it, in order, it suppresses the
+   * ones it beats until one has a higher or equal probability and
+   * suppresses it instead.
+   *
+   * Boxes whose areas do not intersect are never above a threshold that
+   * is not negative, so only the pairs found by the sweep are compared.
+   */
+  guint32 *suppressed;
+  gboolean found = FALSE;
+  gint it1, it2, p, kept;
 
   g_return_if_fail (boxes != NULL);
   g_return_if_fail (num_boxes != NULL);
+  g_return_if_fail (scratch != NULL);
+
+  suppressed = scratch->suppressed;
+  memset (suppressed, 0, (*num_boxes / 32 + 1) * sizeof (guint32));
+
+  if (iou_thresh >= 0) {
+    found = gst_find_intersecting_boxes (boxes, *num_boxes, scratch);
+  }
 
   for (it1 = 0; it1 < *num_boxes - 1; it1++) {
-    for (it2 = it1 + 1; it2 < *num_boxes; it2++) {
-      if (boxes[it1].label == boxes[it2].label) {
-        iou = gst_intersection_over_union (boxes[it1], boxes[it2]);
-        if (iou > iou_thresh) {
-          if (boxes[it1].prob > boxes[it2].prob) {
-            gst_delete_box (boxes, num_boxes, it2);
-            it2--;
-          } else {
-            gst_delete_box (boxes, num_boxes, it1);
-            it1--;
-            break;
-          }
+    if (BOX_IS_SUPPRESSED (suppressed, it1)) {
+      continue;
+    }
+
+    /* Otherwise every pair of the same label is compared */
+    if (!found) {
+      for (it2 = it1 + 1; it2 < *num_boxes; it2++) {
+        if (!BOX_IS_SUPPRESSED (suppressed, it2)
+            && boxes[it1].label == boxes[it2].label
+            && gst_suppress_box (iou_thresh, boxes, suppressed, it1, it2)) {
+          break;
         }
       }
+      continue;
+    }
+
+    for (p = scratch->offsets[it1]; p < scratch->offsets[it1 + 1]; p++) {
+      it2 = scratch->pairs[p].second;
+      if (!BOX_IS_SUPPRESSED (suppressed, it2)
+          && gst_suppress_box (iou_thresh, boxes, suppressed, it1, it2)) {
+        break;
+      }
+    }
+  }
+
+  /* Keep the boxes left in their order */
+  kept = 0;
+  for (it1 = 0; it1 < *num_boxes; it1++) {
+    if (!BOX_IS_SUPPRESSED (suppressed, it1)) {
+      boxes[kept++] = boxes[it1];
     }
   }
+  *num_boxes = kept;
 }
 
-/* sigmoid approximation as a lineal function */
+/* logistic function, exp is much cheaper than pow with base e */
 static gdouble
 gst_sigmoid (gdouble x)
 {
-  return 1.0 / (1.0 + pow (M_E, -1.0 * x));
+  return 1.0 / (1.0 + exp (-x));
 }
 
-static void
-gst_box_to_pixels (BBox * normalized_box, gint row, gint col, gint box)
+
+
+static gboolean
+gst_any_class_above (const gfloat * scores, gint classes, gfloat min_prob)
 {
-  gint grid_size = 32;
-  const gfloat box_anchors[] =
-      { 1.08, 1.19, 3.42, 4.41, 6.63, 11.38, 9.42, 5.11, 16.62, 10.52 };
+  /* Most cells have no class over the threshold, they are rejected in
+   * blocks the compiler can vectorize before any maximum is searched
+   */
+  gint c, j;
+
+  for (c = 0; c + YOLO_CLASS_BLOCK <= classes; c += YOLO_CLASS_BLOCK) {
+    gint above = 0;
 
-  g_return_if_fail (normalized_box != NULL);
+    for (j = 0; j < YOLO_CLASS_BLOCK; ++j) {
+      above |= scores[c + j] > min_prob;
+    }
+    if (above) {
+      return TRUE;
+    }
+  }
+
+  for (; c < classes; ++c) {
+    if (scores[c] > min_prob) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
 
-  /* adjust the box center according to its cell and grid dim */
-  normalized_box->x = (col + gst_sigmoid (normalized_box->x)) * grid_size;
-  normalized_box->y = (row + gst_sigmoid (normalized_box->y)) * grid_size;
+static gint
+gst_get_max_class (const gfloat * scores, gint classes, gdouble min_prob,
+    gdouble * max_class_prob)
+{
+  /* The running maximum starts at min_prob instead of zero, scores that
+   * can not pass the threshold are rejected by a single comparison
+   * and never touch the maximum
+   */
+  gdouble max_score = min_prob;
+  gint c, max_class_index = 0;
 
-  /* adjust the lengths and widths */
-  normalized_box->width =
-      pow (M_E, normalized_box->width) * box_anchors[2 * box] * grid_size;
-  normalized_box->height =
-      pow (M_E, normalized_box->height) * box_anchors[2 * box + 1] * grid_size;
+  for (c = 0; c < classes; c++) {
+    if (scores[c] > max_score) {
+      max_score = scores[c];
+      max_class_index = c;
+    }
+  }
+
+  *max_class_prob = max_score;
+  return max_class_index;
 }
 
 static void
-gst_get_boxes_from_prediction (gfloat obj_thresh, gfloat prob_thresh,
-    gpointer prediction, BBox * boxes, gint * elements, gint grid_h,
-    gint grid_w, gint boxes_size)
+gst_yolo_cell_to_pixels (const YoloCell * cell, const gfloat * coords,
+    BBox * box)
 {
-  gint i, j, c, b;
-  gint index;
-  gdouble obj_prob;
-  gdouble cur_class_prob, max_class_prob;
-  gint max_class_prob_index;
-  gint counter = 0;
-  gint box_dim = 5;
-  gint classes = 20;
+  /* move the center into its cell and scale the anchor */
+  box->width = exp (coords[2]) * cell->anchor_width;
+  box->height = exp (coords[3]) * cell->anchor_height;
+  box->x = cell->x + gst_sigmoid (coords[0]) * cell->stride_x;
+  box->y = cell->y + gst_sigmoid (coords[1]) * cell->stride_y;
+
+  /* from the center to the top left corner */
+  box->x = box->x - box->width * 0.5;
+  box->y = box->y - box->height * 0.5;
+}
 
-  g_return_if_fail (boxes != NULL);
-  g_return_if_fail (elements != NULL);
-
-  /* Iterate rows */
-  for (i = 0; i < grid_h; i++) {
-    /* Iterate colums */
-    for (j = 0; j < grid_w; j++) {
-      /* Iterate boxes */
-      for (b = 0; b < boxes_size; b++) {
-        index = ((i * grid_w + j) * boxes_size + b) * (box_dim + classes);
-        obj_prob = ((gfloat *) prediction)[index + 4];
-        /* If the Objectness score is over the threshold add it to the boxes list */
-        if (obj_prob > obj_thresh) {
-          max_class_prob = 0;
-          max_class_prob_index = 0;
-          for (c = 0; c < classes; c++) {
-            cur_class_prob = ((gfloat *) prediction)[index + box_dim + c];
-            if (cur_class_prob > max_class_prob) {
-              max_class_prob = cur_class_prob;
-              max_class_prob_index = c;
-            }
-          }
-          if (max_class_prob > prob_thresh) {
-            BBox result;
-            result.label = max_class_prob_index;
-            result.prob = max_class_prob;
-            result.x = ((gfloat *) prediction)[index];
-            result.y = ((gfloat *) prediction)[index + 1];
-            result.width = ((gfloat *) prediction)[index + 2];
-            result.height = ((gfloat *) prediction)[index + 3];
-            gst_box_to_pixels (&result, i, j, b);
-            result.x = result.x - result.width * 0.5;
-            result.y = result.y - result.height * 0.5;
-            boxes[counter] = result;
-            counter = counter + 1;
-          }
-        }
-      }
+static void
+gst_yolo_corners_to_pixels (const gfloat * coords, BBox * box)
+{
+  box->x = coords[0];
+  box->y = coords[1];
+  box->width = coords[2] - box->x;
+  box->height = coords[3] - box->y;
+}
+
+static gboolean
+gst_yolo_grid_parse_size (GstYoloGrid * grid, const gchar * size)
+{
+  gint64 width, height;
+  gchar *end;
+
+  width = g_ascii_strtoll (size, &end, 10);
+  if (end == size || 'x' != *end) {
+    return FALSE;
+  }
+
+  size = end + 1;
+  height = g_ascii_strtoll (size, &end, 10);
+  if (end == size || '\0' != *end) {
+    return FALSE;
+  }
+
+  if (width <= 0 || width > GST_YOLO_MAX_GRID_SIZE || height <= 0
+      || height > GST_YOLO_MAX_GRID_SIZE) {
+    return FALSE;
+  }
+
+  grid->width = width;
+  grid->height = height;
+
+  return TRUE;
+}
+
+static gboolean
+gst_yolo_grid_parse_anchors (GstYoloGrid * grid, const gchar * anchors)
+{
+  gchar **values;
+  gchar *end;
+  guint i, count;
+  gboolean ret = FALSE;
+
+  values = g_strsplit (anchors, ",", -1);
+  count = g_strv_length (values);
+
+  /* Anchors come in width and height pairs */
+  if (0 == count || 0 != count % 2 || count > 2 * GST_YOLO_MAX_ANCHORS) {
+    goto out;
+  }
+
+  for (i = 0; i < count; i++) {
+    const gchar *value = g_strstrip (values[i]);
+
+    grid->anchors[i] = g_ascii_strtod (value, &end);
+    if (end == value || '\0' != *end || grid->anchors[i] <= 0) {
+      goto out;
     }
-    *elements = counter;
   }
+
+  grid->num_anchors = count / 2;
+  ret = TRUE;
+
+out:
+  g_strfreev (values);
+  return ret;
 }
 
 gboolean
-gst_create_boxes (GstVideoInference * vi, const gpointer prediction,
-    GstDetectionMeta * detect_meta, GstVideoInfo * info_model,
-    gboolean * valid_prediction, BBox ** resulting_boxes,
-    gint * elements, gfloat obj_thresh, gfloat prob_thresh, gfloat iou_thresh)
-{
-  gint grid_h = 13;
-  gint grid_w = 13;
-  gint boxes_size = 5;
-  BBox boxes[TOTAL_BOXES_5];
-  *elements = 0;
-
-  g_return_val_if_fail (vi != NULL, FALSE);
-  g_return_val_if_fail (prediction != NULL, FALSE);
-  g_return_val_if_fail (detect_meta != NULL, FALSE);
-  g_return_val_if_fail (info_model != NULL, FALSE);
-  g_return_val_if_fail (valid_prediction != NULL, FALSE);
-  g_return_val_if_fail (resulting_boxes != NULL, FALSE);
-  g_return_val_if_fail (elements != NULL, FALSE);
+gst_yolo_model_set_grids (GstYoloModel * model, const gchar * grids,
+    const gchar * anchors)
+{
+  GstYoloGrid parsed[GST_YOLO_MAX_GRIDS] = { {0} };
+  gchar **sizes;
+  gchar **groups;
+  guint g, num_grids;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (model != NULL, FALSE);
+  g_return_val_if_fail (grids != NULL, FALSE);
+  g_return_val_if_fail (anchors != NULL, FALSE);
+
+  sizes = g_strsplit (grids, ";", -1);
+  groups = g_strsplit (anchors, ";", -1);
+  num_grids = g_strv_length (sizes);
+
+  /* One group of anchors per grid */
+  if (0 == num_grids || num_grids > GST_YOLO_MAX_GRIDS
+      || num_grids != g_strv_length (groups)) {
+    goto out;
+  }
+
+  for (g = 0; g < num_grids; g++) {
+    if (!gst_yolo_grid_parse_size (&parsed[g], g_strstrip (sizes[g]))
+        || !gst_yolo_grid_parse_anchors (&parsed[g], groups[g])) {
+      goto out;
+    }
+  }
 
-  gst_get_boxes_from_prediction (obj_thresh, prob_thresh, prediction, boxes,
-      elements, grid_h, grid_w, boxes_size);
-  gst_remove_duplicated_boxes (iou_thresh, boxes, elements);
+  model->num_grids = num_grids;
+  memcpy (model->grids, parsed, sizeof (parsed));
+  ret = TRUE;
 
-  *resulting_boxes = g_malloc (*elements * sizeof (BBox));
-  memcpy (*resulting_boxes, boxes, *elements * sizeof (BBox));
-  return TRUE;
+out:
+  g_strfreev (sizes);
+  g_strfreev (groups);
+  return ret;
 }
 
-static void
-gst_get_boxes_from_prediction_float (gfloat obj_thresh, gfloat prob_thresh,
-    gpointer prediction, BBox * boxes, gint * elements, gint total_boxes)
+GstYoloDecoder *
+gst_yolo_decoder_new (const GstYoloModel * model)
 {
-  gint i, c;
-  gint index;
-  gdouble obj_prob;
-  gdouble cur_class_prob, max_class_prob;
-  gint max_class_prob_index;
-  gint counter = 0;
-  gint box_class_base;
-  gint box_dim = 5;
-  gint classes = 80;
-  gint dimensions_per_box = box_dim + classes;
+  GstYoloDecoder *decoder;
+  const GstYoloGrid *grid;
+  YoloCell *cell;
+  gsize total_boxes = 0, grid_boxes, box_size;
+  gint g, row, col, a;
+
+  g_return_val_if_fail (model != NULL, NULL);
+  g_return_val_if_fail (model->input_width > 0, NULL);
+  g_return_val_if_fail (model->input_width <= GST_YOLO_MAX_INPUT_SIZE, NULL);
+  g_return_val_if_fail (model->input_height > 0, NULL);
+  g_return_val_if_fail (model->input_height <= GST_YOLO_MAX_INPUT_SIZE,
+      NULL);
+  g_return_val_if_fail (model->classes > 0, NULL);
+  g_return_val_if_fail (model->classes <= GST_YOLO_MAX_CLASSES, NULL);
+  g_return_val_if_fail (model->num_grids > 0, NULL);
+  g_return_val_if_fail (model->num_grids <= GST_YOLO_MAX_GRIDS, NULL);
+
+  for (g = 0; g < model->num_grids; g++) {
+    grid = &model->grids[g];
+    g_return_val_if_fail (grid->width > 0, NULL);
+    g_return_val_if_fail (grid->width <= GST_YOLO_MAX_GRID_SIZE, NULL);
+    g_return_val_if_fail (grid->height > 0, NULL);
+    g_return_val_if_fail (grid->height <= GST_YOLO_MAX_GRID_SIZE, NULL);
+    g_return_val_if_fail (grid->num_anchors > 0, NULL);
+    g_return_val_if_fail (grid->num_anchors <= GST_YOLO_MAX_ANCHORS, NULL);
+
+    grid_boxes = (gsize) grid->width * grid->height * grid->num_anchors;
+    if (grid_boxes > YOLO_MAX_BOXES - total_boxes) {
+      GST_ERROR ("The model has more than %d boxes", YOLO_MAX_BOXES);
+      return NULL;
+    }
+    total_boxes += grid_boxes;
+  }
 
-  g_return_if_fail (boxes != NULL);
-  g_return_if_fail (elements != NULL);
-
-  /* Iterate boxes */
-  for (i = 0; i < total_boxes; i++) {
-    index = i * dimensions_per_box;
-    obj_prob = ((gfloat *) prediction)[index + 4];
-
-    /* If the objectness score is over the threshold add it to the boxes list */
-    if (obj_prob > obj_thresh) {
-      max_class_prob = 0;
-      max_class_prob_index = 0;
-      box_class_base = index + box_dim;
-
-      /* Iterate each class probability */
-      for (c = 0; c < classes; c++) {
-        cur_class_prob = ((gfloat *) prediction)[box_class_base + c];
-        if (cur_class_prob > max_class_prob) {
-          max_class_prob = cur_class_prob;
-          max_class_prob_index = c;
+  box_size = YOLO_BOX_DIM + (gsize) model->classes;
+  if (total_boxes > G_MAXSIZE / sizeof (gfloat) / box_size) {
+    GST_ERROR ("The model output of %" G_GSIZE_FORMAT " boxes of %"
+        G_GSIZE_FORMAT " values is too large", total_boxes, box_size);
+    return NULL;
+  }
+
+  decoder = g_new0 (GstYoloDecoder, 1);
+  decoder->model = *model;
+  decoder->total_boxes = total_boxes;
+  decoder->box_size = box_size;
+  decoder->output_size = total_boxes * box_size * sizeof (gfloat);
+  decoder->boxes = g_new (BBox, total_boxes);
+  gst_box_scratch_init (&decoder->scratch, total_boxes);
+
+  if (GST_YOLO_BOX_FORMAT_CELL != model->box_format) {
+    return decoder;
+  }
+
+  /* The position and anchor of every box in pixels, so decoding a box
+   * only applies its own offsets and scales
+   */
+  decoder->cells = g_new (YoloCell, total_boxes);
+  cell = decoder->cells;
+  for (g = 0; g < model->num_grids; g++) {
+    gdouble stride_x, stride_y;
+
+    grid = &model->grids[g];
+    stride_x = (gdouble) model->input_width / grid->width;
+    stride_y = (gdouble) model->input_height / grid->height;
+
+    for (row = 0; row < grid->height; row++) {
+      for (col = 0; col < grid->width; col++) {
+        for (a = 0; a < grid->num_anchors; a++, cell++) {
+          cell->x = col * stride_x;
+          cell->y = row * stride_y;
+          cell->stride_x = stride_x;
+          cell->stride_y = stride_y;
+          cell->anchor_width = grid->anchors[2 * a] * stride_x;
+          cell->anchor_height = grid->anchors[2 * a + 1] * stride_y;
         }
       }
+    }
+  }
+
+  return decoder;
+}
+
+void
+gst_yolo_decoder_free (GstYoloDecoder * decoder)
+{
+  g_return_if_fail (decoder != NULL);
+
+  g_free (decoder->cells);
+  g_free (decoder->boxes);
+  gst_box_scratch_clear (&decoder->scratch);
+  g_free (decoder);
+}
+
+static gint
+gst_yolo_decoder_get_boxes (GstYoloDecoder * decoder,
+    const gfloat * prediction, gfloat obj_thresh, gfloat prob_thresh)
+{
+  const gfloat *scores;
+  BBox *box;
+  gdouble max_class_prob;
+  gint i, max_class_prob_index;
+  gint counter = 0;
+  /* Only classes over zero and over the threshold are reported */
+  gfloat min_class_prob = MAX (prob_thresh, 0);
+
+  for (i = 0; i < decoder->total_boxes; i++) {
+    scores = prediction + (gsize) i * decoder->box_size;
+
+    /* If the objectness score is over the threshold add it to the boxes
+     * list. A cell without a class over the threshold has no box, unless
+     * a negative threshold reports it with a zero probability.
+     */
+    if (scores[4] > obj_thresh && (prob_thresh < 0
+            || gst_any_class_above (scores + YOLO_BOX_DIM,
+                decoder->model.classes, min_class_prob))) {
+      max_class_prob_index = gst_get_max_class (scores + YOLO_BOX_DIM,
+          decoder->model.classes, min_class_prob, &max_class_prob);
 
       if (max_class_prob > prob_thresh) {
-        BBox result;
-        result.label = max_class_prob_index;
-        result.prob = max_class_prob;
-        result.x = ((gfloat *) prediction)[index];
-        result.y = ((gfloat *) prediction)[index + 1];
-        result.width = ((gfloat *) prediction)[index + 2] - result.x;
-        result.height = ((gfloat *) prediction)[index + 3] - result.y;
-        boxes[counter] = result;
+        box = &decoder->boxes[counter];
+        box->label = max_class_prob_index;
+        box->prob = max_class_prob;
+        if (decoder->cells) {
+          gst_yolo_cell_to_pixels (&decoder->cells[i], scores, box);
+        } else {
+          gst_yolo_corners_to_pixels (scores, box);
+        }
         counter = counter + 1;
       }
     }
-    *elements = counter;
   }
+
+  return counter;
 }
 
 gboolean
-gst_create_boxes_float (GstVideoInference * vi, const gpointer prediction,
-    GstDetectionMeta * detect_meta, GstVideoInfo * info_model,
-    gboolean * valid_prediction, BBox ** resulting_boxes,
-    gint * elements, gdouble obj_thresh, gdouble prob_thresh,
-    gdouble iou_thresh)
+gst_yolo_decoder_create_boxes (GstYoloDecoder * decoder,
+    const gpointer prediction, gsize predsize, GstDetectionMeta * detect_meta,
+    gfloat obj_thresh, gfloat prob_thresh, gfloat iou_thresh)
 {
-  gint total_boxes = 2535;
-  BBox boxes[TOTAL_BOXES_15];
-  *elements = 0;
+  gint elements;
 
-  g_return_val_if_fail (vi != NULL, FALSE);
+  g_return_val_if_fail (decoder != NULL, FALSE);
   g_return_val_if_fail (prediction != NULL, FALSE);
   g_return_val_if_fail (detect_meta != NULL, FALSE);
-  g_return_val_if_fail (info_model != NULL, FALSE);
-  g_return_val_if_fail (valid_prediction != NULL, FALSE);
-  g_return_val_if_fail (resulting_boxes != NULL, FALSE);
-  g_return_val_if_fail (elements != NULL, FALSE);
 
-  gst_get_boxes_from_prediction_float (obj_thresh, prob_thresh, prediction,
-      boxes, elements, total_boxes);
-  gst_remove_duplicated_boxes (iou_thresh, boxes, elements);
+  if (predsize < decoder->output_size) {
+    GST_ERROR ("Prediction of %" G_GSIZE_FORMAT " bytes is "
+        "smaller than the %" G_GSIZE_FORMAT " bytes of the model output",
+        predsize, decoder->output_size);
+    return FALSE;
+  }
+
+  elements = gst_yolo_decoder_get_boxes (decoder,
+      (const gfloat *) prediction, obj_thresh, prob_thresh);
+  gst_remove_duplicated_boxes (iou_thresh, decoder->boxes, &elements,
+      &decoder->scratch);
 
-  *resulting_boxes = g_malloc (*elements * sizeof (BBox));
-  memcpy (*resulting_boxes, boxes, *elements * sizeof (BBox));
+  if (!gst_detection_meta_alloc_boxes (detect_meta, elements)) {
+    return FALSE;
+  }
+  memcpy (detect_meta->boxes, decoder->boxes, elements * sizeof (BBox));
   return TRUE;
 }
+
+void
+gst_yolo_descriptor_set_property (GstVideoInference * vi,
+    GstYoloDescriptor * descriptor, GParamSpec * pspec, const GValue * value)
+{
+  GstState actual_state;
+  const gchar *name;
+
+  g_return_if_fail (vi != NULL);
+  g_return_if_fail (descriptor != NULL);
+  g_return_if_fail (pspec != NULL);
+  g_return_if_fail (value != NULL);
+
+  name = g_param_spec_get_name (pspec);
+
+  /* The decoder and the tensor size are built from it on start */
+  gst_element_get_state (GST_ELEMENT (vi), &actual_state, NULL, GST_SECOND);
+  GST_OBJECT_LOCK (vi);
+  if (actual_state > GST_STATE_READY) {
+    GST_ERROR_OBJECT (vi,
+        "The model descriptor can only be set in the NULL or READY states");
+    goto out;
+  }
+
+  if (g_str_equal (name, "input-width")) {
+    descriptor->input_width = g_value_get_int (value);
+  } else if (g_str_equal (name, "input-height")) {
+    descriptor->input_height = g_value_get_int (value);
+  } else if (g_str_equal (name, "classes")) {
+    descriptor->classes = g_value_get_int (value);
+  } else if (g_str_equal (name, "grids")) {
+    g_free (descriptor->grids);
+    descriptor->grids = g_value_dup_string (value);
+  } else if (g_str_equal (name, "anchors")) {
+    g_free (descriptor->anchors);
+    descriptor->anchors = g_value_dup_string (value);
+  } else {
+    GST_ERROR_OBJECT (vi, "Property %s is not part of the model descriptor",
+        name);
+  }
+
+out:
+  GST_OBJECT_UNLOCK (vi);
+}
+
+GstYoloDecoder *
+gst_yolo_descriptor_new_decoder (GstVideoInference * vi,
+    GstYoloDescriptor * descriptor, GstYoloBoxFormat box_format)
+{
+  GstYoloDecoder *decoder;
+  GstYoloModel model = { 0 };
+  gboolean valid;
+
+  g_return_val_if_fail (vi != NULL, NULL);
+  g_return_val_if_fail (descriptor != NULL, NULL);
+
+  GST_OBJECT_LOCK (vi);
+  model.input_width = descriptor->input_width;
+  model.input_height = descriptor->input_height;
+  model.classes = descriptor->classes;
+  model.box_format = box_format;
+  valid = NULL != descriptor->grids && NULL != descriptor->anchors
+      && gst_yolo_model_set_grids (&model, descriptor->grids,
+      descriptor->anchors);
+  GST_OBJECT_UNLOCK (vi);
+
+  if (!valid) {
+    GST_ELEMENT_ERROR (vi, LIBRARY, SETTINGS,
+        ("Invalid model grids or anchors"), (NULL));
+    return NULL;
+  }
+
+  decoder = gst_yolo_decoder_new (&model);
+  if (NULL == decoder) {
+    GST_ELEMENT_ERROR (vi, LIBRARY, SETTINGS,
+        ("Unable to build the decoder of the model"), (NULL));
+    return NULL;
+  }
+
+  gst_video_inference_set_model_size (vi, model.input_width,
+      model.input_height);
+
+  return decoder;
+}
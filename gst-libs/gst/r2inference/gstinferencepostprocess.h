@@ -39,42 +39,165 @@ gboolean gst_fill_classification_meta(GstClassificationMeta *class_meta, const g
     gsize predsize);
 
 /**
- * \brief Fill all the detection meta with the boxes
+ * \brief Fill the classification meta with the most probable labels only,
+ * so its size does not depend on the number of labels
  *
- * \param vi Father object of every architecture
+ * \param class_meta Meta to fill
  * \param prediction Value of the prediction
- * \param detect_meta Meta to fill
- * \param info_model Info about the model to use
- * \param valid_prediction Check if the prediction is valid
- * \param resulting_boxes The output boxes of the prediction
- * \param elements The number of objects
- * \param obj_thresh Objectness threshold
- * \param prob_thresh Class probability threshold
- * \param iou_thresh Intersection over union threshold
+ * \param predsize Size of the prediction
+ * \param top_k Labels to keep, up to GST_CLASSIFICATION_META_MAX_TOP. 0
+ * keeps the probability of every label like gst_fill_classification_meta
+ */
+
+gboolean gst_fill_classification_meta_top_k(GstClassificationMeta *class_meta, const gpointer prediction, gsize predsize, gint top_k);
+
+/**
+ * \brief How a YOLO model encodes every box in its output
+ */
+typedef enum
+{
+  /* Center offsets in the cell and log scales of the anchor, the
+   * decoder moves and scales them to pixels */
+  GST_YOLO_BOX_FORMAT_CELL,
+  /* Top left and bottom right corners already in pixels */
+  GST_YOLO_BOX_FORMAT_CORNERS,
+} GstYoloBoxFormat;
+
+#define GST_YOLO_MAX_GRIDS 3
+#define GST_YOLO_MAX_ANCHORS 9
+#define GST_YOLO_MAX_GRID_SIZE 1024
+#define GST_YOLO_MAX_CLASSES 10000
+#define GST_YOLO_MAX_INPUT_SIZE 8192
+
+/**
+ * \brief One output grid of a YOLO model. The cells are stored row by
+ * row, with one box per anchor, and every box holds its 4 coordinates,
+ * the objectness and one score per class
+ */
+typedef struct _GstYoloGrid GstYoloGrid;
+struct _GstYoloGrid
+{
+  gint width;
+  gint height;
+  gint num_anchors;
+  /* Width and height pairs in cells of this grid, only the cell format
+   * reads them */
+  gfloat anchors[2 * GST_YOLO_MAX_ANCHORS];
+};
+
+/**
+ * \brief Describes the output tensor of a YOLO model, the grids are
+ * stored one after the other
+ */
+typedef struct _GstYoloModel GstYoloModel;
+struct _GstYoloModel
+{
+  gint input_width;
+  gint input_height;
+  gint classes;
+  GstYoloBoxFormat box_format;
+  gint num_grids;
+  GstYoloGrid grids[GST_YOLO_MAX_GRIDS];
+};
+
+/**
+ * \brief Set the grids of a YOLO model from their text description, so
+ * models other than the built in ones can be described at runtime
+ *
+ * \param model Model to set the grids of, left untouched on failure
+ * \param grids Width and height of every grid, like "13x13;26x26", up to
+ * GST_YOLO_MAX_GRID_SIZE
+ * \param anchors Width and height pairs of the anchors of every grid, in
+ * cells of that grid and in the same order, like "1,2,3,4;0.5,1,1,2".
+ * The corners format only reads how many there are
+ *
+ * \return FALSE if the descriptions are malformed or do not match
+ */
+
+gboolean gst_yolo_model_set_grids(GstYoloModel * model, const gchar * grids, const gchar * anchors);
+
+/**
+ * \brief Decodes the boxes of a YOLO model, with the position and
+ * anchor of every box precomputed
+ */
+typedef struct _GstYoloDecoder GstYoloDecoder;
+
+/**
+ * \brief Build a decoder for the given model
+ *
+ * \param model Description of the model output, it is copied
+ *
+ * \return A new decoder, release it with gst_yolo_decoder_free. NULL if
+ * the model output is too large
  */
-gboolean gst_create_boxes (GstVideoInference * vi, const gpointer prediction,
-    GstDetectionMeta *detect_meta, GstVideoInfo * info_model,
-    gboolean * valid_prediction, BBox ** resulting_boxes,
-    gint * elements, gfloat obj_thresh, gfloat prob_thresh, gfloat iou_thresh);
+
+GstYoloDecoder * gst_yolo_decoder_new(const GstYoloModel * model);
 
 /**
- * \brief Fill all the detection meta with the boxes
+ * \brief Release a decoder
  *
- * \param vi Father object of every architecture
+ * \param decoder The decoder to release
+ */
+
+void gst_yolo_decoder_free(GstYoloDecoder * decoder);
+
+/**
+ * \brief Decode the boxes of a prediction, remove the duplicated ones
+ * and fill the detection meta with the rest
+ *
+ * \param decoder Decoder of the model that made the prediction
  * \param prediction Value of the prediction
- * \param detect_meta Meta to fill
- * \param info_model Info about the model to use
- * \param valid_prediction Check if the prediction is valid
- * \param resulting_boxes The output boxes of the prediction
- * \param elements The number of objects
+ * \param predsize Size of the prediction in bytes
+ * \param detect_meta Meta to fill, it must have no boxes yet
  * \param obj_thresh Objectness threshold
  * \param prob_thresh Class probability threshold
  * \param iou_thresh Intersection over union threshold
+ *
+ * \return FALSE if the prediction is smaller than the model output
+ */
+
+gboolean gst_yolo_decoder_create_boxes(GstYoloDecoder * decoder, const gpointer prediction, gsize predsize, GstDetectionMeta * detect_meta, gfloat obj_thresh, gfloat prob_thresh, gfloat iou_thresh);
+
+/**
+ * \brief A YOLO model as described by the input-width, input-height,
+ * classes, grids and anchors properties of an element. The element
+ * object lock guards it.
  */
-gboolean gst_create_boxes_float (GstVideoInference * vi, const gpointer prediction,
-    GstDetectionMeta *detect_meta, GstVideoInfo * info_model,
-    gboolean * valid_prediction, BBox ** resulting_boxes,
-    gint * elements, gdouble obj_thresh, gdouble prob_thresh, gdouble iou_thresh);
+typedef struct _GstYoloDescriptor GstYoloDescriptor;
+struct _GstYoloDescriptor
+{
+  gint input_width;
+  gint input_height;
+  gint classes;
+  gchar *grids;
+  gchar *anchors;
+};
+
+/**
+ * \brief Set one of the model properties of an element, only allowed in
+ * the NULL and READY states
+ *
+ * \param vi The element
+ * \param descriptor Descriptor of the element
+ * \param pspec Spec of the property, selected by its name
+ * \param value Value of the property
+ */
+
+void gst_yolo_descriptor_set_property(GstVideoInference * vi, GstYoloDescriptor * descriptor, GParamSpec * pspec, const GValue * value);
+
+/**
+ * \brief Build the decoder of an element from its descriptor and use the
+ * model input size for the element. Call it from the start vmethod.
+ *
+ * \param vi The element
+ * \param descriptor Descriptor of the element
+ * \param box_format How the model encodes its boxes
+ *
+ * \return A new decoder, NULL after posting an element error if the
+ * descriptor is invalid
+ */
+
+GstYoloDecoder * gst_yolo_descriptor_new_decoder(GstVideoInference * vi, GstYoloDescriptor * descriptor, GstYoloBoxFormat box_format);
 
 G_END_DECLS
 
@@ -19,48 +19,1666 @@
  *
  */
 #include "gstinferencepreprocess.h"
+#include "gstinferencemeta.h"
 #include <math.h>
+#include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Normalization of a row of packed 8 bit pixels into floats. The
+ * shuffle takes 4 input pixels to their 12 output components, mean and
+ * std repeat the per output channel values every 3 entries. Math is done
+ * in double, so every kernel matches the scalar results bit by bit.
+ *
+ * Planar kernels have a non zero plane, the distance between the output
+ * channels. The shuffle then groups the 4 values of every channel, and
+ * mean and std hold 8 copies of each channel value.
+ */
+typedef struct _GstMeansStdKernel GstMeansStdKernel;
+struct _GstMeansStdKernel
+{
+  gint channels;
+  gsize plane;
+  guint8 shuffle[16];
+  gdouble mean[24];
+  gdouble std[24];
+};
+
+struct _GstNormalizeLut
+{
+  gint refcount;
+  gdouble mean[3];
+  gdouble std[3];
+  /* Indexed by input component: red, green and blue */
+  gfloat table[3][256];
+};
+
+/* Reads the input rows as packed pixels. YUV rows are converted to RGB
+ * in one of two scratch rows, the frame is never converted as a whole.
+ */
+typedef struct _GstRowReader GstRowReader;
+struct _GstRowReader
+{
+  GstVideoFrame *frame;
+  gboolean yuv;
+  /* Conversion factors in 14 bit fixed point */
+  gint y_offset;
+  gint y_factor;
+  gint red_v;
+  gint green_u;
+  gint green_v;
+  gint blue_u;
+  guchar *scratch[2];
+  gint rows[2];
+  gint last;
+};
+
+/* Where the normalized rows are written. Float tensors are written in
+ * place, other types through a float scratch row converted on commit.
+ * The steps are those of the rows handed out.
+ */
+typedef struct _GstRowWriter GstRowWriter;
+struct _GstRowWriter
+{
+  GstVideoFrame *frame;
+  GstInferenceTensorType type;
+  gfloat scale;
+  gint zero_point;
+  gint width;
+  gint channels;
+  gboolean planar;
+  gsize plane;
+  gint pixel_step;
+  gsize channel_step;
+  gfloat *scratch;
+};
+
+/* Tables in use, shared by means and std. Protected by the lut mutex. */
+static GMutex lut_mutex;
+static GList *luts = NULL;
+
+/* Workers the frames are split among by rows, shared by every caller.
+ * The settings are read from the environment on first use unless set
+ * before. The pool and its settings are protected by the pool mutex.
+ */
+static GMutex pool_mutex;
+static GThreadPool *pool = NULL;
+static gboolean pool_configured = FALSE;
+static guint pool_threads = GST_PREPROCESS_DEFAULT_THREADS;
+static guint pool_min_pixels = GST_PREPROCESS_DEFAULT_MIN_PIXELS;
+
+/* Processes the rows from start up to end of a frame */
+typedef void (*GstRowsFunc) (gpointer data, gint start, gint end);
+
+/* A frame split in bands, the caller waits until none is pending */
+typedef struct _GstRowsJob GstRowsJob;
+struct _GstRowsJob
+{
+  GstRowsFunc func;
+  gpointer data;
+  GMutex mutex;
+  GCond cond;
+  gint pending;
+};
+
+typedef struct _GstRowsBand GstRowsBand;
+struct _GstRowsBand
+{
+  GstRowsJob *job;
+  gint start;
+  gint end;
+};
+
+/* What the bands of a means and std call share, read only */
+typedef struct _GstMeansStdArgs GstMeansStdArgs;
+struct _GstMeansStdArgs
+{
+  GstVideoFrame *inframe;
+  GstVideoFrame *outframe;
+  gint first_index;
+  gint last_index;
+  gint offset;
+  gint channels;
+  gint model_channels;
+  /* Indexed by input component: red, green and blue */
+  gdouble mean[3];
+  gdouble std[3];
+  /* Lookup only */
+  GstNormalizeLut *lut;
+  /* Scaling only: the region scaled into and the horizontal taps */
+  gint rect_x;
+  gint rect_y;
+  gint rect_width;
+  gint rect_height;
+  gint *xoffsets;
+  gfloat *xweights;
+};
+
+/* The sums of a face normalization, added up by every band */
+typedef struct _GstSumArgs GstSumArgs;
+struct _GstSumArgs
+{
+  GstVideoFrame *inframe;
+  const guint8 *mask;
+  gint size;
+  GMutex mutex;
+  guint64 sum;
+  guint64 sumsq;
+  /* Scaling only: the taps of the region and the sums of each of its
+   * rows, added up in order so the result doesn't depend on the bands
+   */
+  GstMeansStdArgs *scaled;
+  gdouble *row_sum;
+  gdouble *row_sumsq;
+};
+
+/* Processes the pixels of a row from start on, returns where it stopped */
+typedef gint (*GstMeansStdRowFunc) (const guchar * in, gfloat * out,
+    gint start, gint width, const GstMeansStdKernel * kernel);
+
+/* Accumulates the sum and the sum of squares of the bytes of a row kept
+ * by the mask, which repeats every 16 bytes. Returns where it stopped.
+ */
+typedef gint (*GstSumRowFunc) (const guchar * in, gint start, gint size,
+    const guint8 * mask, guint64 * sum, guint64 * sumsq);
+
+/* Converts floats to half precision, returns where it stopped */
+typedef gint (*GstHalfRowFunc) (const gfloat * in, guint16 * out,
+    gint start, gint count);
+
+/* The fastest kernels the CPU supports. The means and std row kernel is
+ * NULL if there is no vector one, the scalar kernels handle the row.
+ */
+typedef struct _GstPreprocessKernels GstPreprocessKernels;
+struct _GstPreprocessKernels
+{
+  GstMeansStdRowFunc means_std_row;
+  GstSumRowFunc sum_row;
+  GstHalfRowFunc half_row;
+};
+
+static void gst_means_std_kernel_init (GstMeansStdKernel * kernel,
+    gint first_index, gint last_index, gint offset, gint channels,
+    gsize plane, const gdouble mean_red, const gdouble mean_green,
+    const gdouble mean_blue, const gdouble std_r, const gdouble std_g,
+    const gdouble std_b);
+static const GstPreprocessKernels *gst_preprocess_kernels_get (void);
+static gint gst_means_std_row_c (const guchar * in, gfloat * out,
+    gint start, gint width, const GstMeansStdKernel * kernel);
+static GstMeansStdRowFunc gst_means_std_row_c_get (gint first_index,
+    gint offset, gint channels);
+static gint gst_sum_row_c (const guchar * in, gint start, gint size,
+    const guint8 * mask, guint64 * sum, guint64 * sumsq);
+static gint gst_half_row_c (const gfloat * in, guint16 * out, gint start,
+    gint count);
+#ifdef HAVE_X86_SIMD
+static gint gst_means_std_row_sse41 (const guchar * in, gfloat * out,
+    gint start, gint width, const GstMeansStdKernel * kernel);
+static gint gst_means_std_row_avx2 (const guchar * in, gfloat * out,
+    gint start, gint width, const GstMeansStdKernel * kernel);
+static gint gst_sum_row_sse2 (const guchar * in, gint start, gint size,
+    const guint8 * mask, guint64 * sum, guint64 * sumsq);
+static gint gst_sum_row_avx2 (const guchar * in, gint start, gint size,
+    const guint8 * mask, guint64 * sum, guint64 * sumsq);
+static gint gst_half_row_f16c (const gfloat * in, guint16 * out,
+    gint start, gint count);
+#endif
+#ifdef HAVE_NEON
+static gint gst_means_std_row_neon (const guchar * in, gfloat * out,
+    gint start, gint width, const GstMeansStdKernel * kernel);
+static gint gst_sum_row_neon (const guchar * in, gint start, gint size,
+    const guint8 * mask, guint64 * sum, guint64 * sumsq);
+static gint gst_half_row_neon (const gfloat * in, guint16 * out,
+    gint start, gint count);
+#endif
+
+static gboolean gst_check_tensor_meta (GstVideoFrame * outframe);
 static gboolean gst_check_format_RGB (GstVideoFrame * inframe,
     gint * first_index, gint * last_index, gint * offset, gint * channels);
-static void gst_apply_means_std (GstVideoFrame * inframe,
+static void gst_row_writer_init (GstRowWriter * writer,
+    GstVideoFrame * frame, gint model_channels);
+static gfloat *gst_row_writer_get (GstRowWriter * writer, gint row);
+static void gst_row_writer_commit (GstRowWriter * writer, gint row);
+static void gst_row_writer_clear (GstRowWriter * writer);
+static void gst_convert_floats (GstRowWriter * writer, const gfloat * in,
+    gsize index, gint count);
+static guint16 gst_float_to_half (gfloat value);
+static void gst_row_reader_init (GstRowReader * reader,
+    GstVideoFrame * frame);
+static const guchar *gst_row_reader_get (GstRowReader * reader, gint row);
+static void gst_row_reader_clear (GstRowReader * reader);
+static void gst_yuv_row_to_rgb (GstRowReader * reader, gint row,
+    guchar * out);
+static void gst_preprocess_run_rows (GstRowsFunc func, gpointer data,
+    gint rows, gsize pixels);
+static void gst_rows_band_run (gpointer data, gpointer user_data);
+static guint gst_preprocess_env_uint (const gchar * name, guint fallback);
+static gboolean gst_apply_means_std (GstVideoFrame * inframe,
     GstVideoFrame * outframe, gint first_index, gint last_index,
     gint offset, gint channels, const gdouble mean_red,
     const gdouble mean_green, const gdouble mean_blue,
     const gdouble std_r, const gdouble std_g, const gdouble std_b,
     const gint model_channels);
+static void gst_apply_means_std_rows (gpointer data, gint start, gint end);
+static gboolean gst_is_scaled (GstVideoFrame * inframe,
+    GstVideoFrame * outframe);
+static gboolean gst_scaled_taps_init (GstMeansStdArgs * args);
+static void gst_scaled_taps_clear (GstMeansStdArgs * args);
+static void gst_scaled_rows_get (GstMeansStdArgs * args,
+    GstRowReader * reader, gint row, const guchar ** row0,
+    const guchar ** row1, gfloat * fy);
+static void gst_scaled_pixel_get (GstMeansStdArgs * args,
+    const guchar * row0, const guchar * row1, gfloat fy, gint k,
+    gfloat * value);
+static gboolean gst_apply_means_std_scaled (GstMeansStdArgs * args);
+static void gst_apply_means_std_scaled_rows (gpointer data, gint start,
+    gint end);
+static void gst_sum_rows (gpointer data, gint start, gint end);
+static void gst_sum_scaled_rows (gpointer data, gint start, gint end);
+static gboolean gst_sum_scaled (GstVideoFrame * inframe,
+    GstVideoFrame * outframe, gint offset, gint channels, gdouble * mean,
+    gdouble * variance, gdouble * count);
+static void gst_normalize_with_lut_rows (gpointer data, gint start,
+    gint end);
+
+static gboolean
+gst_apply_means_std (GstVideoFrame * inframe, GstVideoFrame * outframe,
+    gint first_index, gint last_index, gint offset, gint channels,
+    const gdouble mean_red, const gdouble mean_green,
+    const gdouble mean_blue, const gdouble std_r, const gdouble std_g,
+    const gdouble std_b, const gint model_channels)
+{
+  GstMeansStdArgs args;
+  gint width, height;
+
+  g_return_val_if_fail (inframe != NULL, FALSE);
+  g_return_val_if_fail (outframe != NULL, FALSE);
+
+  if (!gst_check_tensor_meta (outframe)) {
+    return FALSE;
+  }
+
+  args.inframe = inframe;
+  args.outframe = outframe;
+  args.first_index = first_index;
+  args.last_index = last_index;
+  args.offset = offset;
+  args.channels = channels;
+  args.model_channels = model_channels;
+  args.mean[0] = mean_red;
+  args.mean[1] = mean_green;
+  args.mean[2] = mean_blue;
+  args.std[0] = std_r;
+  args.std[1] = std_g;
+  args.std[2] = std_b;
+  args.lut = NULL;
+
+  width = GST_VIDEO_FRAME_WIDTH (inframe);
+  height = GST_VIDEO_FRAME_HEIGHT (inframe);
+
+  /* The model size differs from the input, scale while normalizing */
+  if (gst_is_scaled (inframe, outframe)) {
+    return gst_apply_means_std_scaled (&args);
+  }
+
+  gst_preprocess_run_rows (gst_apply_means_std_rows, &args, height,
+      (gsize) width * height);
+
+  return TRUE;
+}
+
+static void
+gst_apply_means_std_rows (gpointer data, gint start, gint end)
+{
+  GstMeansStdArgs *args = (GstMeansStdArgs *) data;
+  GstMeansStdKernel kernel;
+  GstMeansStdRowFunc row_func, tail_func;
+  GstRowReader reader;
+  GstRowWriter writer;
+  gint i, j, width, channels, offset;
+  gsize step;
+  const guchar *in;
+  gfloat *out, *pixel;
+
+  width = GST_VIDEO_FRAME_WIDTH (args->inframe);
+  channels = args->channels;
+  offset = args->offset;
+
+  gst_row_reader_init (&reader, args->inframe);
+  gst_row_writer_init (&writer, args->outframe, args->model_channels);
+
+  /* Vector kernels need every output channel written exactly once */
+  if (3 == args->model_channels && args->first_index != args->last_index
+      && (3 == channels || 4 == channels)) {
+    gst_means_std_kernel_init (&kernel, args->first_index, args->last_index,
+        offset, channels, writer.planar ? writer.channel_step : 0,
+        args->mean[0], args->mean[1], args->mean[2], args->std[0],
+        args->std[1], args->std[2]);
+    row_func = gst_preprocess_kernels_get ()->means_std_row;
+    tail_func = gst_means_std_row_c_get (args->first_index, offset, channels);
+
+    for (i = start; i < end; ++i) {
+      in = gst_row_reader_get (&reader, i);
+      out = gst_row_writer_get (&writer, i);
+
+      j = row_func ? row_func (in, out, 0, width, &kernel) : 0;
+      tail_func (in, out, j, width, &kernel);
+      gst_row_writer_commit (&writer, i);
+    }
+    gst_row_reader_clear (&reader);
+    gst_row_writer_clear (&writer);
+    return;
+  }
+
+  step = writer.channel_step;
+  for (i = start; i < end; ++i) {
+    in = gst_row_reader_get (&reader, i);
+    out = gst_row_writer_get (&writer, i);
+    for (j = 0; j < width; ++j) {
+      pixel = out + j * writer.pixel_step;
+      pixel[args->first_index * step] =
+          (in[j * channels + 0 + offset] - args->mean[0]) * args->std[0];
+      pixel[step] =
+          (in[j * channels + 1 + offset] - args->mean[1]) * args->std[1];
+      pixel[args->last_index * step] =
+          (in[j * channels + 2 + offset] - args->mean[2]) * args->std[2];
+    }
+    gst_row_writer_commit (&writer, i);
+  }
+  gst_row_reader_clear (&reader);
+  gst_row_writer_clear (&writer);
+}
+
+static void
+gst_row_writer_init (GstRowWriter * writer, GstVideoFrame * frame,
+    gint model_channels)
+{
+  GstInferenceTensorMeta *meta = NULL;
+
+  if (frame->buffer) {
+    meta = (GstInferenceTensorMeta *) gst_buffer_get_meta (frame->buffer,
+        GST_INFERENCE_TENSOR_META_API_TYPE);
+  }
+
+  writer->frame = frame;
+  writer->width = GST_VIDEO_FRAME_WIDTH (frame);
+  writer->channels = model_channels;
+  writer->plane = (gsize) writer->width * GST_VIDEO_FRAME_HEIGHT (frame);
+  writer->planar = meta && GST_INFERENCE_TENSOR_LAYOUT_NCHW == meta->layout;
+  writer->type = meta ? meta->type : GST_INFERENCE_TENSOR_TYPE_FLOAT32;
+  writer->scale = meta ? meta->scale : 1;
+  writer->zero_point = meta ? meta->zero_point : 0;
+  writer->scratch = NULL;
+
+  /* Interleaved rows keep the channels of a pixel together, planar ones
+   * every channel apart, a plane of the tensor or a row of the scratch.
+   */
+  writer->pixel_step = writer->planar ? 1 : model_channels;
+  if (GST_INFERENCE_TENSOR_TYPE_FLOAT32 == writer->type) {
+    writer->channel_step = writer->planar ? writer->plane : 1;
+  } else {
+    writer->channel_step = writer->planar ? (gsize) writer->width : 1;
+    writer->scratch = g_new (gfloat, writer->width * model_channels);
+  }
+}
+
+static gfloat *
+gst_row_writer_get (GstRowWriter * writer, gint row)
+{
+  if (writer->scratch) {
+    return writer->scratch;
+  }
+
+  return (gfloat *) writer->frame->data[0] +
+      (gsize) row * writer->width * writer->pixel_step;
+}
+
+static void
+gst_row_writer_commit (GstRowWriter * writer, gint row)
+{
+  gsize index;
+  gint c;
+
+  if (NULL == writer->scratch) {
+    return;
+  }
+
+  if (!writer->planar) {
+    index = (gsize) row * writer->width * writer->channels;
+    gst_convert_floats (writer, writer->scratch, index,
+        writer->width * writer->channels);
+    return;
+  }
+
+  for (c = 0; c < writer->channels; ++c) {
+    index = c * writer->plane + (gsize) row * writer->width;
+    gst_convert_floats (writer, writer->scratch + c * writer->width, index,
+        writer->width);
+  }
+}
+
+static void
+gst_row_writer_clear (GstRowWriter * writer)
+{
+  g_free (writer->scratch);
+  writer->scratch = NULL;
+}
+
+/* Stores count floats from the index of the tensor on, in its type */
+static void
+gst_convert_floats (GstRowWriter * writer, const gfloat * in, gsize index,
+    gint count)
+{
+  guint16 *half;
+  gint8 *int8;
+  guint8 *uint8;
+  gint k, value;
+
+  switch (writer->type) {
+    case GST_INFERENCE_TENSOR_TYPE_FLOAT16:
+      half = (guint16 *) writer->frame->data[0] + index;
+      k = gst_preprocess_kernels_get ()->half_row (in, half, 0, count);
+      gst_half_row_c (in, half, k, count);
+      break;
+    case GST_INFERENCE_TENSOR_TYPE_INT8:
+      int8 = (gint8 *) writer->frame->data[0] + index;
+      for (k = 0; k < count; ++k) {
+        value = lrintf (in[k] / writer->scale) + writer->zero_point;
+        int8[k] = CLAMP (value, G_MININT8, G_MAXINT8);
+      }
+      break;
+    case GST_INFERENCE_TENSOR_TYPE_UINT8:
+      uint8 = (guint8 *) writer->frame->data[0] + index;
+      for (k = 0; k < count; ++k) {
+        value = lrintf (in[k] / writer->scale) + writer->zero_point;
+        uint8[k] = CLAMP (value, 0, G_MAXUINT8);
+      }
+      break;
+    default:
+      memcpy ((gfloat *) writer->frame->data[0] + index, in,
+          count * sizeof (gfloat));
+      break;
+  }
+}
+
+/* Rounds to nearest even, as the hardware conversions do */
+static guint16
+gst_float_to_half (gfloat value)
+{
+  union
+  {
+    gfloat f;
+    guint32 u;
+  } bits, magic;
+  guint32 sign, odd;
+  guint16 half;
+
+  bits.f = value;
+  magic.u = 126 << 23;
+  sign = bits.u & 0x80000000;
+  bits.u ^= sign;
+
+  if (bits.u >= (127 + 16) << 23) {
+    /* Too large for half, infinity or NaN */
+    half = bits.u > 0x7f800000 ? 0x7e00 : 0x7c00;
+  } else if (bits.u < 113 << 23) {
+    /* Subnormal, the addition aligns and rounds the mantissa */
+    bits.f += magic.f;
+    half = bits.u - magic.u;
+  } else {
+    odd = (bits.u >> 13) & 1;
+    bits.u += ((guint32) (15 - 127) << 23) + 0xfff + odd;
+    half = bits.u >> 13;
+  }
+
+  return half | (sign >> 16);
+}
+
+static void
+gst_row_reader_init (GstRowReader * reader, GstVideoFrame * frame)
+{
+  GstVideoColorimetry colorimetry;
+  gdouble kr, kb, kg, y_scale, c_scale;
+  gint width;
+
+  reader->frame = frame;
+  reader->yuv = GST_VIDEO_INFO_IS_YUV (&frame->info);
+  reader->rows[0] = reader->rows[1] = -1;
+  reader->last = 0;
+  reader->scratch[0] = reader->scratch[1] = NULL;
+
+  if (!reader->yuv) {
+    return;
+  }
+
+  /* BT.709 for HD sources, BT.601 otherwise */
+  colorimetry = GST_VIDEO_INFO_COLORIMETRY (&frame->info);
+  if (GST_VIDEO_COLOR_MATRIX_BT709 == colorimetry.matrix) {
+    kr = 0.2126;
+    kb = 0.0722;
+  } else {
+    kr = 0.299;
+    kb = 0.114;
+  }
+  kg = 1 - kr - kb;
+
+  if (GST_VIDEO_COLOR_RANGE_0_255 == colorimetry.range) {
+    reader->y_offset = 0;
+    y_scale = 1;
+    c_scale = 1;
+  } else {
+    reader->y_offset = 16;
+    y_scale = 255.0 / 219.0;
+    c_scale = 255.0 / 224.0;
+  }
+
+  reader->y_factor = lround (y_scale * (1 << 14));
+  reader->red_v = lround (2 * (1 - kr) * c_scale * (1 << 14));
+  reader->green_u = lround (2 * (1 - kb) * kb / kg * c_scale * (1 << 14));
+  reader->green_v = lround (2 * (1 - kr) * kr / kg * c_scale * (1 << 14));
+  reader->blue_u = lround (2 * (1 - kb) * c_scale * (1 << 14));
+
+  width = GST_VIDEO_FRAME_WIDTH (frame);
+  reader->scratch[0] = g_malloc (width * 3);
+  reader->scratch[1] = g_malloc (width * 3);
+}
+
+static const guchar *
+gst_row_reader_get (GstRowReader * reader, gint row)
+{
+  gint slot;
+
+  if (!reader->yuv) {
+    return (const guchar *) GST_VIDEO_FRAME_PLANE_DATA (reader->frame, 0) +
+        row * GST_VIDEO_FRAME_PLANE_STRIDE (reader->frame, 0);
+  }
+
+  /* Scaling reads every row twice, as the bottom and then the top tap */
+  for (slot = 0; slot < 2; ++slot) {
+    if (reader->rows[slot] == row) {
+      reader->last = slot;
+      return reader->scratch[slot];
+    }
+  }
+
+  slot = 1 - reader->last;
+  gst_yuv_row_to_rgb (reader, row, reader->scratch[slot]);
+  reader->rows[slot] = row;
+  reader->last = slot;
+
+  return reader->scratch[slot];
+}
+
+static void
+gst_row_reader_clear (GstRowReader * reader)
+{
+  g_free (reader->scratch[0]);
+  g_free (reader->scratch[1]);
+  reader->scratch[0] = reader->scratch[1] = NULL;
+}
+
+static void
+gst_yuv_row_to_rgb (GstRowReader * reader, gint row, guchar * out)
+{
+  GstVideoFrame *frame = reader->frame;
+  const guchar *luma, *cb, *cr;
+  gint j, width, luma_step, chroma_step, y, u, v, red, green, blue;
+  const gint half = 1 << 13;
+
+  width = GST_VIDEO_FRAME_WIDTH (frame);
+  luma = (const guchar *) GST_VIDEO_FRAME_PLANE_DATA (frame, 0) +
+      row * GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+
+  /* Chroma is shared by 2 pixels, and by 2 rows in the planar formats */
+  switch (GST_VIDEO_FRAME_FORMAT (frame)) {
+    case GST_VIDEO_FORMAT_NV12:
+      cb = (const guchar *) GST_VIDEO_FRAME_PLANE_DATA (frame, 1) +
+          row / 2 * GST_VIDEO_FRAME_PLANE_STRIDE (frame, 1);
+      cr = cb + 1;
+      luma_step = 1;
+      chroma_step = 2;
+      break;
+    case GST_VIDEO_FORMAT_I420:
+      cb = (const guchar *) GST_VIDEO_FRAME_PLANE_DATA (frame, 1) +
+          row / 2 * GST_VIDEO_FRAME_PLANE_STRIDE (frame, 1);
+      cr = (const guchar *) GST_VIDEO_FRAME_PLANE_DATA (frame, 2) +
+          row / 2 * GST_VIDEO_FRAME_PLANE_STRIDE (frame, 2);
+      luma_step = 1;
+      chroma_step = 1;
+      break;
+    case GST_VIDEO_FORMAT_YUY2:
+      cb = luma + 1;
+      cr = luma + 3;
+      luma_step = 2;
+      chroma_step = 4;
+      break;
+    default:
+      g_return_if_reached ();
+  }
+
+  for (j = 0; j < width; ++j) {
+    y = (luma[j * luma_step] - reader->y_offset) * reader->y_factor;
+    u = cb[j / 2 * chroma_step] - 128;
+    v = cr[j / 2 * chroma_step] - 128;
+
+    red = (y + reader->red_v * v + half) >> 14;
+    green = (y - reader->green_u * u - reader->green_v * v + half) >> 14;
+    blue = (y + reader->blue_u * u + half) >> 14;
+
+    out[j * 3] = CLAMP (red, 0, 255);
+    out[j * 3 + 1] = CLAMP (green, 0, 255);
+    out[j * 3 + 2] = CLAMP (blue, 0, 255);
+  }
+}
+
+static void
+gst_means_std_kernel_init (GstMeansStdKernel * kernel, gint first_index,
+    gint last_index, gint offset, gint channels, gsize plane,
+    const gdouble mean_red, const gdouble mean_green,
+    const gdouble mean_blue, const gdouble std_r, const gdouble std_g,
+    const gdouble std_b)
+{
+  gint source[3];
+  gdouble mean[3];
+  gdouble std[3];
+  gint i, p, c;
+
+  /* Output channel to input component */
+  source[first_index] = 0;
+  source[1] = 1;
+  source[last_index] = 2;
+  mean[first_index] = mean_red;
+  mean[1] = mean_green;
+  mean[last_index] = mean_blue;
+  std[first_index] = std_r;
+  std[1] = std_g;
+  std[last_index] = std_b;
+
+  kernel->channels = channels;
+  kernel->plane = plane;
+
+  /* The last 4 bytes are zeroed, the high bit clears the lane */
+  memset (kernel->shuffle, 0x80, sizeof (kernel->shuffle));
+  for (p = 0; p < 4; ++p) {
+    for (c = 0; c < 3; ++c) {
+      if (plane) {
+        kernel->shuffle[c * 4 + p] = p * channels + offset + source[c];
+      } else {
+        kernel->shuffle[p * 3 + c] = p * channels + offset + source[c];
+      }
+    }
+  }
+
+  for (i = 0; i < 24; ++i) {
+    kernel->mean[i] = plane ? mean[i / 8] : mean[i % 3];
+    kernel->std[i] = plane ? std[i / 8] : std[i % 3];
+  }
+}
+
+static gint
+gst_means_std_row_c (const guchar * in, gfloat * out, gint start,
+    gint width, const GstMeansStdKernel * kernel)
+{
+  gint j, c;
+
+  if (kernel->plane) {
+    for (c = 0; c < 3; ++c) {
+      for (j = start; j < width; ++j) {
+        out[c * kernel->plane + j] =
+            (in[j * kernel->channels + kernel->shuffle[c * 4]] -
+            kernel->mean[c * 8]) * kernel->std[c * 8];
+      }
+    }
+    return width;
+  }
+
+  for (j = start; j < width; ++j) {
+    for (c = 0; c < 3; ++c) {
+      out[j * 3 + c] =
+          (in[j * kernel->channels + kernel->shuffle[c]] -
+          kernel->mean[c]) * kernel->std[c];
+    }
+  }
+
+  return width;
+}
+
+/* Scalar kernels with the pixel layout of a format fixed at compile time,
+ * so the compiler can unroll the channels and vectorize the row. Red and
+ * blue are the output channels of the red and blue components.
+ */
+#define GST_DEFINE_MEANS_STD_ROW(name, channels, offset, red, blue)     \
+static gint                                                             \
+gst_means_std_row_##name (const guchar * in, gfloat * out, gint start,  \
+    gint width, const GstMeansStdKernel * kernel)                       \
+{                                                                       \
+  const gsize plane = kernel->plane;                                    \
+  const gint step = plane ? 8 : 1;                                      \
+  const gdouble mean_red = kernel->mean[red * step];                    \
+  const gdouble mean_green = kernel->mean[step];                        \
+  const gdouble mean_blue = kernel->mean[blue * step];                  \
+  const gdouble std_red = kernel->std[red * step];                      \
+  const gdouble std_green = kernel->std[step];                          \
+  const gdouble std_blue = kernel->std[blue * step];                    \
+  const guchar *pixel;                                                  \
+  gint j;                                                               \
+                                                                        \
+  if (plane) {                                                          \
+    for (j = start; j < width; ++j) {                                   \
+      pixel = in + j * channels + offset;                               \
+      out[red * plane + j] = (pixel[0] - mean_red) * std_red;           \
+      out[plane + j] = (pixel[1] - mean_green) * std_green;             \
+      out[blue * plane + j] = (pixel[2] - mean_blue) * std_blue;        \
+    }                                                                   \
+    return width;                                                       \
+  }                                                                     \
+                                                                        \
+  for (j = start; j < width; ++j) {                                     \
+    pixel = in + j * channels + offset;                                 \
+    out[j * 3 + red] = (pixel[0] - mean_red) * std_red;                 \
+    out[j * 3 + 1] = (pixel[1] - mean_green) * std_green;               \
+    out[j * 3 + blue] = (pixel[2] - mean_blue) * std_blue;              \
+  }                                                                     \
+                                                                        \
+  return width;                                                         \
+}
+
+GST_DEFINE_MEANS_STD_ROW (rgb, 3, 0, 0, 2)
+GST_DEFINE_MEANS_STD_ROW (bgr, 3, 0, 2, 0)
+GST_DEFINE_MEANS_STD_ROW (rgbx, 4, 0, 0, 2)
+GST_DEFINE_MEANS_STD_ROW (bgrx, 4, 0, 2, 0)
+GST_DEFINE_MEANS_STD_ROW (xrgb, 4, 1, 0, 2)
+GST_DEFINE_MEANS_STD_ROW (xbgr, 4, 1, 2, 0)
+
+/* The layouts gst_check_format_RGB reports, the YUV formats are read as
+ * packed RGB rows.
+ */
+static GstMeansStdRowFunc
+gst_means_std_row_c_get (gint first_index, gint offset, gint channels)
+{
+  gboolean bgr = 2 == first_index;
+
+  if (3 == channels && 0 == offset) {
+    return bgr ? gst_means_std_row_bgr : gst_means_std_row_rgb;
+  }
+  if (4 == channels && 0 == offset) {
+    return bgr ? gst_means_std_row_bgrx : gst_means_std_row_rgbx;
+  }
+  if (4 == channels && 1 == offset) {
+    return bgr ? gst_means_std_row_xbgr : gst_means_std_row_xrgb;
+  }
+
+  return gst_means_std_row_c;
+}
+
+static gint
+gst_sum_row_c (const guchar * in, gint start, gint size, const guint8 * mask,
+    guint64 * sum, guint64 * sumsq)
+{
+  gint k;
+
+  for (k = start; k < size; ++k) {
+    if (mask[k & 15]) {
+      *sum += in[k];
+      *sumsq += in[k] * in[k];
+    }
+  }
+
+  return size;
+}
+
+static gint
+gst_half_row_c (const gfloat * in, guint16 * out, gint start, gint count)
+{
+  gint k;
+
+  for (k = start; k < count; ++k) {
+    out[k] = gst_float_to_half (in[k]);
+  }
+
+  return count;
+}
+
+/* Squares are accumulated in 32 bit lanes, each iteration adds at most
+ * 4 * 255^2 to a lane, so they are flushed before they may overflow.
+ */
+#define SUM_FLUSH_ITERATIONS 8192
+
+#ifdef HAVE_X86_SIMD
+__attribute__ ((target ("sse4.1")))
+static inline void
+gst_means_std_store_sse41 (__m128i values, gfloat * out, const gdouble * mean,
+    const gdouble * std)
+{
+  __m128i ints = _mm_cvtepu8_epi32 (values);
+  __m128d lo = _mm_cvtepi32_pd (ints);
+  __m128d hi = _mm_cvtepi32_pd (_mm_srli_si128 (ints, 8));
+
+  lo = _mm_mul_pd (_mm_sub_pd (lo, _mm_loadu_pd (mean)), _mm_loadu_pd (std));
+  hi = _mm_mul_pd (_mm_sub_pd (hi, _mm_loadu_pd (mean + 2)),
+      _mm_loadu_pd (std + 2));
+
+  _mm_storeu_ps (out, _mm_movelh_ps (_mm_cvtpd_ps (lo), _mm_cvtpd_ps (hi)));
+}
+
+__attribute__ ((target ("sse4.1")))
+static gint
+gst_means_std_row_sse41 (const guchar * in, gfloat * out, gint start,
+    gint width, const GstMeansStdKernel * kernel)
+{
+  const __m128i shuffle =
+      _mm_loadu_si128 ((const __m128i *) kernel->shuffle);
+  const gint channels = kernel->channels;
+  __m128i pixels;
+  gint j;
+
+  /* 4 pixels per iteration, the 16 bytes load must not leave the row */
+  if (kernel->plane) {
+    gfloat *green = out + kernel->plane;
+    gfloat *blue = out + 2 * kernel->plane;
+
+    for (j = start; j * channels + 16 <= width * channels; j += 4) {
+      pixels = _mm_loadu_si128 ((const __m128i *) (in + j * channels));
+      pixels = _mm_shuffle_epi8 (pixels, shuffle);
+
+      gst_means_std_store_sse41 (pixels, out + j, kernel->mean, kernel->std);
+      gst_means_std_store_sse41 (_mm_srli_si128 (pixels, 4), green + j,
+          kernel->mean + 8, kernel->std + 8);
+      gst_means_std_store_sse41 (_mm_srli_si128 (pixels, 8), blue + j,
+          kernel->mean + 16, kernel->std + 16);
+    }
+    return j;
+  }
+
+  for (j = start; j * channels + 16 <= width * channels; j += 4) {
+    pixels = _mm_loadu_si128 ((const __m128i *) (in + j * channels));
+    pixels = _mm_shuffle_epi8 (pixels, shuffle);
+
+    gst_means_std_store_sse41 (pixels, out + j * 3, kernel->mean,
+        kernel->std);
+    gst_means_std_store_sse41 (_mm_srli_si128 (pixels, 4), out + j * 3 + 4,
+        kernel->mean + 4, kernel->std + 4);
+    gst_means_std_store_sse41 (_mm_srli_si128 (pixels, 8), out + j * 3 + 8,
+        kernel->mean + 8, kernel->std + 8);
+  }
+
+  return j;
+}
+
+__attribute__ ((target ("avx2")))
+static inline void
+gst_means_std_store_avx2 (__m128i values, gfloat * out, const gdouble * mean,
+    const gdouble * std)
+{
+  __m256i ints = _mm256_cvtepu8_epi32 (values);
+  __m256d lo = _mm256_cvtepi32_pd (_mm256_castsi256_si128 (ints));
+  __m256d hi = _mm256_cvtepi32_pd (_mm256_extracti128_si256 (ints, 1));
+
+  lo = _mm256_mul_pd (_mm256_sub_pd (lo, _mm256_loadu_pd (mean)),
+      _mm256_loadu_pd (std));
+  hi = _mm256_mul_pd (_mm256_sub_pd (hi, _mm256_loadu_pd (mean + 4)),
+      _mm256_loadu_pd (std + 4));
+
+  _mm256_storeu_ps (out,
+      _mm256_insertf128_ps (_mm256_castps128_ps256 (_mm256_cvtpd_ps (lo)),
+          _mm256_cvtpd_ps (hi), 1));
+}
+
+__attribute__ ((target ("avx2")))
+static gint
+gst_means_std_row_avx2 (const guchar * in, gfloat * out, gint start,
+    gint width, const GstMeansStdKernel * kernel)
+{
+  const __m128i shuffle =
+      _mm_loadu_si128 ((const __m128i *) kernel->shuffle);
+  const gint channels = kernel->channels;
+  __m128i first, second;
+  gint j;
+
+  /* Planar halves hold 4 values per channel, pair them up in 8 */
+  if (kernel->plane) {
+    gfloat *green = out + kernel->plane;
+    gfloat *blue = out + 2 * kernel->plane;
+
+    for (j = start; (j + 4) * channels + 16 <= width * channels; j += 8) {
+      first = _mm_loadu_si128 ((const __m128i *) (in + j * channels));
+      second = _mm_loadu_si128 ((const __m128i *) (in + (j + 4) * channels));
+      first = _mm_shuffle_epi8 (first, shuffle);
+      second = _mm_shuffle_epi8 (second, shuffle);
+
+      gst_means_std_store_avx2 (_mm_unpacklo_epi32 (first, second), out + j,
+          kernel->mean, kernel->std);
+      gst_means_std_store_avx2 (_mm_unpacklo_epi32 (_mm_srli_si128 (first,
+                  4), _mm_srli_si128 (second, 4)), green + j,
+          kernel->mean + 8, kernel->std + 8);
+      gst_means_std_store_avx2 (_mm_unpacklo_epi32 (_mm_srli_si128 (first,
+                  8), _mm_srli_si128 (second, 8)), blue + j,
+          kernel->mean + 16, kernel->std + 16);
+    }
+    return gst_means_std_row_sse41 (in, out, j, width, kernel);
+  }
+
+  /* 8 pixels per iteration as two shuffled halves of 12 components */
+  for (j = start; (j + 4) * channels + 16 <= width * channels; j += 8) {
+    first = _mm_loadu_si128 ((const __m128i *) (in + j * channels));
+    second = _mm_loadu_si128 ((const __m128i *) (in + (j + 4) * channels));
+    first = _mm_shuffle_epi8 (first, shuffle);
+    second = _mm_shuffle_epi8 (second, shuffle);
+
+    gst_means_std_store_avx2 (first, out + j * 3, kernel->mean, kernel->std);
+    gst_means_std_store_avx2 (_mm_unpacklo_epi32 (_mm_srli_si128 (first, 8),
+            second), out + j * 3 + 8, kernel->mean + 8, kernel->std + 8);
+    gst_means_std_store_avx2 (_mm_srli_si128 (second, 4), out + j * 3 + 16,
+        kernel->mean + 16, kernel->std + 16);
+  }
+
+  return gst_means_std_row_sse41 (in, out, j, width, kernel);
+}
+
+__attribute__ ((target ("sse2")))
+static gint
+gst_sum_row_sse2 (const guchar * in, gint start, gint size,
+    const guint8 * mask, guint64 * sum, guint64 * sumsq)
+{
+  const __m128i keep = _mm_loadu_si128 ((const __m128i *) mask);
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i sums = zero;
+  __m128i squares = zero;
+  __m128i bytes, low, high;
+  guint64 lanes[2];
+  guint32 square_lanes[4];
+  gint k, n = 0;
+
+  for (k = start; k + 16 <= size; k += 16) {
+    bytes = _mm_and_si128 (_mm_loadu_si128 ((const __m128i *) (in + k)), keep);
+    sums = _mm_add_epi64 (sums, _mm_sad_epu8 (bytes, zero));
+
+    low = _mm_unpacklo_epi8 (bytes, zero);
+    high = _mm_unpackhi_epi8 (bytes, zero);
+    squares = _mm_add_epi32 (squares, _mm_madd_epi16 (low, low));
+    squares = _mm_add_epi32 (squares, _mm_madd_epi16 (high, high));
+
+    if (++n == SUM_FLUSH_ITERATIONS || k + 32 > size) {
+      _mm_storeu_si128 ((__m128i *) square_lanes, squares);
+      *sumsq += (guint64) square_lanes[0] + square_lanes[1] +
+          square_lanes[2] + square_lanes[3];
+      squares = zero;
+      n = 0;
+    }
+  }
+
+  _mm_storeu_si128 ((__m128i *) lanes, sums);
+  *sum += lanes[0] + lanes[1];
+
+  return k;
+}
+
+__attribute__ ((target ("avx2")))
+static gint
+gst_sum_row_avx2 (const guchar * in, gint start, gint size,
+    const guint8 * mask, guint64 * sum, guint64 * sumsq)
+{
+  const __m256i keep =
+      _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *) mask));
+  const __m256i zero = _mm256_setzero_si256 ();
+  __m256i sums = zero;
+  __m256i squares = zero;
+  __m256i bytes, low, high;
+  guint64 lanes[4];
+  guint32 square_lanes[8];
+  gint k, i, n = 0;
+
+  for (k = start; k + 32 <= size; k += 32) {
+    bytes = _mm256_and_si256 (_mm256_loadu_si256 ((const __m256i *) (in + k)),
+        keep);
+    sums = _mm256_add_epi64 (sums, _mm256_sad_epu8 (bytes, zero));
+
+    low = _mm256_unpacklo_epi8 (bytes, zero);
+    high = _mm256_unpackhi_epi8 (bytes, zero);
+    squares = _mm256_add_epi32 (squares, _mm256_madd_epi16 (low, low));
+    squares = _mm256_add_epi32 (squares, _mm256_madd_epi16 (high, high));
+
+    if (++n == SUM_FLUSH_ITERATIONS || k + 64 > size) {
+      _mm256_storeu_si256 ((__m256i *) square_lanes, squares);
+      for (i = 0; i < 8; ++i) {
+        *sumsq += square_lanes[i];
+      }
+      squares = zero;
+      n = 0;
+    }
+  }
+
+  _mm256_storeu_si256 ((__m256i *) lanes, sums);
+  *sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+  return gst_sum_row_sse2 (in, k, size, mask, sum, sumsq);
+}
+
+__attribute__ ((target ("avx,f16c")))
+static gint
+gst_half_row_f16c (const gfloat * in, guint16 * out, gint start, gint count)
+{
+  gint k;
+
+  for (k = start; k + 8 <= count; k += 8) {
+    _mm_storeu_si128 ((__m128i *) (out + k),
+        _mm256_cvtps_ph (_mm256_loadu_ps (in + k), _MM_FROUND_TO_NEAREST_INT));
+  }
+
+  return k;
+}
+#endif
+
+#ifdef HAVE_NEON
+static inline void
+gst_means_std_store_neon (uint32x4_t values, gfloat * out,
+    const gdouble * mean, const gdouble * std)
+{
+  float64x2_t lo = vcvtq_f64_u64 (vmovl_u32 (vget_low_u32 (values)));
+  float64x2_t hi = vcvtq_f64_u64 (vmovl_u32 (vget_high_u32 (values)));
+
+  lo = vmulq_f64 (vsubq_f64 (lo, vld1q_f64 (mean)), vld1q_f64 (std));
+  hi = vmulq_f64 (vsubq_f64 (hi, vld1q_f64 (mean + 2)), vld1q_f64 (std + 2));
+
+  vst1q_f32 (out, vcombine_f32 (vcvt_f32_f64 (lo), vcvt_f32_f64 (hi)));
+}
+
+static gint
+gst_means_std_row_neon (const guchar * in, gfloat * out, gint start,
+    gint width, const GstMeansStdKernel * kernel)
+{
+  const uint8x16_t shuffle = vld1q_u8 (kernel->shuffle);
+  const gint channels = kernel->channels;
+  uint8x16_t pixels;
+  uint16x8_t low, high;
+  gint j;
+
+  if (kernel->plane) {
+    gfloat *green = out + kernel->plane;
+    gfloat *blue = out + 2 * kernel->plane;
+
+    for (j = start; j * channels + 16 <= width * channels; j += 4) {
+      pixels = vqtbl1q_u8 (vld1q_u8 (in + j * channels), shuffle);
+      low = vmovl_u8 (vget_low_u8 (pixels));
+      high = vmovl_u8 (vget_high_u8 (pixels));
+
+      gst_means_std_store_neon (vmovl_u16 (vget_low_u16 (low)), out + j,
+          kernel->mean, kernel->std);
+      gst_means_std_store_neon (vmovl_u16 (vget_high_u16 (low)), green + j,
+          kernel->mean + 8, kernel->std + 8);
+      gst_means_std_store_neon (vmovl_u16 (vget_low_u16 (high)), blue + j,
+          kernel->mean + 16, kernel->std + 16);
+    }
+    return j;
+  }
+
+  for (j = start; j * channels + 16 <= width * channels; j += 4) {
+    pixels = vqtbl1q_u8 (vld1q_u8 (in + j * channels), shuffle);
+    low = vmovl_u8 (vget_low_u8 (pixels));
+    high = vmovl_u8 (vget_high_u8 (pixels));
+
+    gst_means_std_store_neon (vmovl_u16 (vget_low_u16 (low)), out + j * 3,
+        kernel->mean, kernel->std);
+    gst_means_std_store_neon (vmovl_u16 (vget_high_u16 (low)),
+        out + j * 3 + 4, kernel->mean + 4, kernel->std + 4);
+    gst_means_std_store_neon (vmovl_u16 (vget_low_u16 (high)),
+        out + j * 3 + 8, kernel->mean + 8, kernel->std + 8);
+  }
+
+  return j;
+}
+
+static gint
+gst_sum_row_neon (const guchar * in, gint start, gint size,
+    const guint8 * mask, guint64 * sum, guint64 * sumsq)
+{
+  const uint8x16_t keep = vld1q_u8 (mask);
+  uint32x4_t sums = vdupq_n_u32 (0);
+  uint32x4_t squares = vdupq_n_u32 (0);
+  uint8x16_t bytes;
+  gint k, n = 0;
+
+  for (k = start; k + 16 <= size; k += 16) {
+    bytes = vandq_u8 (vld1q_u8 (in + k), keep);
+    sums = vpadalq_u16 (sums, vpaddlq_u8 (bytes));
+    squares = vpadalq_u16 (squares, vmull_u8 (vget_low_u8 (bytes),
+            vget_low_u8 (bytes)));
+    squares = vpadalq_u16 (squares, vmull_u8 (vget_high_u8 (bytes),
+            vget_high_u8 (bytes)));
+
+    if (++n == SUM_FLUSH_ITERATIONS || k + 32 > size) {
+      *sumsq += vaddlvq_u32 (squares);
+      *sum += vaddlvq_u32 (sums);
+      squares = vdupq_n_u32 (0);
+      sums = vdupq_n_u32 (0);
+      n = 0;
+    }
+  }
+
+  return k;
+}
+
+static gint
+gst_half_row_neon (const gfloat * in, guint16 * out, gint start, gint count)
+{
+  gint k;
+
+  for (k = start; k + 4 <= count; k += 4) {
+    vst1_u16 (out + k, vreinterpret_u16_f16 (vcvt_f16_f32 (vld1q_f32 (in +
+                    k))));
+  }
+
+  return k;
+}
+#endif
+
+static const GstPreprocessKernels *
+gst_preprocess_kernels_get (void)
+{
+  static GstPreprocessKernels kernels;
+  static gsize initialized = 0;
+
+  /* Detected once, the CPU does not change */
+  if (g_once_init_enter (&initialized)) {
+    kernels.means_std_row = NULL;
+    kernels.sum_row = gst_sum_row_c;
+    kernels.half_row = gst_half_row_c;
+
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2")) {
+      kernels.means_std_row = gst_means_std_row_avx2;
+      kernels.sum_row = gst_sum_row_avx2;
+    } else if (__builtin_cpu_supports ("sse4.1")) {
+      kernels.means_std_row = gst_means_std_row_sse41;
+      kernels.sum_row = gst_sum_row_sse2;
+    } else if (__builtin_cpu_supports ("sse2")) {
+      kernels.sum_row = gst_sum_row_sse2;
+    }
+    if (__builtin_cpu_supports ("avx") && __builtin_cpu_supports ("f16c")) {
+      kernels.half_row = gst_half_row_f16c;
+    }
+#endif
+#ifdef HAVE_NEON
+    kernels.means_std_row = gst_means_std_row_neon;
+    kernels.sum_row = gst_sum_row_neon;
+    kernels.half_row = gst_half_row_neon;
+#endif
+
+    g_once_init_leave (&initialized, 1);
+  }
+
+  return &kernels;
+}
+
+static gboolean
+gst_is_scaled (GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  return GST_VIDEO_FRAME_WIDTH (inframe) != GST_VIDEO_FRAME_WIDTH (outframe)
+      || GST_VIDEO_FRAME_HEIGHT (inframe) != GST_VIDEO_FRAME_HEIGHT (outframe)
+      || (outframe->buffer
+      && gst_buffer_get_video_crop_meta (outframe->buffer));
+}
+
+static gboolean
+gst_scaled_taps_init (GstMeansStdArgs * args)
+{
+  GstVideoCropMeta *crop = NULL;
+  GstVideoFrame *outframe = args->outframe;
+  gint j, in_width, out_width, out_height;
+  gfloat sx;
+
+  in_width = GST_VIDEO_FRAME_WIDTH (args->inframe);
+  out_width = GST_VIDEO_FRAME_WIDTH (outframe);
+  out_height = GST_VIDEO_FRAME_HEIGHT (outframe);
+
+  /* A crop meta on the output marks the region the image is scaled
+   * into (letterbox), the borders are padded as black pixels.
+   */
+  if (outframe->buffer) {
+    crop = gst_buffer_get_video_crop_meta (outframe->buffer);
+  }
+  if (crop) {
+    args->rect_x = crop->x;
+    args->rect_y = crop->y;
+    args->rect_width = crop->width;
+    args->rect_height = crop->height;
+  } else {
+    args->rect_x = 0;
+    args->rect_y = 0;
+    args->rect_width = out_width;
+    args->rect_height = out_height;
+  }
+
+  g_return_val_if_fail (args->rect_width > 0 && args->rect_height > 0, FALSE);
+  g_return_val_if_fail (args->rect_x + args->rect_width <= out_width, FALSE);
+  g_return_val_if_fail (args->rect_y + args->rect_height <= out_height,
+      FALSE);
+
+  /* Horizontal taps are the same for every row, compute them once */
+  args->xoffsets = g_new (gint, 2 * args->rect_width);
+  args->xweights = g_new (gfloat, args->rect_width);
+  for (j = 0; j < args->rect_width; ++j) {
+    gint x0, x1;
+
+    sx = (j + 0.5f) * in_width / args->rect_width - 0.5f;
+    sx = CLAMP (sx, 0, in_width - 1);
+    x0 = (gint) sx;
+    x1 = MIN (x0 + 1, in_width - 1);
+    args->xoffsets[2 * j] = x0 * args->channels + args->offset;
+    args->xoffsets[2 * j + 1] = x1 * args->channels + args->offset;
+    args->xweights[j] = sx - x0;
+  }
+
+  return TRUE;
+}
 
 static void
-gst_apply_means_std (GstVideoFrame * inframe, GstVideoFrame * outframe,
-    gint first_index, gint last_index, gint offset, gint channels,
-    const gdouble mean_red, const gdouble mean_green,
-    const gdouble mean_blue, const gdouble std_r, const gdouble std_g,
-    const gdouble std_b, const gint model_channels)
+gst_scaled_taps_clear (GstMeansStdArgs * args)
+{
+  g_free (args->xoffsets);
+  g_free (args->xweights);
+  args->xoffsets = NULL;
+  args->xweights = NULL;
+}
+
+/* The two input rows output row interpolates and its vertical weight */
+static inline void
+gst_scaled_rows_get (GstMeansStdArgs * args, GstRowReader * reader, gint row,
+    const guchar ** row0, const guchar ** row1, gfloat * fy)
 {
-  gint i, j, pixel_stride, width, height;
+  gint in_height, y0, y1;
+  gfloat sy;
 
-  g_return_if_fail (inframe != NULL);
-  g_return_if_fail (outframe != NULL);
+  in_height = GST_VIDEO_FRAME_HEIGHT (args->inframe);
 
-  pixel_stride = GST_VIDEO_FRAME_COMP_STRIDE (inframe, 0) / channels;
-  width = GST_VIDEO_FRAME_WIDTH (inframe);
-  height = GST_VIDEO_FRAME_HEIGHT (inframe);
+  sy = (row - args->rect_y + 0.5f) * in_height / args->rect_height - 0.5f;
+  sy = CLAMP (sy, 0, in_height - 1);
+  y0 = (gint) sy;
+  y1 = MIN (y0 + 1, in_height - 1);
+  *fy = sy - y0;
+  *row0 = gst_row_reader_get (reader, y0);
+  *row1 = gst_row_reader_get (reader, y1);
+}
+
+/* The red, green and blue values of pixel k of the region in a row */
+static inline void
+gst_scaled_pixel_get (GstMeansStdArgs * args, const guchar * row0,
+    const guchar * row1, gfloat fy, gint k, gfloat * value)
+{
+  const gint *xoffsets = args->xoffsets;
+  const gfloat *xweights = args->xweights;
+  gfloat top, bottom;
+  gint c;
+
+  for (c = 0; c < 3; ++c) {
+    top = row0[xoffsets[2 * k] + c] + (row0[xoffsets[2 * k + 1] + c] -
+        row0[xoffsets[2 * k] + c]) * xweights[k];
+    bottom = row1[xoffsets[2 * k] + c] + (row1[xoffsets[2 * k + 1] + c] -
+        row1[xoffsets[2 * k] + c]) * xweights[k];
+    value[c] = top + (bottom - top) * fy;
+  }
+}
+
+static gboolean
+gst_apply_means_std_scaled (GstMeansStdArgs * args)
+{
+  gint out_width, out_height;
+
+  if (!gst_scaled_taps_init (args)) {
+    return FALSE;
+  }
+
+  out_width = GST_VIDEO_FRAME_WIDTH (args->outframe);
+  out_height = GST_VIDEO_FRAME_HEIGHT (args->outframe);
+
+  gst_preprocess_run_rows (gst_apply_means_std_scaled_rows, args, out_height,
+      (gsize) out_width * out_height);
+
+  gst_scaled_taps_clear (args);
+
+  return TRUE;
+}
+
+static void
+gst_apply_means_std_scaled_rows (gpointer data, gint start, gint end)
+{
+  GstMeansStdArgs *args = (GstMeansStdArgs *) data;
+  const GstNormalizeLut *lut = args->lut;
+  GstRowReader reader;
+  GstRowWriter writer;
+  gint i, j, c, out_width;
+  gfloat *pixel;
+  const guchar *row0, *row1;
+  gfloat fy;
+  gfloat value[3], pad[3];
+  gsize index[3];
+
+  out_width = GST_VIDEO_FRAME_WIDTH (args->outframe);
+
+  gst_row_writer_init (&writer, args->outframe, args->model_channels);
+
+  index[0] = args->first_index * writer.channel_step;
+  index[1] = writer.channel_step;
+  index[2] = args->last_index * writer.channel_step;
+  for (c = 0; c < 3; ++c) {
+    pad[c] = (0 - args->mean[c]) * args->std[c];
+  }
+
+  gst_row_reader_init (&reader, args->inframe);
+
+  for (i = start; i < end; ++i) {
+    pixel = gst_row_writer_get (&writer, i);
+
+    if (i < args->rect_y || i >= args->rect_y + args->rect_height) {
+      for (j = 0; j < out_width; ++j, pixel += writer.pixel_step) {
+        pixel[index[0]] = pad[0];
+        pixel[index[1]] = pad[1];
+        pixel[index[2]] = pad[2];
+      }
+      gst_row_writer_commit (&writer, i);
+      continue;
+    }
+
+    gst_scaled_rows_get (args, &reader, i, &row0, &row1, &fy);
+
+    for (j = 0; j < out_width; ++j, pixel += writer.pixel_step) {
+      gint k = j - args->rect_x;
+
+      if (k < 0 || k >= args->rect_width) {
+        pixel[index[0]] = pad[0];
+        pixel[index[1]] = pad[1];
+        pixel[index[2]] = pad[2];
+        continue;
+      }
+
+      gst_scaled_pixel_get (args, row0, row1, fy, k, value);
+
+      /* The tables are indexed by 8 bit values, round the interpolation */
+      if (NULL != lut) {
+        for (c = 0; c < 3; ++c) {
+          pixel[index[c]] = lut->table[c][(gint) (value[c] + 0.5f)];
+        }
+        continue;
+      }
+
+      for (c = 0; c < 3; ++c) {
+        pixel[index[c]] = (value[c] - args->mean[c]) * args->std[c];
+      }
+    }
+    gst_row_writer_commit (&writer, i);
+  }
+
+  gst_row_reader_clear (&reader);
+  gst_row_writer_clear (&writer);
+}
+
+static void
+gst_preprocess_run_rows (GstRowsFunc func, gpointer data, gint rows,
+    gsize pixels)
+{
+  GstRowsJob job;
+  GstRowsBand *bands;
+  GThreadPool *workers = NULL;
+  guint threads, count, b;
+
+  g_mutex_lock (&pool_mutex);
+  if (!pool_configured) {
+    pool_threads = gst_preprocess_env_uint (GST_PREPROCESS_THREADS_ENV,
+        GST_PREPROCESS_DEFAULT_THREADS);
+    pool_min_pixels = gst_preprocess_env_uint (GST_PREPROCESS_MIN_PIXELS_ENV,
+        GST_PREPROCESS_DEFAULT_MIN_PIXELS);
+    pool_configured = TRUE;
+  }
+  threads = pool_threads ? pool_threads : g_get_num_processors ();
+  /* Every band gets at least the minimum work, small frames get one */
+  count = MIN (threads, pixels / MAX (pool_min_pixels, 1));
+  count = MIN (count, (guint) MAX (rows, 0));
+  if (count > 1) {
+    if (NULL == pool) {
+      pool = g_thread_pool_new (gst_rows_band_run, NULL, threads - 1, FALSE,
+          NULL);
+    }
+    workers = pool;
+  }
+  g_mutex_unlock (&pool_mutex);
+
+  if (NULL == workers) {
+    func (data, 0, rows);
+    return;
+  }
+
+  job.func = func;
+  job.data = data;
+  job.pending = count - 1;
+  g_mutex_init (&job.mutex);
+  g_cond_init (&job.cond);
+
+  bands = g_new (GstRowsBand, count);
+  for (b = 0; b < count; ++b) {
+    bands[b].job = &job;
+    bands[b].start = (gint64) rows * b / count;
+    bands[b].end = (gint64) rows * (b + 1) / count;
+  }
+
+  /* The calling thread takes the first band */
+  for (b = 1; b < count; ++b) {
+    g_thread_pool_push (workers, &bands[b], NULL);
+  }
+  func (data, bands[0].start, bands[0].end);
+
+  g_mutex_lock (&job.mutex);
+  while (job.pending > 0) {
+    g_cond_wait (&job.cond, &job.mutex);
+  }
+  g_mutex_unlock (&job.mutex);
+
+  g_mutex_clear (&job.mutex);
+  g_cond_clear (&job.cond);
+  g_free (bands);
+}
+
+static void
+gst_rows_band_run (gpointer data, gpointer user_data)
+{
+  GstRowsBand *band = (GstRowsBand *) data;
+  GstRowsJob *job = band->job;
+
+  job->func (job->data, band->start, band->end);
+
+  g_mutex_lock (&job->mutex);
+  job->pending--;
+  if (0 == job->pending) {
+    g_cond_signal (&job->cond);
+  }
+  g_mutex_unlock (&job->mutex);
+}
+
+static guint
+gst_preprocess_env_uint (const gchar * name, guint fallback)
+{
+  const gchar *value;
+  gchar *end = NULL;
+  guint64 parsed = 0;
+
+  g_return_val_if_fail (name, fallback);
+
+  value = g_getenv (name);
+  if (NULL == value) {
+    return fallback;
+  }
+
+  if (g_ascii_isdigit (value[0])) {
+    parsed = g_ascii_strtoull (value, &end, 10);
+  }
+  if (NULL == end || '\0' != *end || parsed > G_MAXUINT) {
+    g_warning ("Ignoring invalid %s value: %s", name, value);
+    return fallback;
+  }
+
+  return parsed;
+}
+
+static void
+gst_sum_rows (gpointer data, gint start, gint end)
+{
+  GstSumArgs *args = (GstSumArgs *) data;
+  const GstPreprocessKernels *kernels = gst_preprocess_kernels_get ();
+  GstRowReader reader;
+  guint64 sum = 0, sumsq = 0;
+  const guchar *in;
+  gint i, k;
+
+  gst_row_reader_init (&reader, args->inframe);
+  for (i = start; i < end; ++i) {
+    in = gst_row_reader_get (&reader, i);
+    k = kernels->sum_row (in, 0, args->size, args->mask, &sum, &sumsq);
+    gst_sum_row_c (in, k, args->size, args->mask, &sum, &sumsq);
+  }
+  gst_row_reader_clear (&reader);
+
+  g_mutex_lock (&args->mutex);
+  args->sum += sum;
+  args->sumsq += sumsq;
+  g_mutex_unlock (&args->mutex);
+}
+
+static void
+gst_sum_scaled_rows (gpointer data, gint start, gint end)
+{
+  GstSumArgs *args = (GstSumArgs *) data;
+  GstMeansStdArgs *scaled = args->scaled;
+  GstRowReader reader;
+  const guchar *row0, *row1;
+  gdouble sum, sumsq;
+  gfloat fy, value[3];
+  gint i, k, c;
+
+  gst_row_reader_init (&reader, scaled->inframe);
+  for (i = start; i < end; ++i) {
+    gst_scaled_rows_get (scaled, &reader, scaled->rect_y + i, &row0, &row1,
+        &fy);
+
+    sum = 0;
+    sumsq = 0;
+    for (k = 0; k < scaled->rect_width; ++k) {
+      gst_scaled_pixel_get (scaled, row0, row1, fy, k, value);
+      for (c = 0; c < 3; ++c) {
+        sum += value[c];
+        sumsq += (gdouble) value[c] * value[c];
+      }
+    }
+    args->row_sum[i] = sum;
+    args->row_sumsq[i] = sumsq;
+  }
+  gst_row_reader_clear (&reader);
+}
+
+static gboolean
+gst_sum_scaled (GstVideoFrame * inframe, GstVideoFrame * outframe,
+    gint offset, gint channels, gdouble * mean, gdouble * variance,
+    gdouble * count)
+{
+  GstMeansStdArgs scaled;
+  GstSumArgs args;
+  gdouble sum = 0, sumsq = 0;
+  gint i;
+
+  scaled.inframe = inframe;
+  scaled.outframe = outframe;
+  scaled.offset = offset;
+  scaled.channels = channels;
+  if (!gst_scaled_taps_init (&scaled)) {
+    return FALSE;
+  }
+
+  /* Over the interpolated values of the region, letterbox borders are
+   * padding and not part of the image
+   */
+  args.scaled = &scaled;
+  args.row_sum = g_new (gdouble, scaled.rect_height);
+  args.row_sumsq = g_new (gdouble, scaled.rect_height);
+  gst_preprocess_run_rows (gst_sum_scaled_rows, &args, scaled.rect_height,
+      (gsize) scaled.rect_width * scaled.rect_height);
+
+  for (i = 0; i < scaled.rect_height; ++i) {
+    sum += args.row_sum[i];
+    sumsq += args.row_sumsq[i];
+  }
+
+  *count = (gdouble) scaled.rect_width * scaled.rect_height * 3;
+  *mean = sum / *count;
+  *variance = MAX (sumsq / *count - *mean * *mean, 0);
+
+  g_free (args.row_sum);
+  g_free (args.row_sumsq);
+  gst_scaled_taps_clear (&scaled);
+
+  return TRUE;
+}
+
+static void
+gst_normalize_with_lut_rows (gpointer data, gint start, gint end)
+{
+  GstMeansStdArgs *args = (GstMeansStdArgs *) data;
+  const GstNormalizeLut *lut = args->lut;
+  GstRowReader reader;
+  GstRowWriter writer;
+  gint i, j, width;
+  gsize red, green, blue;
+  const guchar *in;
+  gfloat *out;
+
+  width = GST_VIDEO_FRAME_WIDTH (args->inframe);
+
+  gst_row_reader_init (&reader, args->inframe);
+  gst_row_writer_init (&writer, args->outframe, args->model_channels);
+  green = writer.channel_step;
+  red = args->first_index * green;
+  blue = args->last_index * green;
+
+  for (i = start; i < end; ++i) {
+    in = gst_row_reader_get (&reader, i) + args->offset;
+    out = gst_row_writer_get (&writer, i);
 
-  for (i = 0; i < height; ++i) {
     for (j = 0; j < width; ++j) {
-      ((gfloat *) outframe->data[0])[(i * width + j) * model_channels +
-          first_index] =
-          (((guchar *) inframe->data[0])[(i * pixel_stride + j) * channels +
-              0 + offset] - mean_red) * std_r;
-      ((gfloat *) outframe->data[0])[(i * width + j) * model_channels + 1] =
-          (((guchar *) inframe->data[0])[(i * pixel_stride + j) * channels +
-              1 + offset] - mean_green) * std_g;
-      ((gfloat *) outframe->data[0])[(i * width + j) * model_channels +
-          last_index] =
-          (((guchar *) inframe->data[0])[(i * pixel_stride + j) * channels +
-              2 + offset] - mean_blue) * std_b;
+      out[red] = lut->table[0][in[0]];
+      out[green] = lut->table[1][in[1]];
+      out[blue] = lut->table[2][in[2]];
+      in += args->channels;
+      out += writer.pixel_step;
     }
+    gst_row_writer_commit (&writer, i);
+  }
+  gst_row_reader_clear (&reader);
+  gst_row_writer_clear (&writer);
+}
+
+/* Quantized tensors divide every value by their scale */
+static gboolean
+gst_check_tensor_meta (GstVideoFrame * outframe)
+{
+  GstInferenceTensorMeta *meta = NULL;
+
+  if (outframe->buffer) {
+    meta = (GstInferenceTensorMeta *) gst_buffer_get_meta (outframe->buffer,
+        GST_INFERENCE_TENSOR_META_API_TYPE);
+  }
+
+  if (NULL == meta || (GST_INFERENCE_TENSOR_TYPE_INT8 != meta->type
+          && GST_INFERENCE_TENSOR_TYPE_UINT8 != meta->type)) {
+    return TRUE;
   }
+
+  g_return_val_if_fail (meta->scale > 0, FALSE);
+
+  return TRUE;
 }
 
 static gboolean
@@ -101,6 +1719,15 @@ gst_check_format_RGB (GstVideoFrame * inframe, gint * first_index,
       *last_index = 0;
       *offset = 1;
       break;
+    case GST_VIDEO_FORMAT_NV12:
+    case GST_VIDEO_FORMAT_I420:
+    case GST_VIDEO_FORMAT_YUY2:
+      /* Read as packed RGB rows */
+      *channels = 3;
+      *first_index = 0;
+      *last_index = 2;
+      *offset = 0;
+      break;
     default:
       return FALSE;
       break;
@@ -120,67 +1747,65 @@ gst_normalize (GstVideoFrame * inframe, GstVideoFrame * outframe, gdouble mean,
     return FALSE;
   }
 
-  gst_apply_means_std (inframe, outframe, first_index, last_index, offset,
-      channels, mean, mean, mean, std, std, std, model_channels);
-
-  return TRUE;
+  return gst_apply_means_std (inframe, outframe, first_index, last_index,
+      offset, channels, mean, mean, mean, std, std, std, model_channels);
 }
 
 gboolean
 gst_normalize_face (GstVideoFrame * inframe, GstVideoFrame * outframe,
     gint model_channels)
 {
-  gint i, j, pixel_stride, width, height, channels;
-  gdouble mean, std, variance, sum, normalized, R, G, B;
-  gint first_index = 0, last_index = 0, offset = 0;
-
-  channels = GST_VIDEO_FRAME_N_COMPONENTS (inframe);
-  pixel_stride = GST_VIDEO_FRAME_COMP_STRIDE (inframe, 0) / channels;
-  width = GST_VIDEO_FRAME_WIDTH (inframe);
-  height = GST_VIDEO_FRAME_HEIGHT (inframe);
-
-  sum = 0;
-  normalized = 0;
+  GstSumArgs args;
+  gint first_index = 0, last_index = 0, offset = 0, channels = 0;
+  gint k, width, height;
+  guint8 mask[16];
+  gdouble count, mean, variance, std;
 
   g_return_val_if_fail (inframe != NULL, FALSE);
   g_return_val_if_fail (outframe != NULL, FALSE);
+  if (gst_check_format_RGB (inframe, &first_index, &last_index, &offset,
+          &channels) == FALSE) {
+    return FALSE;
+  }
 
-  for (i = 0; i < height; ++i) {
-    for (j = 0; j < width; ++j) {
-      sum =
-          sum + (((guchar *) inframe->data[0])[(i * pixel_stride +
-                  j) * channels + 0]);
-      sum =
-          sum + (((guchar *) inframe->data[0])[(i * pixel_stride +
-                  j) * channels + 1]);
-      sum =
-          sum + (((guchar *) inframe->data[0])[(i * pixel_stride +
-                  j) * channels + 2]);
+  /* The statistics are those of the tensor, not of the input */
+  if (gst_is_scaled (inframe, outframe)) {
+    if (!gst_sum_scaled (inframe, outframe, offset, channels, &mean,
+            &variance, &count)) {
+      return FALSE;
     }
+    goto apply;
   }
 
-  mean = sum / (float) (width * height * channels);
+  width = GST_VIDEO_FRAME_WIDTH (inframe);
+  height = GST_VIDEO_FRAME_HEIGHT (inframe);
 
-  for (i = 0; i < height; ++i) {
-    for (j = 0; j < width; ++j) {
-      R = (gfloat) ((((guchar *) inframe->data[0])[(i * pixel_stride +
-                      j) * channels + 0])) - mean;
-      G = (gfloat) ((((guchar *) inframe->data[0])[(i * pixel_stride +
-                      j) * channels + 1])) - mean;
-      B = (gfloat) ((((guchar *) inframe->data[0])[(i * pixel_stride +
-                      j) * channels + 2])) - mean;
-      normalized = normalized + pow (R, 2);
-      normalized = normalized + pow (G, 2);
-      normalized = normalized + pow (B, 2);
-    }
+  /* Only the color components are accounted, not the padding byte */
+  for (k = 0; k < 16; ++k) {
+    mask[k] = (k % channels >= offset && k % channels < offset + 3) ? 0xff : 0;
   }
 
-  variance = normalized / (float) (width * height * channels);
-  std = 1 / sqrt (variance);
+  /* Sum and sum of squares in a single integer pass */
+  args.inframe = inframe;
+  args.mask = mask;
+  args.size = width * channels;
+  args.sum = 0;
+  args.sumsq = 0;
+  g_mutex_init (&args.mutex);
+  gst_preprocess_run_rows (gst_sum_rows, &args, height,
+      (gsize) width * height);
+  g_mutex_clear (&args.mutex);
 
-  gst_apply_means_std (inframe, outframe, first_index, last_index, offset,
-      channels, mean, mean, mean, std, std, std, model_channels);
-  return TRUE;
+  count = (gdouble) width * height * 3;
+  mean = args.sum / count;
+  variance = MAX (args.sumsq / count - mean * mean, 0);
+
+apply:
+  /* As in the FaceNet prewhitening, flat images are not divided by zero */
+  std = 1 / MAX (sqrt (variance), 1 / sqrt (count));
+
+  return gst_apply_means_std (inframe, outframe, first_index, last_index,
+      offset, channels, mean, mean, mean, std, std, std, model_channels);
 }
 
 gboolean
@@ -197,9 +1822,9 @@ gst_subtract_mean (GstVideoFrame * inframe, GstVideoFrame * outframe,
     return FALSE;
   }
 
-  gst_apply_means_std (inframe, outframe, first_index, last_index, offset,
-      channels, mean_red, mean_green, mean_blue, std, std, std, model_channels);
-  return TRUE;
+  return gst_apply_means_std (inframe, outframe, first_index, last_index,
+      offset, channels, mean_red, mean_green, mean_blue, std, std, std,
+      model_channels);
 }
 
 gboolean
@@ -215,7 +1840,129 @@ gst_pixel_to_float (GstVideoFrame * inframe, GstVideoFrame * outframe,
     return FALSE;
   }
 
-  gst_apply_means_std (inframe, outframe, first_index, last_index, offset,
-      channels, mean, mean, mean, std, std, std, model_channels);
+  return gst_apply_means_std (inframe, outframe, first_index, last_index,
+      offset, channels, mean, mean, mean, std, std, std, model_channels);
+}
+
+GstNormalizeLut *
+gst_normalize_lut_get (gdouble mean_red, gdouble mean_green,
+    gdouble mean_blue, gdouble std_red, gdouble std_green, gdouble std_blue)
+{
+  const gdouble mean[3] = { mean_red, mean_green, mean_blue };
+  const gdouble std[3] = { std_red, std_green, std_blue };
+  GstNormalizeLut *lut = NULL;
+  GList *iter;
+  gint c, i;
+
+  g_mutex_lock (&lut_mutex);
+
+  for (iter = luts; iter; iter = iter->next) {
+    GstNormalizeLut *candidate = (GstNormalizeLut *) iter->data;
+
+    if (0 == memcmp (candidate->mean, mean, sizeof (mean))
+        && 0 == memcmp (candidate->std, std, sizeof (std))) {
+      lut = candidate;
+      lut->refcount++;
+      break;
+    }
+  }
+
+  if (NULL == lut) {
+    lut = g_new (GstNormalizeLut, 1);
+    lut->refcount = 1;
+    memcpy (lut->mean, mean, sizeof (mean));
+    memcpy (lut->std, std, sizeof (std));
+
+    /* Same math as gst_apply_means_std, so the results are identical */
+    for (c = 0; c < 3; ++c) {
+      for (i = 0; i < 256; ++i) {
+        lut->table[c][i] = (i - mean[c]) * std[c];
+      }
+    }
+
+    luts = g_list_prepend (luts, lut);
+  }
+
+  g_mutex_unlock (&lut_mutex);
+
+  return lut;
+}
+
+void
+gst_normalize_lut_unref (GstNormalizeLut * lut)
+{
+  g_return_if_fail (lut != NULL);
+
+  g_mutex_lock (&lut_mutex);
+
+  lut->refcount--;
+  if (0 == lut->refcount) {
+    luts = g_list_remove (luts, lut);
+    g_free (lut);
+  }
+
+  g_mutex_unlock (&lut_mutex);
+}
+
+gboolean
+gst_normalize_with_lut (GstVideoFrame * inframe, GstVideoFrame * outframe,
+    GstNormalizeLut * lut, gint model_channels)
+{
+  GstMeansStdArgs args;
+  gint first_index = 0, last_index = 0, offset = 0, channels = 0;
+  gint width, height;
+
+  g_return_val_if_fail (inframe != NULL, FALSE);
+  g_return_val_if_fail (outframe != NULL, FALSE);
+  g_return_val_if_fail (lut != NULL, FALSE);
+  if (gst_check_format_RGB (inframe, &first_index, &last_index, &offset,
+          &channels) == FALSE) {
+    return FALSE;
+  }
+
+  if (!gst_check_tensor_meta (outframe)) {
+    return FALSE;
+  }
+
+  width = GST_VIDEO_FRAME_WIDTH (inframe);
+  height = GST_VIDEO_FRAME_HEIGHT (inframe);
+
+  args.inframe = inframe;
+  args.outframe = outframe;
+  args.first_index = first_index;
+  args.last_index = last_index;
+  args.offset = offset;
+  args.channels = channels;
+  args.model_channels = model_channels;
+  args.lut = lut;
+
+  /* Scaled pixels are looked up once interpolated, the means and std
+   * are only used for the letterbox borders
+   */
+  if (gst_is_scaled (inframe, outframe)) {
+    memcpy (args.mean, lut->mean, sizeof (args.mean));
+    memcpy (args.std, lut->std, sizeof (args.std));
+    return gst_apply_means_std_scaled (&args);
+  }
+
+  gst_preprocess_run_rows (gst_normalize_with_lut_rows, &args, height,
+      (gsize) width * height);
+
   return TRUE;
 }
+
+void
+gst_preprocess_set_threads (guint threads, guint min_pixels)
+{
+  g_mutex_lock (&pool_mutex);
+
+  pool_configured = TRUE;
+  pool_threads = threads;
+  pool_min_pixels = min_pixels;
+  if (pool) {
+    threads = threads ? threads : g_get_num_processors ();
+    g_thread_pool_set_max_threads (pool, MAX (threads, 2) - 1, NULL);
+  }
+
+  g_mutex_unlock (&pool_mutex);
+}
@@ -26,11 +26,28 @@
 
 G_BEGIN_DECLS
 
+/* Preprocessing stays on the calling thread unless told otherwise */
+#define GST_PREPROCESS_DEFAULT_THREADS 1
+#define GST_PREPROCESS_DEFAULT_MIN_PIXELS (512 * 512)
+
+/* Environment variables the worker settings are read from on first use,
+ * see gst_preprocess_set_threads
+ */
+#define GST_PREPROCESS_THREADS_ENV "GST_INFERENCE_PREPROCESS_THREADS"
+#define GST_PREPROCESS_MIN_PIXELS_ENV "GST_INFERENCE_PREPROCESS_MIN_PIXELS"
+
 /**
  * \brief Normalization with values between 0 and 1
  *
- * \param inframe The input frame
- * \param outframe The output frame after preprocess
+ * \param inframe The input frame, packed RGB or NV12, I420 and YUY2,
+ * converted with the BT.601 or BT.709 matrix of its colorimetry. Rows are
+ * read with the strides and plane offsets the frame was mapped with, so
+ * padded buffers described by a GstVideoMeta need no repacking
+ * \param outframe The output frame after preprocess. If its size differs
+ * from the input, the input is bilinearly scaled into it, or into the
+ * region of its GstVideoCropMeta with padded borders (letterbox). It is
+ * written planar if it has a GstInferenceTensorMeta with the NCHW layout,
+ * and as half floats or quantized 8 bit integers if the meta type says so
  * \param mean The mean value of the channel
  * \param std  The standart deviation of the channel
  * \param model_channels The number of channels of the model
@@ -39,10 +56,12 @@ G_BEGIN_DECLS
 gboolean gst_normalize(GstVideoFrame * inframe, GstVideoFrame * outframe, gdouble mean, gdouble std, gint model_channels);
 
 /**
- * \brief Especial normalization used for facenet
+ * \brief Especial normalization used for facenet. The mean and standard
+ * deviation are those of the image in the tensor, after scaling and
+ * without the letterbox borders
  *
- * \param inframe The input frame
- * \param outframe The output frame after preprocess
+ * \param inframe The input frame, any format of gst_normalize
+ * \param outframe The output frame after preprocess, scaled and laid out as in gst_normalize
  * \param model_channels The number of channels of the model
  */
 
@@ -51,8 +70,8 @@ gboolean gst_normalize_face(GstVideoFrame * inframe, GstVideoFrame * outframe, g
 /**
  * \brief Substract the mean value to every pixel
  *
- * \param inframe The input frame
- * \param outframe The output frame after preprocess
+ * \param inframe The input frame, any format of gst_normalize
+ * \param outframe The output frame after preprocess, scaled and laid out as in gst_normalize
  * \param mean_red The mean value of the channel red
  * \param mean_green The mean value of the channel green
  * \param mean_blue The mean value of the channel blue
@@ -64,13 +83,72 @@ gboolean gst_subtract_mean(GstVideoFrame * inframe, GstVideoFrame * outframe, gd
 /**
  * \brief Change every pixel value to float
  *
- * \param inframe The input frame
- * \param outframe The output frame after preprocess
+ * \param inframe The input frame, any format of gst_normalize
+ * \param outframe The output frame after preprocess, scaled and laid out as in gst_normalize
  * \param model_channels The number of channels of the model
  */
 
 gboolean gst_pixel_to_float(GstVideoFrame * inframe, GstVideoFrame * outframe, gint model_channels);
 
+/**
+ * \brief Per channel tables with the normalized value of every 8 bit
+ * pixel value, shared by every user of the same mean and std
+ */
+typedef struct _GstNormalizeLut GstNormalizeLut;
+
+/**
+ * \brief Get the lookup tables for the given means and standard
+ * deviations, they are built the first time and shared afterwards
+ *
+ * \param mean_red The mean value of the channel red
+ * \param mean_green The mean value of the channel green
+ * \param mean_blue The mean value of the channel blue
+ * \param std_red The standard deviation of the channel red
+ * \param std_green The standard deviation of the channel green
+ * \param std_blue The standard deviation of the channel blue
+ *
+ * \return A reference to the tables, release it with gst_normalize_lut_unref
+ */
+
+GstNormalizeLut * gst_normalize_lut_get(gdouble mean_red, gdouble mean_green, gdouble mean_blue, gdouble std_red, gdouble std_green, gdouble std_blue);
+
+/**
+ * \brief Release a reference to the lookup tables
+ *
+ * \param lut The tables to release
+ */
+
+void gst_normalize_lut_unref(GstNormalizeLut * lut);
+
+/**
+ * \brief Normalize every pixel by looking up its value in the tables,
+ * same results as gst_subtract_mean and gst_normalize with their values.
+ * When scaling, the interpolated values are rounded to 8 bits before the
+ * lookup, so they may differ from gst_normalize by up to half a step
+ *
+ * \param inframe The input frame, any format of gst_normalize
+ * \param outframe The output frame after preprocess, scaled and laid out as in gst_normalize
+ * \param lut The tables from gst_normalize_lut_get
+ * \param model_channels The number of channels of the model
+ */
+
+gboolean gst_normalize_with_lut(GstVideoFrame * inframe, GstVideoFrame * outframe, GstNormalizeLut * lut, gint model_channels);
+
+/**
+ * \brief Set the worker threads every preprocess function splits its
+ * frames among by bands of rows. The setting and the workers are shared
+ * by the whole process. Without a call, they are read from the
+ * GST_INFERENCE_PREPROCESS_THREADS and GST_INFERENCE_PREPROCESS_MIN_PIXELS
+ * environment variables the first time a frame is preprocessed
+ *
+ * \param threads The number of threads including the calling one, 0 for
+ * one per CPU and 1 to preprocess on the calling thread only
+ * \param min_pixels The least pixels a band is given, so small frames
+ * stay on the calling thread
+ */
+
+void gst_preprocess_set_threads(guint threads, guint min_pixels);
+
 G_END_DECLS
 
 #endif
@@ -21,9 +21,12 @@
 
 #include "gstvideoinference.h"
 #include "gstinferencebackends.h"
+#include "gstinferencemeta.h"
 #include "gstbackend.h"
 
 #include <gst/base/gstcollectpads.h>
+#include <gst/base/gstdataqueue.h>
+#include <string.h>
 
 
 static GstStaticPadTemplate sink_bypass_factory =
@@ -40,10 +43,49 @@ GST_STATIC_PAD_TEMPLATE ("src_bypass",
     GST_STATIC_CAPS ("ANY")
     );
 
+static GstStaticPadTemplate sink_bypass_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("sink_bypass_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("ANY")
+    );
+
+static GstStaticPadTemplate src_bypass_stream_factory =
+GST_STATIC_PAD_TEMPLATE ("src_bypass_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("ANY")
+    );
+
 GST_DEBUG_CATEGORY_STATIC (gst_video_inference_debug_category);
 #define GST_CAT_DEFAULT gst_video_inference_debug_category
 
 #define DEFAULT_MODEL_LOCATION   NULL
+#define DEFAULT_ASYNC            FALSE
+#define DEFAULT_QUEUE_SIZE       2
+#define MIN_QUEUE_SIZE           1
+#define MAX_QUEUE_SIZE           64
+#define DEFAULT_INFERENCE_INTERVAL 1
+#define DEFAULT_MODEL_CHANNELS   3
+#define DEFAULT_TENSOR_LAYOUT    GST_INFERENCE_TENSOR_LAYOUT_NHWC
+#define DEFAULT_TENSOR_TYPE      GST_INFERENCE_TENSOR_TYPE_FLOAT32
+#define DEFAULT_TENSOR_SCALE     1.0
+#define DEFAULT_TENSOR_ZERO_POINT 0
+#define MIN_TENSOR_BUFFERS       1
+#define DEFAULT_BATCH_SIZE       1
+#define MIN_BATCH_SIZE           1
+#define MAX_BATCH_SIZE           64
+#define DEFAULT_BATCH_TIMEOUT    0
+#define MIN_BATCH_TIMEOUT        0
+#define MAX_BATCH_TIMEOUT        G_MAXUINT
+#define MIN_INFERENCE_INTERVAL   1
+#define MAX_INFERENCE_INTERVAL   G_MAXUINT
+#define DEFAULT_NUM_WORKERS      1
+#define MIN_NUM_WORKERS          1
+#define MAX_NUM_WORKERS          64
+#define DEFAULT_WORKER_DISPATCH  GST_BACKEND_DISPATCH_LEAST_LOADED
+#define DEFAULT_ROI              FALSE
+#define DEFAULT_LETTERBOX        FALSE
 
 enum
 {
@@ -55,33 +97,198 @@ enum
 {
   PROP_0,
   PROP_BACKEND,
-  PROP_MODEL_LOCATION
+  PROP_MODEL_LOCATION,
+  PROP_ASYNC,
+  PROP_QUEUE_SIZE,
+  PROP_INFERENCE_INTERVAL,
+  PROP_BATCH_SIZE,
+  PROP_BATCH_TIMEOUT,
+  PROP_NUM_WORKERS,
+  PROP_WORKER_DISPATCH,
+  PROP_ROI,
+  PROP_LETTERBOX
 };
 
 
+typedef struct _GstVideoInferenceStream GstVideoInferenceStream;
+
 typedef struct _GstVideoInferencePad GstVideoInferencePad;
 struct _GstVideoInferencePad
 {
   GstCollectData data;
 
   GstVideoInfo info;
+  GstVideoInferenceStream *stream;
 };
 
-typedef struct _GstVideoInferencePrivate GstVideoInferencePrivate;
-struct _GstVideoInferencePrivate
+/* A set of model and bypass pads sharing the element backend. Stream 0
+ * owns the sink_model, src_model, sink_bypass and src_bypass pads,
+ * stream N the sink_model_N, src_model_N, sink_bypass_N and
+ * src_bypass_N pads. Frames hold a reference so the stream outlives
+ * its pads while they are in flight.
+ *
+ * Collect pads only calls back once every stream has a buffer queued, so
+ * all the streams advance at the pace of the slowest one and a stream
+ * that stops producing without EOS stalls the others. Streams should
+ * come from sources running at the same rate, live sources that may
+ * drop or pause need a leaky queue upstream of the element.
+ */
+struct _GstVideoInferenceStream
 {
-  GstCollectPads *cpads;
-  GstVideoInferencePad *sink_bypass_data;
-  GstVideoInferencePad *sink_model_data;
+  gint refcount;
+  guint index;
 
   GstPad *sink_bypass;
   GstPad *src_bypass;
   GstPad *sink_model;
   GstPad *src_model;
 
+  GstVideoInferencePad *sink_bypass_data;
+  GstVideoInferencePad *sink_model_data;
+
+  /* Recycles the preprocessed tensor buffers, sized from the tensor
+   * info: the caps format at the model size.
+   */
+  GstVideoInfo tensor_info;
+  GstBufferPool *tensor_pool;
+
+  /* The meta of the last valid prediction is kept in an empty buffer so
+   * it can be transformed onto the skipped buffers.
+   */
+  guint64 frame_count;
+  GstBuffer *last_meta_buffer;
+  GstVideoInfo last_meta_info;
+
+  /* Protected by the async mutex */
+  guint pending;
+  gboolean flushing;
+  GstFlowReturn ret;
+};
+
+/* A box of the upstream detection meta, cropped, scaled to the model
+ * size and preprocessed on its own.
+ */
+typedef struct _GstVideoInferenceRoi GstVideoInferenceRoi;
+struct _GstVideoInferenceRoi
+{
+  gint box_index;
+
+  GstVideoFrame tensor;
+  gboolean tensor_mapped;
+
+  GBytes *prediction;
+};
+
+/* A pair of model and bypass buffers traveling through the inference
+ * stages: preprocess, predict and postprocess.
+ */
+typedef struct _GstVideoInferenceFrame GstVideoInferenceFrame;
+struct _GstVideoInferenceFrame
+{
+  GstBuffer *buffer_model;
+  GstBuffer *buffer_bypass;
+
+  GstVideoInfo info_model;
+  GstVideoInfo info_bypass;
+  gboolean has_info_bypass;
+
+  GstVideoFrame tensor;
+  gboolean tensor_mapped;
+  /* Region of the tensor the frame was scaled into */
+  GstVideoRectangle tensor_rect;
+
+  GBytes *prediction;
+
+  /* No inference is run, the last prediction is carried over */
+  gboolean skip;
+
+  /* In ROI mode inference runs on these instead of the whole frame */
+  GArray *rois;
+
+  GstVideoInferenceStream *stream;
+};
+
+typedef struct _GstVideoInferenceQueueItem GstVideoInferenceQueueItem;
+struct _GstVideoInferenceQueueItem
+{
+  GstDataQueueItem item;
+
+  GstVideoInference *self;
+  GPtrArray *frames;
+  /* Dispatch order, used to restore it after parallel prediction */
+  guint64 seq;
+};
+
+typedef struct _GstVideoInferencePrivate GstVideoInferencePrivate;
+struct _GstVideoInferencePrivate
+{
+  GstCollectPads *cpads;
+
+  /* Sorted by index, protected by the object lock */
+  GList *streams;
+
   GstBackend *backend;
 
   gchar *model_location;
+
+  /* Async mode: preprocess runs on the collect pads thread, predict and
+   * postprocess run on their own threads connected by bounded queues.
+   */
+  gboolean async;
+  guint queue_size;
+  GstDataQueue *predict_queue;
+  GstDataQueue *postprocess_queue;
+  GPtrArray *predict_threads;
+  GThread *postprocess_thread;
+  GMutex async_mutex;
+  GCond async_cond;
+  gboolean async_running;
+  /* Fatal flow return of frames finished outside of the collect pads
+   * thread, non fatal ones are kept per stream.
+   */
+  GstFlowReturn async_ret;
+  /* Async stages are also used when there are several workers */
+  gboolean async_enabled;
+
+  /* Each worker is a predict thread with its own backend engine.
+   * Batches finishing out of order wait in the reorder queue until
+   * the ones dispatched before them are done.
+   */
+  guint num_workers;
+  GstBackendDispatch worker_dispatch;
+  guint64 dispatch_seq;
+  guint64 reorder_next;
+  GQueue reorder;
+  GMutex reorder_mutex;
+
+  /* Infer on the boxes of the upstream detection meta */
+  gboolean roi;
+
+  /* Keep the aspect ratio when scaling to the model size */
+  gboolean letterbox;
+
+  /* Model input size, the one of the class unless set on start */
+  gint model_width;
+  gint model_height;
+
+  /* Tensor type agreed on start by the model and the backend */
+  GstInferenceTensorType tensor_type;
+
+  /* Only one out of every inference_interval model buffers is inferred */
+  guint inference_interval;
+
+  /* Frames are grouped until batch_size of them need inference or the
+   * batch_timeout (ms) since the first one expires.
+   */
+  guint batch_size;
+  guint batch_timeout;
+  GPtrArray *batch;
+  guint batch_inferred;
+  gint64 batch_deadline;
+  GMutex batch_mutex;
+  GCond batch_cond;
+  GThread *batch_thread;
+  gboolean batch_running;
 };
 
 /* GObject methods */
@@ -109,32 +316,103 @@ static GObject *gst_video_inference_get_child_by_index (GstChildProxy * parent,
 static guint gst_video_inference_get_children_count (GstChildProxy * parent);
 
 /* GstVideoInference methods */
+static gboolean gst_video_inference_negotiate_tensor_type (GstVideoInference *
+    self, GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv);
 static gboolean gst_video_inference_start (GstVideoInference * self);
 static gboolean gst_video_inference_stop (GstVideoInference * self);
 static GstPad *gst_video_inference_create_pad (GstVideoInference * self,
-    GstPadTemplate * templ, const gchar * name, GstVideoInferencePad ** data);
+    GstPadTemplate * templ, const gchar * name,
+    GstVideoInferenceStream * stream, GstVideoInferencePad ** data);
 static GstFlowReturn gst_video_inference_collected (GstCollectPads * pads,
     gpointer user_data);
 static GstFlowReturn gst_video_inference_pop_buffer (GstVideoInference * self,
     GstCollectPads * cpads, GstCollectData * data, GstBuffer ** buffer);
+static GstVideoInferenceFrame *gst_video_inference_pop_frame (GstVideoInference
+    * self, GstVideoInferencePrivate * priv, GstCollectPads * pads,
+    GstVideoInferenceStream * stream, GstFlowReturn * stream_ret);
 static GstFlowReturn gst_video_inference_forward_buffer (GstVideoInference *
     self, GstBuffer * buffer, GstPad * pad);
-static gboolean gst_video_inference_model_buffer_process (GstVideoInference *
+static GstVideoInferenceFrame *gst_video_inference_frame_new (GstVideoInference
+    * self, GstVideoInferenceStream * stream, GstBuffer * buffer_model,
+    GstBuffer * buffer_bypass);
+static void gst_video_inference_frame_free (GstVideoInferenceFrame * frame);
+static gboolean gst_video_inference_frame_preprocess (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame);
+static GstFlowReturn gst_video_inference_frame_finish (GstVideoInference *
+    self, GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame);
+static gboolean gst_video_inference_batch_predict (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GPtrArray * frames);
+static GstFlowReturn gst_video_inference_process_batch (GstVideoInference *
     self, GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
-    GstBuffer * buffer, gpointer * prediction_data, gsize * prediction_size);
+    GPtrArray * frames);
+
+static GstFlowReturn gst_video_inference_batch_add (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GPtrArray * frames);
+static GPtrArray *gst_video_inference_batch_take (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream,
+    guint64 * seq);
+static GstFlowReturn gst_video_inference_batch_send (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GPtrArray * frames, guint64 seq);
+static void gst_video_inference_batch_flush (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream,
+    gboolean discard);
+static gboolean gst_video_inference_batch_start (GstVideoInference * self,
+    GstVideoInferencePrivate * priv);
+static void gst_video_inference_batch_stop (GstVideoInference * self,
+    GstVideoInferencePrivate * priv);
+static void gst_video_inference_batch_join (GstVideoInference * self,
+    GstVideoInferencePrivate * priv);
+static gpointer gst_video_inference_batch_loop (gpointer user_data);
+
+static gboolean gst_video_inference_async_start (GstVideoInference * self,
+    GstVideoInferencePrivate * priv);
+static void gst_video_inference_async_stop (GstVideoInference * self,
+    GstVideoInferencePrivate * priv);
+static void gst_video_inference_async_join (GstVideoInference * self,
+    GstVideoInferencePrivate * priv);
+static void gst_video_inference_async_drain (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream);
+static gboolean gst_video_inference_async_push (GstVideoInference * self,
+    GstDataQueue * queue, GPtrArray * frames, guint64 seq);
+static GPtrArray *gst_video_inference_async_pop (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstDataQueue * queue, guint64 * seq);
+static void gst_video_inference_async_reorder (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GPtrArray * frames, guint64 seq);
+static void gst_video_inference_async_frame_done (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceFrame * frame,
+    GstFlowReturn ret);
+static gpointer gst_video_inference_predict_loop (gpointer user_data);
+static gpointer gst_video_inference_postprocess_loop (gpointer user_data);
 
 static gboolean gst_video_inference_preprocess (GstVideoInference * self,
     GstVideoInferenceClass * klass, GstVideoFrame * inframe,
     GstVideoFrame * outframe);
 static gboolean gst_video_inference_predict (GstVideoInference * self,
-    GstVideoInferencePrivate * priv, GstVideoFrame * frame, gpointer * pred,
-    gsize * pred_size);
+    GstVideoInferencePrivate * priv, GstVideoFrame ** frames,
+    guint num_frames, GBytes ** preds);
 
 static gboolean gst_video_inference_postprocess (GstVideoInference * self,
-    GstVideoInferenceClass * klass, const gpointer prediction_data,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceStream * stream, const gpointer prediction_data,
     gsize prediction_size, GstBuffer * buffer_model,
-    GstVideoInferencePad * pad_model, GstBuffer * buffer_bypass,
-    GstVideoInferencePad * pad_bypass);
+    GstVideoInfo * info_model, GstBuffer * buffer_bypass,
+    GstVideoInfo * info_bypass, gint box_index,
+    GstVideoRectangle * tensor_rect);
+static gboolean gst_video_inference_frame_preprocess_rois (GstVideoInference *
+    self, GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame);
+static gboolean gst_video_inference_postprocess_rois (GstVideoInference *
+    self, GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame, GstVideoInfo * info_bypass);
+static gboolean video_inference_crop (GstVideoFrame * inframe, BBox * box,
+    GstVideoFrame * cropframe);
+static void video_inference_roi_clear (GstVideoInferenceRoi * roi);
+static guint video_inference_frame_num_tensors (GstVideoInferenceFrame *
+    frame);
 
 static GstIterator *gst_video_inference_iterate_internal_links (GstPad * pad,
     GstObject * parent);
@@ -146,18 +424,65 @@ static GstPad *gst_video_inference_get_src_pad (GstVideoInference * self,
     GstVideoInferencePrivate * priv, GstPad * pad);
 static GstPad *gst_video_inference_get_sink_pad (GstVideoInference * self,
     GstVideoInferencePrivate * priv, GstPad * pad);
+
+static GstVideoInferenceStream *gst_video_inference_get_stream
+    (GstVideoInference * self, GstVideoInferencePrivate * priv, guint index,
+    gboolean create);
+static GstVideoInferenceStream *gst_video_inference_find_stream
+    (GstVideoInference * self, GstVideoInferencePrivate * priv, GstPad * pad);
+static GPtrArray *gst_video_inference_ref_streams (GstVideoInference * self,
+    GstVideoInferencePrivate * priv);
+static void gst_video_inference_reset_streams (GstVideoInference * self,
+    GstVideoInferencePrivate * priv);
+static void gst_video_inference_stream_set_flushing (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream,
+    gboolean flushing);
+static GstVideoInferenceStream *video_inference_stream_new (guint index);
+static GstVideoInferenceStream *video_inference_stream_ref
+    (GstVideoInferenceStream * stream);
+static void video_inference_stream_unref (GstVideoInferenceStream * stream);
+static void video_inference_stream_reset (GstVideoInferencePrivate * priv,
+    GstVideoInferenceStream * stream);
+static gboolean video_inference_stream_is_flushing (GstVideoInferencePrivate *
+    priv, GstVideoInferenceStream * stream);
 static void
 gst_video_inference_set_backend (GstVideoInference * self, gint backend);
 static guint gst_video_inference_get_backend_type (GstVideoInference * self);
 static void gst_video_inference_set_caps (GstVideoInference * self,
     GstVideoInferencePrivate * priv, GstCollectData * pad, GstEvent * event);
 
-static void video_inference_map_buffers (GstVideoInferencePad * data,
-    GstBuffer * inbuf, GstVideoFrame * inframe, GstVideoFrame * outframe);
+static void video_inference_tensor_rect (GstVideoInfo * info,
+    GstVideoInfo * tensor_info, gboolean letterbox, GstVideoRectangle * rect);
+static void video_inference_tensor_crop (GstVideoFrame * tensor,
+    GstVideoRectangle * rect);
+static void video_inference_meta_to_frame (GstMeta * meta,
+    GstVideoRectangle * rect, GstVideoInfo * info);
+static gboolean gst_video_inference_tensor_pool_configure (GstVideoInference *
+    self, GstVideoInferenceStream * stream, GstVideoInfo * info);
+static void video_inference_tensor_pool_clear (GstVideoInferenceStream *
+    stream);
+
+static gboolean video_inference_map_buffers (GstVideoInferencePad * data,
+    GstBufferPool * pool, GstBuffer * inbuf, GstVideoFrame * inframe,
+    GstVideoFrame * outframe);
 static gboolean video_inference_prepare_postprocess (const GstMetaInfo *
     meta_info, GstBuffer * buffer, GstVideoInfo * video_info,
     GstVideoFrame * out_frame, GstMeta ** out_meta);
 static void video_inference_buffer_unref (GstBuffer * buffer);
+static void video_inference_tensor_unmap (GstVideoInferenceFrame * frame);
+static void video_inference_store_meta (GstVideoInferencePrivate * priv,
+    GstVideoInferenceStream * stream, GstBuffer * buffer_model,
+    GstVideoInfo * info_model, GstMeta * meta_model);
+static void gst_video_inference_carry_over_meta (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame, GstVideoInfo * info_bypass);
+static void video_inference_store_flow_return (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream,
+    GstFlowReturn ret);
+static void video_inference_queue_item_free (GstVideoInferenceQueueItem *
+    qitem);
+static gboolean video_inference_queue_check_full (GstDataQueue * queue,
+    guint visible, guint bytes, guint64 time, gpointer checkdata);
 static void video_inference_frame_unmap (GstBuffer * buffer,
     GstVideoFrame * frame);
 static void video_inference_remove_meta (GstBuffer * buffer, GstMeta * meta);
@@ -195,6 +520,10 @@ gst_video_inference_class_init (GstVideoInferenceClass * klass)
   eclass->release_pad = GST_DEBUG_FUNCPTR (gst_video_inference_release_pad);
   gst_element_class_add_static_pad_template (eclass, &sink_bypass_factory);
   gst_element_class_add_static_pad_template (eclass, &src_bypass_factory);
+  gst_element_class_add_static_pad_template (eclass,
+      &sink_bypass_stream_factory);
+  gst_element_class_add_static_pad_template (eclass,
+      &src_bypass_stream_factory);
 
   backends_params = gst_inference_backends_get_string_properties ();
   backend_blurb = g_strdup_printf ("Type of predefined backend to use.\n"
@@ -217,6 +546,63 @@ gst_video_inference_class_init (GstVideoInferenceClass * klass)
           "Path to the model to use", DEFAULT_MODEL_LOCATION,
           G_PARAM_READWRITE));
 
+  g_object_class_install_property (oclass, PROP_ASYNC,
+      g_param_spec_boolean ("async", "Async",
+          "Run preprocess, prediction and postprocess as pipelined stages "
+          "in separate threads, so the next frame is preprocessed while "
+          "the current one is being inferred", DEFAULT_ASYNC,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (oclass, PROP_QUEUE_SIZE,
+      g_param_spec_uint ("queue-size", "Queue Size",
+          "Maximum amount of frames waiting between stages in async mode",
+          MIN_QUEUE_SIZE, MAX_QUEUE_SIZE, DEFAULT_QUEUE_SIZE,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (oclass, PROP_INFERENCE_INTERVAL,
+      g_param_spec_uint ("inference-interval", "Inference Interval",
+          "Run the model on one out of every N buffers. Skipped buffers get "
+          "the meta of the last valid prediction", MIN_INFERENCE_INTERVAL,
+          MAX_INFERENCE_INTERVAL, DEFAULT_INFERENCE_INTERVAL,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (oclass, PROP_BATCH_SIZE,
+      g_param_spec_uint ("batch-size", "Batch Size",
+          "Amount of frames sent together to the backend", MIN_BATCH_SIZE,
+          MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (oclass, PROP_BATCH_TIMEOUT,
+      g_param_spec_uint ("batch-timeout", "Batch Timeout",
+          "Maximum time in milliseconds to wait for a batch to complete "
+          "before sending it incomplete, 0 waits until it is complete. "
+          "A timeout enables the async stages",
+          MIN_BATCH_TIMEOUT, MAX_BATCH_TIMEOUT, DEFAULT_BATCH_TIMEOUT,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (oclass, PROP_NUM_WORKERS,
+      g_param_spec_uint ("num-workers", "Number of Workers",
+          "Amount of backend engines predicting in parallel, each on its "
+          "own thread. More than one enables the async stages",
+          MIN_NUM_WORKERS, MAX_NUM_WORKERS, DEFAULT_NUM_WORKERS,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (oclass, PROP_WORKER_DISPATCH,
+      g_param_spec_enum ("worker-dispatch", "Worker Dispatch",
+          "How batches are distributed among the worker engines",
+          GST_TYPE_BACKEND_DISPATCH, DEFAULT_WORKER_DISPATCH,
+          G_PARAM_READWRITE));
+
+  g_object_class_install_property (oclass, PROP_ROI,
+      g_param_spec_boolean ("roi", "Region of Interest",
+          "Infer on every box of the detection meta attached upstream "
+          "instead of on the whole frame. Only for classification and "
+          "embedding models", DEFAULT_ROI, G_PARAM_READWRITE));
+  g_object_class_install_property (oclass, PROP_LETTERBOX,
+      g_param_spec_boolean ("letterbox", "Letterbox",
+          "Keep the aspect ratio when scaling the input to the model size, "
+          "padding the borders instead of stretching the image",
+          DEFAULT_LETTERBOX, G_PARAM_READWRITE));
+
   gst_video_inference_signals[NEW_PREDICTION_SIGNAL] =
       g_signal_new ("new-prediction", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL, G_TYPE_NONE, 4, G_TYPE_POINTER,
@@ -226,6 +612,13 @@ gst_video_inference_class_init (GstVideoInferenceClass * klass)
   klass->stop = NULL;
   klass->preprocess = NULL;
   klass->postprocess = NULL;
+  klass->model_channels = DEFAULT_MODEL_CHANNELS;
+  klass->model_width = 0;
+  klass->model_height = 0;
+  klass->tensor_layout = DEFAULT_TENSOR_LAYOUT;
+  klass->tensor_types = 1 << DEFAULT_TENSOR_TYPE;
+  klass->tensor_scale = DEFAULT_TENSOR_SCALE;
+  klass->tensor_zero_point = DEFAULT_TENSOR_ZERO_POINT;
 }
 
 static void
@@ -233,13 +626,7 @@ gst_video_inference_init (GstVideoInference * self)
 {
   GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
 
-  priv->sink_bypass_data = NULL;
-  priv->sink_model_data = NULL;
-
-  priv->sink_bypass = NULL;
-  priv->src_bypass = NULL;
-  priv->sink_model = NULL;
-  priv->src_model = NULL;
+  priv->streams = NULL;
 
   priv->cpads = gst_collect_pads_new ();
   gst_collect_pads_set_function (priv->cpads, gst_video_inference_collected,
@@ -249,6 +636,43 @@ gst_video_inference_init (GstVideoInference * self)
 
   priv->model_location = g_strdup (DEFAULT_MODEL_LOCATION);
 
+  priv->async = DEFAULT_ASYNC;
+  priv->queue_size = DEFAULT_QUEUE_SIZE;
+  priv->predict_queue =
+      gst_data_queue_new (video_inference_queue_check_full, NULL, NULL, priv);
+  priv->postprocess_queue =
+      gst_data_queue_new (video_inference_queue_check_full, NULL, NULL, priv);
+  priv->predict_threads = g_ptr_array_new ();
+  priv->postprocess_thread = NULL;
+  g_mutex_init (&priv->async_mutex);
+  g_cond_init (&priv->async_cond);
+  priv->async_running = FALSE;
+  priv->async_ret = GST_FLOW_OK;
+  priv->async_enabled = FALSE;
+
+  priv->num_workers = DEFAULT_NUM_WORKERS;
+  priv->worker_dispatch = DEFAULT_WORKER_DISPATCH;
+  priv->dispatch_seq = 0;
+  priv->reorder_next = 0;
+  g_queue_init (&priv->reorder);
+  g_mutex_init (&priv->reorder_mutex);
+
+  priv->roi = DEFAULT_ROI;
+  priv->letterbox = DEFAULT_LETTERBOX;
+  priv->tensor_type = DEFAULT_TENSOR_TYPE;
+
+  priv->inference_interval = DEFAULT_INFERENCE_INTERVAL;
+
+  priv->batch_size = DEFAULT_BATCH_SIZE;
+  priv->batch_timeout = DEFAULT_BATCH_TIMEOUT;
+  priv->batch = g_ptr_array_new ();
+  priv->batch_inferred = 0;
+  priv->batch_deadline = 0;
+  g_mutex_init (&priv->batch_mutex);
+  g_cond_init (&priv->batch_cond);
+  priv->batch_thread = NULL;
+  priv->batch_running = FALSE;
+
   gst_video_inference_set_backend (self,
       gst_inference_backends_get_default_backend ());
 }
@@ -282,6 +706,107 @@ gst_video_inference_set_property (GObject * object,
       }
       GST_OBJECT_UNLOCK (self);
       break;
+    case PROP_ASYNC:
+      gst_element_get_state (GST_ELEMENT (self), &actual_state, NULL,
+          GST_SECOND);
+      GST_OBJECT_LOCK (self);
+      if (actual_state <= GST_STATE_READY) {
+        priv->async = g_value_get_boolean (value);
+      } else {
+        GST_ERROR_OBJECT (self,
+            "Async mode can only be set in the NULL or READY states");
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_SIZE:
+      gst_element_get_state (GST_ELEMENT (self), &actual_state, NULL,
+          GST_SECOND);
+      GST_OBJECT_LOCK (self);
+      if (actual_state <= GST_STATE_READY) {
+        priv->queue_size = g_value_get_uint (value);
+      } else {
+        GST_ERROR_OBJECT (self,
+            "Queue size can only be set in the NULL or READY states");
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INFERENCE_INTERVAL:
+      GST_OBJECT_LOCK (self);
+      priv->inference_interval = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_BATCH_SIZE:
+      gst_element_get_state (GST_ELEMENT (self), &actual_state, NULL,
+          GST_SECOND);
+      GST_OBJECT_LOCK (self);
+      if (actual_state <= GST_STATE_READY) {
+        priv->batch_size = g_value_get_uint (value);
+      } else {
+        GST_ERROR_OBJECT (self,
+            "Batch size can only be set in the NULL or READY states");
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_BATCH_TIMEOUT:
+      gst_element_get_state (GST_ELEMENT (self), &actual_state, NULL,
+          GST_SECOND);
+      GST_OBJECT_LOCK (self);
+      if (actual_state <= GST_STATE_READY) {
+        priv->batch_timeout = g_value_get_uint (value);
+      } else {
+        GST_ERROR_OBJECT (self,
+            "Batch timeout can only be set in the NULL or READY states");
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_NUM_WORKERS:
+      gst_element_get_state (GST_ELEMENT (self), &actual_state, NULL,
+          GST_SECOND);
+      GST_OBJECT_LOCK (self);
+      if (actual_state <= GST_STATE_READY) {
+        priv->num_workers = g_value_get_uint (value);
+      } else {
+        GST_ERROR_OBJECT (self,
+            "Number of workers can only be set in the NULL or READY states");
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_WORKER_DISPATCH:
+      gst_element_get_state (GST_ELEMENT (self), &actual_state, NULL,
+          GST_SECOND);
+      GST_OBJECT_LOCK (self);
+      if (actual_state <= GST_STATE_READY) {
+        priv->worker_dispatch = g_value_get_enum (value);
+      } else {
+        GST_ERROR_OBJECT (self,
+            "Worker dispatch can only be set in the NULL or READY states");
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_ROI:
+      gst_element_get_state (GST_ELEMENT (self), &actual_state, NULL,
+          GST_SECOND);
+      GST_OBJECT_LOCK (self);
+      if (actual_state <= GST_STATE_READY) {
+        priv->roi = g_value_get_boolean (value);
+      } else {
+        GST_ERROR_OBJECT (self,
+            "ROI mode can only be set in the NULL or READY states");
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_LETTERBOX:
+      gst_element_get_state (GST_ELEMENT (self), &actual_state, NULL,
+          GST_SECOND);
+      GST_OBJECT_LOCK (self);
+      if (actual_state <= GST_STATE_READY) {
+        priv->letterbox = g_value_get_boolean (value);
+      } else {
+        GST_ERROR_OBJECT (self,
+            "Letterbox can only be set in the NULL or READY states");
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -304,6 +829,35 @@ gst_video_inference_get_property (GObject * object,
     case PROP_MODEL_LOCATION:
       g_value_set_string (value, priv->model_location);
       break;
+    case PROP_ASYNC:
+      g_value_set_boolean (value, priv->async);
+      break;
+    case PROP_QUEUE_SIZE:
+      g_value_set_uint (value, priv->queue_size);
+      break;
+    case PROP_INFERENCE_INTERVAL:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, priv->inference_interval);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint (value, priv->batch_size);
+      break;
+    case PROP_BATCH_TIMEOUT:
+      g_value_set_uint (value, priv->batch_timeout);
+      break;
+    case PROP_NUM_WORKERS:
+      g_value_set_uint (value, priv->num_workers);
+      break;
+    case PROP_WORKER_DISPATCH:
+      g_value_set_enum (value, priv->worker_dispatch);
+      break;
+    case PROP_ROI:
+      g_value_set_boolean (value, priv->roi);
+      break;
+    case PROP_LETTERBOX:
+      g_value_set_boolean (value, priv->letterbox);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -357,6 +911,47 @@ gst_video_inference_get_children_count (GstChildProxy * parent)
   return 1;
 }
 
+static gboolean
+gst_video_inference_negotiate_tensor_type (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv)
+{
+  /* Narrowest first, it takes the least memory per frame */
+  static const GstInferenceTensorType types[] = {
+    GST_INFERENCE_TENSOR_TYPE_UINT8,
+    GST_INFERENCE_TENSOR_TYPE_INT8,
+    GST_INFERENCE_TENSOR_TYPE_FLOAT16,
+    GST_INFERENCE_TENSOR_TYPE_FLOAT32,
+  };
+  guint i;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (klass, FALSE);
+  g_return_val_if_fail (priv, FALSE);
+
+  for (i = 0; i < G_N_ELEMENTS (types); ++i) {
+    if (0 == (klass->tensor_types & (1 << types[i]))
+        || !gst_backend_supports_tensor_type (priv->backend, types[i])) {
+      continue;
+    }
+
+    if (gst_inference_tensor_type_size (types[i]) == 1
+        && klass->tensor_scale <= 0) {
+      GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS,
+          ("The quantization scale of the model must be positive"), (NULL));
+      return FALSE;
+    }
+
+    GST_INFO_OBJECT (self, "Using tensors of type %d", types[i]);
+    priv->tensor_type = types[i];
+    return TRUE;
+  }
+
+  GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS,
+      ("The selected backend does not take tensors of any type the model "
+          "takes"), (NULL));
+  return FALSE;
+}
+
 static gboolean
 gst_video_inference_start (GstVideoInference * self)
 {
@@ -373,12 +968,52 @@ gst_video_inference_start (GstVideoInference * self)
     goto out;
   }
 
+  /* Results are attached per box, only metas with a box index can be */
+  if (priv->roi && (NULL == klass->inference_meta_info
+          || (GST_CLASSIFICATION_META_API_TYPE !=
+              klass->inference_meta_info->api
+              && GST_EMBEDDING_META_API_TYPE !=
+              klass->inference_meta_info->api))) {
+    GST_ELEMENT_ERROR (self, CORE, NOT_IMPLEMENTED,
+        ("ROI mode is only supported by classification and embedding "
+            "models"), (NULL));
+    ret = FALSE;
+    goto out;
+  }
+
+  if (!gst_backend_supports_tensor_layout (priv->backend,
+          klass->tensor_layout)) {
+    GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS,
+        ("The selected backend does not take tensors in the layout of the "
+            "model"), (NULL));
+    ret = FALSE;
+    goto out;
+  }
+
+  if (!gst_video_inference_negotiate_tensor_type (self, klass, priv)) {
+    ret = FALSE;
+    goto out;
+  }
+
+  if (!gst_backend_set_engines (priv->backend, priv->num_workers,
+          priv->worker_dispatch)) {
+    GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS,
+        ("Could not set %u engines on the selected backend",
+            priv->num_workers), (NULL));
+    ret = FALSE;
+    goto out;
+  }
+
   if (!gst_backend_start (priv->backend, priv->model_location, &err)) {
     GST_ELEMENT_ERROR (self, LIBRARY, INIT,
         ("Could not start the selected backend: (%s)", err->message), (NULL));
     ret = FALSE;
+    goto out;
   }
 
+  priv->model_width = klass->model_width;
+  priv->model_height = klass->model_height;
+
   if (klass->start != NULL) {
     ret = klass->start (self);
   }
@@ -389,6 +1024,24 @@ out:
   return ret;
 }
 
+void
+gst_video_inference_set_model_size (GstVideoInference * self, gint width,
+    gint height)
+{
+  GstVideoInferencePrivate *priv;
+
+  g_return_if_fail (self);
+  g_return_if_fail (width >= 0);
+  g_return_if_fail (height >= 0);
+
+  priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+
+  GST_INFO_OBJECT (self, "Model input size set to %dx%d", width, height);
+
+  priv->model_width = width;
+  priv->model_height = height;
+}
+
 static gboolean
 gst_video_inference_stop (GstVideoInference * self)
 {
@@ -422,16 +1075,43 @@ gst_video_inference_change_state (GstElement * element,
 
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      priv->async_ret = GST_FLOW_OK;
+      /* The timeout thread only hands batches to the predict stage, it
+       * never pushes downstream itself
+       */
+      priv->async_enabled = priv->async || priv->num_workers > 1
+          || (priv->batch_size > 1 && 0 != priv->batch_timeout);
+
       if (FALSE == gst_video_inference_start (self)) {
         GST_ERROR_OBJECT (self, "Subclass failed to start");
         ret = GST_STATE_CHANGE_FAILURE;
         goto out;
       }
 
+      if (priv->async_enabled
+          && !gst_video_inference_async_start (self, priv)) {
+        GST_ERROR_OBJECT (self, "Failed to start the async stages");
+        gst_video_inference_stop (self);
+        ret = GST_STATE_CHANGE_FAILURE;
+        goto out;
+      }
+
+      if (!gst_video_inference_batch_start (self, priv)) {
+        GST_ERROR_OBJECT (self, "Failed to start the batch timeout");
+        gst_video_inference_async_stop (self, priv);
+        gst_video_inference_async_join (self, priv);
+        gst_video_inference_stop (self);
+        ret = GST_STATE_CHANGE_FAILURE;
+        goto out;
+      }
+
+      gst_video_inference_reset_streams (self, priv);
       gst_collect_pads_start (priv->cpads);
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       gst_collect_pads_stop (priv->cpads);
+      gst_video_inference_async_stop (self, priv);
+      gst_video_inference_batch_stop (self, priv);
       break;
     default:
       break;
@@ -447,6 +1127,11 @@ gst_video_inference_change_state (GstElement * element,
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* Pads are inactive now, so stages blocked downstream are released */
+      gst_video_inference_async_join (self, priv);
+      gst_video_inference_batch_join (self, priv);
+      gst_video_inference_reset_streams (self, priv);
+
       if (FALSE == gst_video_inference_stop (self)) {
         GST_ERROR_OBJECT (self, "Subclass failed to stop");
         ret = GST_STATE_CHANGE_FAILURE;
@@ -463,7 +1148,8 @@ out:
 
 static GstPad *
 gst_video_inference_create_pad (GstVideoInference * self,
-    GstPadTemplate * templ, const gchar * name, GstVideoInferencePad ** data)
+    GstPadTemplate * templ, const gchar * name,
+    GstVideoInferenceStream * stream, GstVideoInferencePad ** data)
 {
   GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
   GstElement *element = GST_ELEMENT (self);
@@ -482,6 +1168,7 @@ gst_video_inference_create_pad (GstVideoInference * self,
       GST_ERROR_OBJECT (self, "Unable to add pad %s to collect pads", name);
       goto free_pad;
     }
+    (*data)->stream = stream;
   } else {
     gst_pad_set_event_function (pad, gst_video_inference_src_event);
   }
@@ -514,36 +1201,105 @@ gst_video_inference_request_new_pad (GstElement * element,
 {
   GstVideoInference *self = GST_VIDEO_INFERENCE (element);
   GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+  GstVideoInferenceStream *stream;
   const gchar *tname;
+  const gchar *prefix;
+  gchar *end = NULL;
+  gchar *pad_name = NULL;
   GstPad **pad;
+  GstPad *ret = NULL;
   GstVideoInferencePad **data;
+  GList *iter;
+  glong offset;
+  guint index = 0;
+  gboolean indexed;
 
   tname = GST_PAD_TEMPLATE_NAME_TEMPLATE (templ);
+  indexed = g_str_has_suffix (tname, "_%u");
+
+  /* Indexed pads without a name go to a new stream */
+  if (indexed && NULL != name) {
+    guint64 parsed = 0;
+
+    prefix = strrchr (name, '_');
+    if (NULL != prefix && g_ascii_isdigit (prefix[1])) {
+      parsed = g_ascii_strtoull (prefix + 1, &end, 10);
+    }
+    if (NULL == end || '\0' != *end || parsed > G_MAXUINT) {
+      GST_ERROR_OBJECT (self, "Invalid pad name %s", name);
+      return NULL;
+    }
+    index = parsed;
+  }
+
+  if (g_str_has_prefix (tname, "sink_bypass")) {
+    offset = G_STRUCT_OFFSET (GstVideoInferenceStream, sink_bypass);
+  } else if (g_str_has_prefix (tname, "sink_model")) {
+    offset = G_STRUCT_OFFSET (GstVideoInferenceStream, sink_model);
+  } else if (g_str_has_prefix (tname, "src_bypass")) {
+    offset = G_STRUCT_OFFSET (GstVideoInferenceStream, src_bypass);
+  } else {
+    offset = G_STRUCT_OFFSET (GstVideoInferenceStream, src_model);
+  }
+
+  GST_OBJECT_LOCK (self);
+
+  /* Pick the first stream missing this pad, or a new one */
+  if (indexed && NULL == name) {
+    for (iter = priv->streams; iter; iter = iter->next) {
+      stream = (GstVideoInferenceStream *) iter->data;
+      index = stream->index + 1;
+      if (NULL == G_STRUCT_MEMBER (GstPad *, stream, offset)) {
+        index = stream->index;
+        break;
+      }
+    }
+  }
+
+  stream = gst_video_inference_get_stream (self, priv, index, TRUE);
 
-  if (0 == g_strcmp0 (tname, "sink_bypass")) {
-    pad = &priv->sink_bypass;
-    data = &priv->sink_bypass_data;
-  } else if (0 == g_strcmp0 (tname, "sink_model")) {
-    pad = &priv->sink_model;
-    data = &priv->sink_model_data;
-  } else if (0 == g_strcmp0 (tname, "src_bypass")) {
-    pad = &priv->src_bypass;
+  if (g_str_has_prefix (tname, "sink_bypass")) {
+    pad = &stream->sink_bypass;
+    data = &stream->sink_bypass_data;
+  } else if (g_str_has_prefix (tname, "sink_model")) {
+    pad = &stream->sink_model;
+    data = &stream->sink_model_data;
+  } else if (g_str_has_prefix (tname, "src_bypass")) {
+    pad = &stream->src_bypass;
     data = NULL;
-  } else if (0 == g_strcmp0 (tname, "src_model")) {
-    pad = &priv->src_model;
+  } else if (g_str_has_prefix (tname, "src_model")) {
+    pad = &stream->src_model;
     data = NULL;
   } else {
+    GST_OBJECT_UNLOCK (self);
     g_return_val_if_reached (NULL);
   }
 
-  if (NULL == *pad) {
-    *pad = gst_video_inference_create_pad (self, templ, name, data);
-  } else {
+  if (NULL != *pad) {
+    GST_OBJECT_UNLOCK (self);
     GST_ERROR_OBJECT (self, "Pad %s already exists", name);
     return NULL;
   }
 
-  return *pad;
+  /* Keep the stream until the pad is added */
+  video_inference_stream_ref (stream);
+  GST_OBJECT_UNLOCK (self);
+
+  if (indexed) {
+    pad_name = g_strdup_printf (tname, index);
+    name = pad_name;
+  }
+
+  ret = gst_video_inference_create_pad (self, templ, name, stream, data);
+
+  GST_OBJECT_LOCK (self);
+  *pad = ret;
+  GST_OBJECT_UNLOCK (self);
+
+  video_inference_stream_unref (stream);
+  g_free (pad_name);
+
+  return ret;
 }
 
 static void
@@ -551,33 +1307,47 @@ gst_video_inference_release_pad (GstElement * element, GstPad * pad)
 {
   GstVideoInference *self = GST_VIDEO_INFERENCE (element);
   GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
-  GstPad **ourpad;
-  GstVideoInferencePad **data;
+  GstVideoInferenceStream *stream;
+  GstPad *ourpad = NULL;
 
   GST_INFO_OBJECT (self, "Removing %" GST_PTR_FORMAT, pad);
 
-  if (pad == priv->sink_bypass) {
-    ourpad = &priv->sink_bypass;
-    data = &priv->sink_bypass_data;
-  } else if (pad == priv->src_bypass) {
-    ourpad = &priv->src_bypass;
-    data = NULL;
-  } else if (pad == priv->sink_model) {
-    ourpad = &priv->sink_model;
-    data = &priv->sink_model_data;
-  } else if (pad == priv->src_model) {
-    ourpad = &priv->src_model;
-    data = NULL;
-  } else {
+  GST_OBJECT_LOCK (self);
+  stream = gst_video_inference_find_stream (self, priv, pad);
+  if (NULL == stream) {
+    GST_OBJECT_UNLOCK (self);
     g_return_if_reached ();
   }
 
-  if (GST_PAD_IS_SINK (pad)) {
-    *data = NULL;
-    gst_collect_pads_remove_pad (priv->cpads, pad);
+  if (pad == stream->sink_bypass) {
+    stream->sink_bypass_data = NULL;
+    ourpad = stream->sink_bypass;
+    stream->sink_bypass = NULL;
+  } else if (pad == stream->src_bypass) {
+    ourpad = stream->src_bypass;
+    stream->src_bypass = NULL;
+  } else if (pad == stream->sink_model) {
+    stream->sink_model_data = NULL;
+    ourpad = stream->sink_model;
+    stream->sink_model = NULL;
+  } else if (pad == stream->src_model) {
+    ourpad = stream->src_model;
+    stream->src_model = NULL;
   }
 
-  g_clear_object (ourpad);
+  /* The last pad is gone, frames in flight may still hold the stream */
+  if (NULL == stream->sink_bypass && NULL == stream->src_bypass &&
+      NULL == stream->sink_model && NULL == stream->src_model) {
+    priv->streams = g_list_remove (priv->streams, stream);
+    video_inference_stream_unref (stream);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (GST_PAD_IS_SINK (pad)) {
+    gst_collect_pads_remove_pad (priv->cpads, pad);
+  }
+
+  g_clear_object (&ourpad);
 }
 
 static GstFlowReturn
@@ -617,36 +1387,216 @@ gst_video_inference_forward_buffer (GstVideoInference * self,
 }
 
 static void
-video_inference_map_buffers (GstVideoInferencePad * cpad, GstBuffer * inbuf,
-    GstVideoFrame * inframe, GstVideoFrame * outframe)
+video_inference_tensor_rect (GstVideoInfo * info, GstVideoInfo * tensor_info,
+    gboolean letterbox, GstVideoRectangle * rect)
 {
-  GstVideoInfo *info;
-  GstAllocationParams params;
-  GstBuffer *outbuf;
+  gint64 width, height, tensor_width, tensor_height;
+
+  g_return_if_fail (info);
+  g_return_if_fail (tensor_info);
+  g_return_if_fail (rect);
+
+  width = GST_VIDEO_INFO_WIDTH (info);
+  height = GST_VIDEO_INFO_HEIGHT (info);
+  tensor_width = GST_VIDEO_INFO_WIDTH (tensor_info);
+  tensor_height = GST_VIDEO_INFO_HEIGHT (tensor_info);
+
+  rect->x = 0;
+  rect->y = 0;
+  rect->w = tensor_width;
+  rect->h = tensor_height;
+
+  if (!letterbox || 0 == width || 0 == height) {
+    return;
+  }
+
+  /* Fit the frame on the side that limits the scale, center the other */
+  if (width * tensor_height > height * tensor_width) {
+    rect->h = MAX (height * tensor_width / width, 1);
+  } else {
+    rect->w = MAX (width * tensor_height / height, 1);
+  }
+  rect->x = (tensor_width - rect->w) / 2;
+  rect->y = (tensor_height - rect->h) / 2;
+}
+
+static void
+video_inference_tensor_crop (GstVideoFrame * tensor, GstVideoRectangle * rect)
+{
+  GstVideoCropMeta *crop;
+
+  g_return_if_fail (tensor);
+  g_return_if_fail (rect);
+
+  /* The preprocess scales into the crop region and pads the rest */
+  if (rect->w == GST_VIDEO_FRAME_WIDTH (tensor)
+      && rect->h == GST_VIDEO_FRAME_HEIGHT (tensor)) {
+    return;
+  }
+
+  crop = gst_buffer_add_video_crop_meta (tensor->buffer);
+  crop->x = rect->x;
+  crop->y = rect->y;
+  crop->width = rect->w;
+  crop->height = rect->h;
+}
+
+static void
+video_inference_meta_to_frame (GstMeta * meta, GstVideoRectangle * rect,
+    GstVideoInfo * info)
+{
+  GstDetectionMeta *detection;
+  gdouble hfactor, vfactor;
+  gint i;
+
+  g_return_if_fail (meta);
+  g_return_if_fail (rect);
+  g_return_if_fail (info);
+
+  /* Only detections carry coordinates, they are relative to the tensor */
+  if (meta->info->api != GST_DETECTION_META_API_TYPE) {
+    return;
+  }
+
+  if (0 == rect->x && 0 == rect->y && GST_VIDEO_INFO_WIDTH (info) == rect->w
+      && GST_VIDEO_INFO_HEIGHT (info) == rect->h) {
+    return;
+  }
+
+  detection = (GstDetectionMeta *) meta;
+  hfactor = GST_VIDEO_INFO_WIDTH (info) * 1.0 / rect->w;
+  vfactor = GST_VIDEO_INFO_HEIGHT (info) * 1.0 / rect->h;
+
+  for (i = 0; i < detection->num_boxes; ++i) {
+    detection->boxes[i].x = (detection->boxes[i].x - rect->x) * hfactor;
+    detection->boxes[i].y = (detection->boxes[i].y - rect->y) * vfactor;
+    detection->boxes[i].width = detection->boxes[i].width * hfactor;
+    detection->boxes[i].height = detection->boxes[i].height * vfactor;
+  }
+}
+
+static gboolean
+gst_video_inference_tensor_pool_configure (GstVideoInference * self,
+    GstVideoInferenceStream * stream, GstVideoInfo * info)
+{
+  GstVideoInferenceClass *klass = GST_VIDEO_INFERENCE_GET_CLASS (self);
+  GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+  GstVideoInfo *tensor_info;
+  GstStructure *config;
+  gint width, height;
   gsize size;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (stream, FALSE);
+  g_return_val_if_fail (info, FALSE);
+
+  video_inference_tensor_pool_clear (stream);
+
+  /* Buffers of any size are scaled to the model one while preprocessing */
+  width = priv->model_width > 0 ? priv->model_width :
+      GST_VIDEO_INFO_WIDTH (info);
+  height = priv->model_height > 0 ? priv->model_height :
+      GST_VIDEO_INFO_HEIGHT (info);
+
+  tensor_info = &stream->tensor_info;
+  gst_video_info_init (tensor_info);
+  gst_video_info_set_format (tensor_info, GST_VIDEO_INFO_FORMAT (info), width,
+      height);
+
+  /* One element per model channel, regardless of the input pixel stride.
+   * The tensor is mapped with the tensor info, so it must fit it as well.
+   */
+  size = (gsize) width * height * klass->model_channels *
+      gst_inference_tensor_type_size (priv->tensor_type);
+  size = MAX (size, GST_VIDEO_INFO_SIZE (tensor_info));
+
+  GST_INFO_OBJECT (self, "Configuring %dx%d tensor pool with %" G_GSIZE_FORMAT
+      " bytes buffers", width, height, size);
+
+  stream->tensor_pool = gst_buffer_pool_new ();
+
+  /* No maximum, the async stages may hold several buffers at once */
+  config = gst_buffer_pool_get_config (stream->tensor_pool);
+  gst_buffer_pool_config_set_params (config, NULL, size, MIN_TENSOR_BUFFERS,
+      0);
+
+  if (!gst_buffer_pool_set_config (stream->tensor_pool, config)) {
+    GST_ERROR_OBJECT (self, "Unable to configure tensor pool");
+    goto error;
+  }
+
+  if (!gst_buffer_pool_set_active (stream->tensor_pool, TRUE)) {
+    GST_ERROR_OBJECT (self, "Unable to activate tensor pool");
+    goto error;
+  }
+
+  return TRUE;
+
+error:
+  gst_object_unref (stream->tensor_pool);
+  stream->tensor_pool = NULL;
+  return FALSE;
+}
+
+static void
+video_inference_tensor_pool_clear (GstVideoInferenceStream * stream)
+{
+  g_return_if_fail (stream);
+
+  if (NULL == stream->tensor_pool) {
+    return;
+  }
+
+  /* Buffers still in flight are freed when they return to the pool */
+  gst_buffer_pool_set_active (stream->tensor_pool, FALSE);
+  gst_object_unref (stream->tensor_pool);
+  stream->tensor_pool = NULL;
+}
+
+static gboolean
+video_inference_map_buffers (GstVideoInferencePad * cpad, GstBufferPool * pool,
+    GstBuffer * inbuf, GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  GstVideoInfo *info;
+  GstBuffer *outbuf = NULL;
   GstMapFlags inflags;
   GstMapFlags outflags;
 
-  g_return_if_fail (cpad);
-  g_return_if_fail (inbuf);
-  g_return_if_fail (inframe);
-  g_return_if_fail (outframe);
+  g_return_val_if_fail (cpad, FALSE);
+  g_return_val_if_fail (inbuf, FALSE);
+  g_return_val_if_fail (inframe, FALSE);
+  g_return_val_if_fail (outframe, FALSE);
 
   info = &(cpad->info);
 
-  /* Allocate an output buffer for the pre-processed data */
-  gst_allocation_params_init (&params);
-  size = gst_buffer_get_size (inbuf);
-  outbuf = gst_buffer_new_allocate (NULL, size * sizeof (float), &params);
+  /* Take an output buffer for the pre-processed data from the pool */
+  if (NULL == pool
+      || GST_FLOW_OK != gst_buffer_pool_acquire_buffer (pool, &outbuf, NULL)) {
+    return FALSE;
+  }
 
   /* Map buffers into their respective output frames but dont increase
-   * the refcount so we can add metas later on.
+   * the refcount so we can add metas later on. The input strides and
+   * plane offsets come from its GstVideoMeta if upstream padded it.
    */
   inflags = (GstMapFlags) (GST_MAP_READ | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
-  gst_video_frame_map (inframe, info, inbuf, inflags);
+  if (!gst_video_frame_map (inframe, info, inbuf, inflags)) {
+    GST_ERROR ("Unable to map the input frame, its layout does not fit "
+        "the buffer");
+    gst_buffer_unref (outbuf);
+    return FALSE;
+  }
 
   outflags = (GstMapFlags) (GST_MAP_WRITE | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
-  gst_video_frame_map (outframe, info, outbuf, outflags);
+  if (!gst_video_frame_map (outframe, &cpad->stream->tensor_info, outbuf,
+          outflags)) {
+    GST_ERROR ("Unable to map the preprocessed buffer");
+    gst_video_frame_unmap (inframe);
+    gst_buffer_unref (outbuf);
+    return FALSE;
+  }
+
+  return TRUE;
 }
 
 static gboolean
@@ -654,6 +1604,9 @@ gst_video_inference_preprocess (GstVideoInference * self,
     GstVideoInferenceClass * klass, GstVideoFrame * inframe,
     GstVideoFrame * outframe)
 {
+  GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+  GstInferenceTensorMeta *tensor_meta;
+
   g_return_val_if_fail (self, FALSE);
   g_return_val_if_fail (klass, FALSE);
   g_return_val_if_fail (inframe, FALSE);
@@ -665,6 +1618,17 @@ gst_video_inference_preprocess (GstVideoInference * self,
     return FALSE;
   }
 
+  /* Tells the preprocess functions the layout and type to write */
+  if (DEFAULT_TENSOR_LAYOUT != klass->tensor_layout
+      || DEFAULT_TENSOR_TYPE != priv->tensor_type) {
+    tensor_meta = (GstInferenceTensorMeta *) gst_buffer_add_meta
+        (outframe->buffer, GST_INFERENCE_TENSOR_META_INFO, NULL);
+    tensor_meta->layout = klass->tensor_layout;
+    tensor_meta->type = priv->tensor_type;
+    tensor_meta->scale = klass->tensor_scale;
+    tensor_meta->zero_point = klass->tensor_zero_point;
+  }
+
   GST_LOG_OBJECT (self, "Calling frame preprocess");
 
   if (!klass->preprocess (self, inframe, outframe)) {
@@ -673,345 +1637,1869 @@ gst_video_inference_preprocess (GstVideoInference * self,
     return FALSE;
   }
 
-  return TRUE;
+  return TRUE;
+}
+
+static gboolean
+gst_video_inference_predict (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoFrame ** frames,
+    guint num_frames, GBytes ** preds)
+{
+  GError *error = NULL;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (priv, FALSE);
+  g_return_val_if_fail (frames, FALSE);
+  g_return_val_if_fail (preds, FALSE);
+
+  GST_LOG_OBJECT (self, "Running prediction on %u frames", num_frames);
+
+  if (!gst_backend_process_frames (priv->backend, frames, num_frames, preds,
+          &error)) {
+    GST_ELEMENT_ERROR (self, STREAM, FAILED,
+        ("Could not process using the selected backend: (%s)", error->message),
+        (NULL));
+    g_error_free (error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_video_inference_postprocess_rois (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame, GstVideoInfo * info_bypass)
+{
+  GstVideoInferenceRoi *roi;
+  gconstpointer prediction_data;
+  gsize prediction_size;
+  guint i;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (klass, FALSE);
+  g_return_val_if_fail (priv, FALSE);
+  g_return_val_if_fail (frame, FALSE);
+
+  /* Per box results are not carried over, boxes change between frames */
+  video_inference_store_meta (priv, frame->stream, NULL, NULL, NULL);
+
+  for (i = 0; i < frame->rois->len; ++i) {
+    roi = &g_array_index (frame->rois, GstVideoInferenceRoi, i);
+    if (NULL == roi->prediction) {
+      continue;
+    }
+
+    prediction_data = g_bytes_get_data (roi->prediction, &prediction_size);
+
+    if (!gst_video_inference_postprocess (self, klass, priv, frame->stream,
+            (const gpointer) prediction_data, prediction_size,
+            frame->buffer_model, &frame->info_model, frame->buffer_bypass,
+            info_bypass, roi->box_index, NULL)) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+static GstVideoInferenceFrame *
+gst_video_inference_frame_new (GstVideoInference * self,
+    GstVideoInferenceStream * stream, GstBuffer * buffer_model,
+    GstBuffer * buffer_bypass)
+{
+  GstVideoInferenceFrame *frame;
+
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (stream, NULL);
+
+  frame = g_slice_new0 (GstVideoInferenceFrame);
+
+  frame->buffer_model = buffer_model;
+  frame->buffer_bypass = buffer_bypass;
+  frame->stream = video_inference_stream_ref (stream);
+
+  /* Keep a copy of the negotiated info, caps may change while the frame
+   * is still being processed by the async stages
+   */
+  if (stream->sink_model_data) {
+    frame->info_model = stream->sink_model_data->info;
+  }
+
+  if (stream->sink_bypass_data) {
+    frame->info_bypass = stream->sink_bypass_data->info;
+    frame->has_info_bypass = TRUE;
+  }
+
+  return frame;
+}
+
+static void
+video_inference_tensor_unmap (GstVideoInferenceFrame * frame)
+{
+  GstVideoInferenceRoi *roi;
+  GstBuffer *tensor;
+  guint i;
+
+  for (i = 0; frame->rois && i < frame->rois->len; ++i) {
+    roi = &g_array_index (frame->rois, GstVideoInferenceRoi, i);
+    if (roi->tensor_mapped) {
+      tensor = roi->tensor.buffer;
+      gst_video_frame_unmap (&roi->tensor);
+      gst_buffer_unref (tensor);
+      roi->tensor_mapped = FALSE;
+    }
+  }
+
+  if (!frame->tensor_mapped) {
+    return;
+  }
+
+  tensor = frame->tensor.buffer;
+  gst_video_frame_unmap (&frame->tensor);
+  gst_buffer_unref (tensor);
+  frame->tensor_mapped = FALSE;
+}
+
+static void
+video_inference_roi_clear (GstVideoInferenceRoi * roi)
+{
+  GstBuffer *tensor;
+
+  if (roi->tensor_mapped) {
+    tensor = roi->tensor.buffer;
+    gst_video_frame_unmap (&roi->tensor);
+    gst_buffer_unref (tensor);
+    roi->tensor_mapped = FALSE;
+  }
+
+  if (NULL != roi->prediction) {
+    g_bytes_unref (roi->prediction);
+    roi->prediction = NULL;
+  }
+}
+
+static guint
+video_inference_frame_num_tensors (GstVideoInferenceFrame * frame)
+{
+  guint num_tensors = frame->tensor_mapped ? 1 : 0;
+  guint i;
+
+  for (i = 0; frame->rois && i < frame->rois->len; ++i) {
+    if (g_array_index (frame->rois, GstVideoInferenceRoi, i).tensor_mapped) {
+      num_tensors++;
+    }
+  }
+
+  return num_tensors;
+}
+
+static void
+gst_video_inference_frame_free (GstVideoInferenceFrame * frame)
+{
+  g_return_if_fail (frame);
+
+  video_inference_tensor_unmap (frame);
+  video_inference_buffer_unref (frame->buffer_model);
+  video_inference_buffer_unref (frame->buffer_bypass);
+  if (NULL != frame->prediction) {
+    g_bytes_unref (frame->prediction);
+  }
+  if (NULL != frame->rois) {
+    g_array_free (frame->rois, TRUE);
+  }
+  video_inference_stream_unref (frame->stream);
+
+  g_slice_free (GstVideoInferenceFrame, frame);
+}
+
+static gboolean
+gst_video_inference_frame_preprocess (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame)
+{
+  GstVideoFrame inframe;
+  gboolean ret;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (klass, FALSE);
+  g_return_val_if_fail (priv, FALSE);
+  g_return_val_if_fail (frame, FALSE);
+
+  /* Nothing to infer on */
+  if (NULL == frame->buffer_model || frame->skip) {
+    return TRUE;
+  }
+
+  if (priv->roi) {
+    return gst_video_inference_frame_preprocess_rois (self, klass, priv,
+        frame);
+  }
+
+  if (!video_inference_map_buffers (frame->stream->sink_model_data,
+          frame->stream->tensor_pool, frame->buffer_model, &inframe,
+          &frame->tensor)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT,
+        ("Unable to allocate and map the preprocessed buffer"), (NULL));
+    return FALSE;
+  }
+  frame->tensor_mapped = TRUE;
+
+  video_inference_tensor_rect (&frame->info_model, &frame->tensor.info,
+      priv->letterbox, &frame->tensor_rect);
+  video_inference_tensor_crop (&frame->tensor, &frame->tensor_rect);
+
+  ret = gst_video_inference_preprocess (self, klass, &inframe, &frame->tensor);
+
+  gst_video_frame_unmap (&inframe);
+
+  if (!ret) {
+    video_inference_tensor_unmap (frame);
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_video_inference_frame_preprocess_rois (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame)
+{
+  GstDetectionMeta *detection;
+  GstVideoInferenceRoi *roi;
+  GstBufferPool *pool;
+  GstVideoInfo *info;
+  GstVideoInfo *tensor_info;
+  GstVideoFrame inframe;
+  GstVideoFrame cropframe;
+  GstVideoRectangle rect;
+  GstBuffer *tensorbuf = NULL;
+  GstMapFlags flags;
+  gboolean ret = TRUE;
+  gint i;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (klass, FALSE);
+  g_return_val_if_fail (priv, FALSE);
+  g_return_val_if_fail (frame, FALSE);
+
+  frame->rois = g_array_new (FALSE, TRUE, sizeof (GstVideoInferenceRoi));
+  g_array_set_clear_func (frame->rois,
+      (GDestroyNotify) video_inference_roi_clear);
+
+  detection = (GstDetectionMeta *) gst_buffer_get_meta (frame->buffer_model,
+      GST_DETECTION_META_API_TYPE);
+  if (NULL == detection || 0 == detection->num_boxes) {
+    GST_LOG_OBJECT (self, "No boxes to infer on");
+    return TRUE;
+  }
+
+  pool = frame->stream->tensor_pool;
+  info = &frame->info_model;
+  tensor_info = &frame->stream->tensor_info;
+
+  if (NULL == pool) {
+    GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT,
+        ("Unable to allocate the preprocessed buffer"), (NULL));
+    return FALSE;
+  }
+
+  flags = (GstMapFlags) (GST_MAP_READ | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
+  if (!gst_video_frame_map (&inframe, info, frame->buffer_model, flags)) {
+    GST_ELEMENT_ERROR (self, STREAM, FAILED,
+        ("Unable to map the input frame, its layout does not fit the "
+            "buffer"), (NULL));
+    return FALSE;
+  }
+
+  GST_LOG_OBJECT (self, "Preprocessing %d boxes", detection->num_boxes);
+
+  /* Every box is cropped, scaled and normalized by the preprocess in a
+   * single pass over its region of the input
+   */
+  for (i = 0; i < detection->num_boxes; ++i) {
+    if (!video_inference_crop (&inframe, &detection->boxes[i], &cropframe)) {
+      GST_LOG_OBJECT (self, "Skipping box %d outside of the frame", i);
+      continue;
+    }
+
+    if (GST_FLOW_OK != gst_buffer_pool_acquire_buffer (pool, &tensorbuf,
+            NULL)) {
+      GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT,
+          ("Unable to allocate the preprocessed buffer"), (NULL));
+      ret = FALSE;
+      break;
+    }
+
+    g_array_set_size (frame->rois, frame->rois->len + 1);
+    roi = &g_array_index (frame->rois, GstVideoInferenceRoi,
+        frame->rois->len - 1);
+    roi->box_index = i;
+
+    flags = (GstMapFlags) (GST_MAP_WRITE | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
+    if (!gst_video_frame_map (&roi->tensor, tensor_info, tensorbuf, flags)) {
+      /* The box is dropped unmapped, clearing it releases nothing */
+      g_array_set_size (frame->rois, frame->rois->len - 1);
+      gst_buffer_unref (tensorbuf);
+      GST_ELEMENT_ERROR (self, RESOURCE, NO_SPACE_LEFT,
+          ("Unable to map the preprocessed buffer"), (NULL));
+      ret = FALSE;
+      break;
+    }
+    roi->tensor_mapped = TRUE;
+
+    video_inference_tensor_rect (&cropframe.info, tensor_info,
+        priv->letterbox, &rect);
+    video_inference_tensor_crop (&roi->tensor, &rect);
+
+    if (!gst_video_inference_preprocess (self, klass, &cropframe,
+            &roi->tensor)) {
+      ret = FALSE;
+      break;
+    }
+  }
+
+  gst_video_frame_unmap (&inframe);
+
+  return ret;
+}
+
+static gboolean
+video_inference_crop (GstVideoFrame * inframe, BBox * box,
+    GstVideoFrame * cropframe)
+{
+  const GstVideoFormatInfo *finfo;
+  gint x0, y0, x1, y1, c, p, wsub = 0, hsub = 0;
+
+  g_return_val_if_fail (inframe, FALSE);
+  g_return_val_if_fail (box, FALSE);
+  g_return_val_if_fail (cropframe, FALSE);
+
+  /* Boxes may extend beyond the frame borders */
+  x0 = MAX ((gint) box->x, 0);
+  y0 = MAX ((gint) box->y, 0);
+  x1 = MIN ((gint) (box->x + box->width), GST_VIDEO_FRAME_WIDTH (inframe));
+  y1 = MIN ((gint) (box->y + box->height), GST_VIDEO_FRAME_HEIGHT (inframe));
+
+  if (x1 <= x0 || y1 <= y0) {
+    return FALSE;
+  }
+
+  /* Subsampled chroma can only be offset by whole samples, so the crop
+   * starts on the first pixel of the chroma sample the box starts in
+   */
+  finfo = inframe->info.finfo;
+  for (c = 0; c < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); ++c) {
+    wsub = MAX (wsub, GST_VIDEO_FORMAT_INFO_W_SUB (finfo, c));
+    hsub = MAX (hsub, GST_VIDEO_FORMAT_INFO_H_SUB (finfo, c));
+  }
+  x0 &= ~((1 << wsub) - 1);
+  y0 &= ~((1 << hsub) - 1);
+
+  /* A view of the box in the input, the preprocess reads the rows
+   * through the plane pointers and strides. It is never unmapped.
+   */
+  *cropframe = *inframe;
+  GST_VIDEO_INFO_WIDTH (&cropframe->info) = x1 - x0;
+  GST_VIDEO_INFO_HEIGHT (&cropframe->info) = y1 - y0;
+  for (c = 0; c < GST_VIDEO_FORMAT_INFO_N_COMPONENTS (finfo); ++c) {
+    p = GST_VIDEO_FORMAT_INFO_PLANE (finfo, c);
+    cropframe->data[p] = (guint8 *) inframe->data[p] +
+        GST_VIDEO_SUB_SCALE (GST_VIDEO_FORMAT_INFO_H_SUB (finfo, c), y0) *
+        GST_VIDEO_FRAME_PLANE_STRIDE (inframe, p) +
+        GST_VIDEO_SUB_SCALE (GST_VIDEO_FORMAT_INFO_W_SUB (finfo, c), x0) *
+        GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, c);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_video_inference_batch_predict (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GPtrArray * frames)
+{
+  GstVideoInferenceFrame *frame;
+  GstVideoInferenceRoi *roi;
+  GstVideoFrame **tensors;
+  GBytes ***targets;
+  GBytes **predictions;
+  guint num_tensors = 0;
+  gboolean ret = TRUE;
+  guint i;
+  guint j;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (priv, FALSE);
+  g_return_val_if_fail (frames, FALSE);
+
+  /* Only frames that were preprocessed go to the backend, frames from
+   * flushing streams are going to be dropped anyway
+   */
+  for (i = 0; i < frames->len; ++i) {
+    frame = (GstVideoInferenceFrame *) g_ptr_array_index (frames, i);
+    if (video_inference_frame_num_tensors (frame) > 0
+        && video_inference_stream_is_flushing (priv, frame->stream)) {
+      video_inference_tensor_unmap (frame);
+    }
+    num_tensors += video_inference_frame_num_tensors (frame);
+  }
+
+  if (0 == num_tensors) {
+    return ret;
+  }
+
+  /* The boxes of every frame go to the backend in the same call */
+  tensors = g_new (GstVideoFrame *, num_tensors);
+  targets = g_new (GBytes **, num_tensors);
+  predictions = g_new (GBytes *, num_tensors);
+
+  num_tensors = 0;
+  for (i = 0; i < frames->len; ++i) {
+    frame = (GstVideoInferenceFrame *) g_ptr_array_index (frames, i);
+    if (frame->tensor_mapped) {
+      tensors[num_tensors] = &frame->tensor;
+      targets[num_tensors++] = &frame->prediction;
+    }
+
+    for (j = 0; frame->rois && j < frame->rois->len; ++j) {
+      roi = &g_array_index (frame->rois, GstVideoInferenceRoi, j);
+      if (roi->tensor_mapped) {
+        tensors[num_tensors] = &roi->tensor;
+        targets[num_tensors++] = &roi->prediction;
+      }
+    }
+  }
+
+  ret = gst_video_inference_predict (self, priv, tensors, num_tensors,
+      predictions);
+
+  for (i = 0; ret && i < num_tensors; ++i) {
+    *targets[i] = predictions[i];
+  }
+
+  /* The preprocessed data is not needed anymore */
+  for (i = 0; i < frames->len; ++i) {
+    video_inference_tensor_unmap ((GstVideoInferenceFrame *)
+        g_ptr_array_index (frames, i));
+  }
+
+  g_free (predictions);
+  g_free (targets);
+  g_free (tensors);
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_video_inference_frame_finish (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstVideoInferenceStream *stream;
+  GstVideoInfo *info_bypass;
+  GstPad *src_model = NULL;
+  GstPad *src_bypass = NULL;
+
+  g_return_val_if_fail (self, GST_FLOW_ERROR);
+  g_return_val_if_fail (klass, GST_FLOW_ERROR);
+  g_return_val_if_fail (priv, GST_FLOW_ERROR);
+  g_return_val_if_fail (frame, GST_FLOW_ERROR);
+
+  stream = frame->stream;
+
+  if (video_inference_stream_is_flushing (priv, stream)) {
+    GST_LOG_OBJECT (self, "Stream %u is flushing, dropping frame",
+        stream->index);
+    return GST_FLOW_FLUSHING;
+  }
+
+  info_bypass = frame->has_info_bypass ? &frame->info_bypass : NULL;
+
+  if (frame->skip) {
+    gst_video_inference_carry_over_meta (self, klass, priv, frame,
+        info_bypass);
+  } else if (frame->rois) {
+    if (!gst_video_inference_postprocess_rois (self, klass, priv, frame,
+            info_bypass)) {
+      return GST_FLOW_ERROR;
+    }
+  } else if (frame->buffer_model) {
+    /* Have the subclass analyze the prediction and generate model and
+     * bypass metas */
+    gsize prediction_size;
+    gconstpointer prediction_data =
+        g_bytes_get_data (frame->prediction, &prediction_size);
+
+    if (!gst_video_inference_postprocess (self, klass, priv, stream,
+            (const gpointer) prediction_data, prediction_size,
+            frame->buffer_model, &frame->info_model,
+            frame->buffer_bypass, info_bypass, -1, &frame->tensor_rect)) {
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  /* Pads may be released while the frame is in flight */
+  GST_OBJECT_LOCK (self);
+  if (stream->src_model) {
+    src_model = GST_PAD (gst_object_ref (stream->src_model));
+  }
+  if (stream->src_bypass) {
+    src_bypass = GST_PAD (gst_object_ref (stream->src_bypass));
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  /* Forward buffer to model src pad */
+  ret = gst_video_inference_forward_buffer (self, frame->buffer_model,
+      src_model);
+
+  /* We don't own this buffer anymore, don't free it */
+  frame->buffer_model = NULL;
+  if (GST_FLOW_OK != ret) {
+    goto out;
+  }
+
+  /* Forward buffer to bypass src pad */
+  ret = gst_video_inference_forward_buffer (self,
+      frame->buffer_bypass, src_bypass);
+
+  /* We don't own this buffer anymore, don't free it */
+  frame->buffer_bypass = NULL;
+
+out:
+  g_clear_object (&src_model);
+  g_clear_object (&src_bypass);
+
+  return ret;
+}
+
+static GstVideoInferenceStream *
+video_inference_stream_new (guint index)
+{
+  GstVideoInferenceStream *stream;
+
+  stream = g_slice_new0 (GstVideoInferenceStream);
+  stream->refcount = 1;
+  stream->index = index;
+  stream->ret = GST_FLOW_OK;
+
+  return stream;
+}
+
+static GstVideoInferenceStream *
+video_inference_stream_ref (GstVideoInferenceStream * stream)
+{
+  g_return_val_if_fail (stream, NULL);
+
+  g_atomic_int_inc (&stream->refcount);
+
+  return stream;
+}
+
+static void
+video_inference_stream_unref (GstVideoInferenceStream * stream)
+{
+  g_return_if_fail (stream);
+
+  if (!g_atomic_int_dec_and_test (&stream->refcount)) {
+    return;
+  }
+
+  g_clear_object (&stream->sink_bypass);
+  g_clear_object (&stream->src_bypass);
+  g_clear_object (&stream->sink_model);
+  g_clear_object (&stream->src_model);
+  video_inference_tensor_pool_clear (stream);
+  video_inference_buffer_unref (stream->last_meta_buffer);
+
+  g_slice_free (GstVideoInferenceStream, stream);
+}
+
+static void
+video_inference_stream_reset (GstVideoInferencePrivate * priv,
+    GstVideoInferenceStream * stream)
+{
+  g_return_if_fail (priv);
+  g_return_if_fail (stream);
+
+  /* Make sure the first buffer after a reset is inferred */
+  stream->frame_count = 0;
+  video_inference_store_meta (priv, stream, NULL, NULL, NULL);
+
+  g_mutex_lock (&priv->async_mutex);
+  stream->flushing = FALSE;
+  stream->ret = GST_FLOW_OK;
+  g_mutex_unlock (&priv->async_mutex);
+}
+
+static gboolean
+video_inference_stream_is_flushing (GstVideoInferencePrivate * priv,
+    GstVideoInferenceStream * stream)
+{
+  gboolean flushing;
+
+  g_mutex_lock (&priv->async_mutex);
+  flushing = stream->flushing;
+  g_mutex_unlock (&priv->async_mutex);
+
+  return flushing;
+}
+
+static GstVideoInferenceStream *
+gst_video_inference_get_stream (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, guint index, gboolean create)
+{
+  GstVideoInferenceStream *stream;
+  GList *iter;
+
+  /* Called with the object lock held */
+  for (iter = priv->streams; iter; iter = iter->next) {
+    stream = (GstVideoInferenceStream *) iter->data;
+
+    if (stream->index == index) {
+      return stream;
+    }
+
+    if (stream->index > index) {
+      break;
+    }
+  }
+
+  if (!create) {
+    return NULL;
+  }
+
+  GST_DEBUG_OBJECT (self, "Creating stream %u", index);
+
+  stream = video_inference_stream_new (index);
+  priv->streams = g_list_insert_before (priv->streams, iter, stream);
+
+  return stream;
+}
+
+static GstVideoInferenceStream *
+gst_video_inference_find_stream (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstPad * pad)
+{
+  GstVideoInferenceStream *stream;
+  GList *iter;
+
+  /* Called with the object lock held */
+  for (iter = priv->streams; iter; iter = iter->next) {
+    stream = (GstVideoInferenceStream *) iter->data;
+
+    if (pad == stream->sink_model || pad == stream->src_model ||
+        pad == stream->sink_bypass || pad == stream->src_bypass) {
+      return stream;
+    }
+  }
+
+  return NULL;
+}
+
+static GPtrArray *
+gst_video_inference_ref_streams (GstVideoInference * self,
+    GstVideoInferencePrivate * priv)
+{
+  GPtrArray *streams;
+  GList *iter;
+
+  streams = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      video_inference_stream_unref);
+
+  GST_OBJECT_LOCK (self);
+  for (iter = priv->streams; iter; iter = iter->next) {
+    g_ptr_array_add (streams, video_inference_stream_ref (iter->data));
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return streams;
+}
+
+static void
+gst_video_inference_reset_streams (GstVideoInference * self,
+    GstVideoInferencePrivate * priv)
+{
+  GstVideoInferenceStream *stream;
+  GPtrArray *streams;
+  guint i;
+
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
+
+  streams = gst_video_inference_ref_streams (self, priv);
+
+  for (i = 0; i < streams->len; ++i) {
+    stream = (GstVideoInferenceStream *) g_ptr_array_index (streams, i);
+    video_inference_stream_reset (priv, stream);
+    video_inference_tensor_pool_clear (stream);
+  }
+
+  g_ptr_array_unref (streams);
+}
+
+static void
+gst_video_inference_stream_set_flushing (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream,
+    gboolean flushing)
+{
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
+  g_return_if_fail (stream);
+
+  GST_DEBUG_OBJECT (self, "Setting stream %u flushing to %d", stream->index,
+      flushing);
+
+  /* Frames of a flushing stream are dropped as they go through the
+   * stages, so the queues drain without affecting other streams
+   */
+  if (flushing) {
+    g_mutex_lock (&priv->async_mutex);
+    stream->flushing = TRUE;
+    g_mutex_unlock (&priv->async_mutex);
+  } else {
+    video_inference_stream_reset (priv, stream);
+  }
+}
+
+static void
+video_inference_store_meta (GstVideoInferencePrivate * priv,
+    GstVideoInferenceStream * stream, GstBuffer * buffer_model,
+    GstVideoInfo * info_model, GstMeta * meta_model)
+{
+  GQuark copy_quark = g_quark_from_static_string ("gst-copy");
+
+  g_return_if_fail (priv);
+  g_return_if_fail (stream);
+
+  video_inference_buffer_unref (stream->last_meta_buffer);
+  stream->last_meta_buffer = NULL;
+
+  /* Nothing will be carried over, avoid the copy */
+  if (NULL == meta_model || priv->inference_interval <= 1) {
+    return;
+  }
+
+  stream->last_meta_buffer = gst_buffer_new ();
+  stream->last_meta_info = *info_model;
+
+  meta_model->info->transform_func (stream->last_meta_buffer, meta_model,
+      buffer_model, copy_quark, NULL);
+}
+
+static void
+gst_video_inference_carry_over_meta (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceFrame * frame, GstVideoInfo * info_bypass)
+{
+  GstMeta *meta;
+
+  g_return_if_fail (self);
+  g_return_if_fail (klass);
+  g_return_if_fail (priv);
+  g_return_if_fail (frame);
+
+  /* No valid prediction yet, forward the buffers untouched */
+  if (NULL == frame->stream->last_meta_buffer
+      || NULL == klass->inference_meta_info) {
+    return;
+  }
+
+  meta = gst_buffer_get_meta (frame->stream->last_meta_buffer,
+      klass->inference_meta_info->api);
+  if (NULL == meta) {
+    return;
+  }
+
+  GST_LOG_OBJECT (self, "Carrying over last prediction");
+
+  if (NULL != frame->buffer_model) {
+    video_inference_transform_meta (frame->stream->last_meta_buffer,
+        &frame->stream->last_meta_info, meta, frame->buffer_model,
+        &frame->info_model);
+  }
+
+  video_inference_transform_meta (frame->stream->last_meta_buffer,
+      &frame->stream->last_meta_info, meta, frame->buffer_bypass, info_bypass);
+}
+
+static gboolean
+video_inference_prepare_postprocess (const GstMetaInfo * meta_info,
+    GstBuffer * buffer, GstVideoInfo * video_info, GstVideoFrame * out_frame,
+    GstMeta ** out_meta)
+{
+  GstMapFlags flags;
+
+  g_return_val_if_fail (meta_info, FALSE);
+  g_return_val_if_fail (out_frame, FALSE);
+
+  /* No pad requested, continue without meta */
+  if (NULL == buffer || NULL == video_info) {
+    return TRUE;
+  }
+
+  if (out_meta) {
+    g_return_val_if_fail (gst_buffer_is_writable (buffer), FALSE);
+    *out_meta = gst_buffer_add_meta (buffer, meta_info, NULL);
+  }
+
+  flags = (GstMapFlags) (GST_MAP_READ | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
+  gst_video_frame_map (out_frame, video_info, buffer, flags);
+
+  return TRUE;
+}
+
+static void
+video_inference_frame_unmap (GstBuffer * buffer, GstVideoFrame * frame)
+{
+  g_return_if_fail (frame);
+
+  if (NULL != buffer) {
+    gst_video_frame_unmap (frame);
+  }
+}
+
+static void
+video_inference_remove_meta (GstBuffer * buffer, GstMeta * meta)
+{
+  if (NULL != buffer && NULL != meta) {
+    g_return_if_fail (gst_buffer_is_writable (buffer));
+    gst_buffer_remove_meta (buffer, meta);
+  }
+}
+
+static GstMeta *
+video_inference_transform_meta (GstBuffer * buffer_model,
+    GstVideoInfo * info_model, GstMeta * meta_model, GstBuffer * buffer_bypass,
+    GstVideoInfo * info_bypass)
+{
+  GstMeta *meta_bypass = NULL;
+  GstMeta *meta;
+  gpointer state = NULL;
+  const GstMetaInfo *info;
+  GQuark size_quark = g_quark_from_static_string (GST_META_TAG_VIDEO_SIZE_STR);
+  GQuark orientation_quark =
+      g_quark_from_static_string (GST_META_TAG_VIDEO_ORIENTATION_STR);
+  GQuark scale_quark = gst_video_meta_transform_scale_get_quark ();
+  GQuark copy_quark = g_quark_from_static_string ("gst-copy");
+
+  g_return_val_if_fail (buffer_model, NULL);
+  g_return_val_if_fail (info_model, NULL);
+  g_return_val_if_fail (meta_model, NULL);
+
+  if (NULL == info_bypass || NULL == buffer_bypass) {
+    return meta_bypass;
+  }
+
+  info = meta_model->info;
+
+  if (gst_meta_api_type_has_tag (info->api, size_quark) ||
+      gst_meta_api_type_has_tag (info->api, orientation_quark)) {
+    GstVideoMetaTransform trans = { info_model, info_bypass };
+
+    info->transform_func (buffer_bypass, meta_model, buffer_model,
+        scale_quark, &trans);
+  } else {
+    info->transform_func (buffer_bypass, meta_model, buffer_model,
+        copy_quark, NULL);
+  }
+  /* The transformed meta is appended, there may be others from previous
+   * boxes in ROI mode
+   */
+  while ((meta = gst_buffer_iterate_meta (buffer_bypass, &state))) {
+    if (meta->info->api == info->api) {
+      meta_bypass = meta;
+    }
+  }
+
+  return meta_bypass;
+}
+
+static gboolean
+gst_video_inference_postprocess (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GstVideoInferenceStream * stream, const gpointer prediction_data,
+    gsize prediction_size, GstBuffer * buffer_model,
+    GstVideoInfo * info_model, GstBuffer * buffer_bypass,
+    GstVideoInfo * info_bypass, gint box_index,
+    GstVideoRectangle * tensor_rect)
+{
+  GstMeta *meta_model = NULL;
+  GstMeta *meta_bypass = NULL;
+  GstVideoFrame frame_model;
+  GstVideoFrame frame_bypass;
+  gboolean pred_valid = FALSE;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (klass, FALSE);
+  g_return_val_if_fail (prediction_data, FALSE);
+  g_return_val_if_fail (prediction_size, FALSE);
+  g_return_val_if_fail (buffer_model, FALSE);
+  g_return_val_if_fail (info_model, FALSE);
+
+  /* Subclass didn't implement a post-process, dont fail, just ignore */
+  if (NULL == klass->postprocess) {
+    return TRUE;
+  }
+
+  if (!video_inference_prepare_postprocess (klass->inference_meta_info,
+          buffer_model, info_model, &frame_model, &meta_model)) {
+    return FALSE;
+  }
+
+  if (!video_inference_prepare_postprocess (klass->inference_meta_info,
+          buffer_bypass, info_bypass, &frame_bypass, NULL)) {
+    return FALSE;
+  }
+
+  GST_LOG_OBJECT (self, "Calling frame postprocess");
+  if (!klass->postprocess (self, prediction_data, prediction_size, meta_model,
+          info_model, &pred_valid)) {
+    GST_ELEMENT_ERROR (self, STREAM, FAILED, ("Subclass failed at preprocess"),
+        (NULL));
+    return FALSE;
+  }
+
+  if (pred_valid) {
+    GstVideoFrame *pbpass = buffer_bypass ? &frame_bypass : NULL;
+
+    /* ROI mode only allows metas compatible with classification */
+    if (box_index >= 0) {
+      ((GstClassificationMeta *) meta_model)->box_index = box_index;
+    }
+
+    if (tensor_rect) {
+      video_inference_meta_to_frame (meta_model, tensor_rect, info_model);
+    }
+
+    meta_bypass =
+        video_inference_transform_meta (buffer_model, info_model, meta_model,
+        buffer_bypass, info_bypass);
+    video_inference_store_meta (priv, stream, buffer_model, info_model,
+        box_index < 0 ? meta_model : NULL);
+    g_signal_emit (self, gst_video_inference_signals[NEW_PREDICTION_SIGNAL], 0,
+        meta_model, &frame_bypass, meta_bypass, pbpass);
+  } else {
+    video_inference_remove_meta (buffer_model, meta_model);
+    video_inference_remove_meta (buffer_bypass, meta_bypass);
+    video_inference_store_meta (priv, stream, buffer_model, info_model, NULL);
+  }
+
+  video_inference_frame_unmap (buffer_model, &frame_model);
+  video_inference_frame_unmap (buffer_bypass, &frame_bypass);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_video_inference_pop_buffer (GstVideoInference * self,
+    GstCollectPads * cpads, GstCollectData * data, GstBuffer ** buffer)
+{
+  g_return_val_if_fail (self, GST_FLOW_ERROR);
+  g_return_val_if_fail (buffer, GST_FLOW_ERROR);
+
+  *buffer = NULL;
+
+  if (NULL == data) {
+    return GST_FLOW_OK;
+  }
+
+  *buffer = gst_collect_pads_pop (cpads, data);
+  if (NULL == *buffer) {
+    GST_INFO_OBJECT (self, "EOS requested on %" GST_PTR_FORMAT, data->pad);
+    return GST_FLOW_EOS;
+  }
+
+  *buffer = gst_buffer_make_writable (*buffer);
+
+  GST_LOG_OBJECT (self, "Popped %" GST_PTR_FORMAT " from %" GST_PTR_FORMAT,
+      *buffer, data->pad);
+  return GST_FLOW_OK;
+}
+
+static void
+video_inference_buffer_unref (GstBuffer * buffer)
+{
+  if (NULL != buffer) {
+    gst_buffer_unref (buffer);
+  }
+}
+
+static GstFlowReturn
+gst_video_inference_process_batch (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GPtrArray * frames)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstFlowReturn frame_ret;
+  GstVideoInferenceFrame *frame;
+  guint i;
+
+  /* Run inference on the whole batch and finish frames in order */
+  if (!gst_video_inference_batch_predict (self, priv, frames)) {
+    ret = GST_FLOW_ERROR;
+  }
+
+  for (i = 0; i < frames->len; ++i) {
+    frame = (GstVideoInferenceFrame *) g_ptr_array_index (frames, i);
+
+    if (GST_FLOW_OK == ret) {
+      frame_ret = gst_video_inference_frame_finish (self, klass, priv, frame);
+      video_inference_store_flow_return (self, priv, frame->stream,
+          frame_ret);
+    }
+    gst_video_inference_frame_free (frame);
+  }
+
+  g_ptr_array_unref (frames);
+
+  return ret;
+}
+
+static GPtrArray *
+gst_video_inference_batch_take (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream,
+    guint64 * seq)
+{
+  GstVideoInferenceFrame *frame;
+  GPtrArray *frames;
+  guint inferred;
+  guint i;
+
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (priv, NULL);
+  g_return_val_if_fail (seq, NULL);
+
+  if (0 == priv->batch->len) {
+    return NULL;
+  }
+
+  if (NULL == stream) {
+    frames = priv->batch;
+    inferred = priv->batch_inferred;
+    priv->batch = g_ptr_array_new ();
+    priv->batch_inferred = 0;
+  } else {
+    /* Frames of the other streams keep waiting for the batch to fill */
+    frames = g_ptr_array_new ();
+    inferred = 0;
+    for (i = 0; i < priv->batch->len;) {
+      frame = (GstVideoInferenceFrame *) g_ptr_array_index (priv->batch, i);
+
+      if (frame->stream != stream) {
+        ++i;
+        continue;
+      }
+
+      inferred += video_inference_frame_num_tensors (frame);
+      g_ptr_array_add (frames, frame);
+      g_ptr_array_remove_index (priv->batch, i);
+    }
+    priv->batch_inferred -= inferred;
+
+    if (0 == frames->len) {
+      g_ptr_array_unref (frames);
+      return NULL;
+    }
+  }
+
+  GST_LOG_OBJECT (self, "Dispatching batch of %u frames, %u to infer",
+      frames->len, inferred);
+
+  if (!priv->async_enabled) {
+    return frames;
+  }
+
+  /* Taken with the batch so the order and the pending frames are known
+   * before the lock is released
+   */
+  *seq = priv->dispatch_seq++;
+
+  g_mutex_lock (&priv->async_mutex);
+  for (i = 0; i < frames->len; ++i) {
+    ((GstVideoInferenceFrame *) g_ptr_array_index (frames, i))->stream->
+        pending++;
+  }
+  g_mutex_unlock (&priv->async_mutex);
+
+  return frames;
+}
+
+static GstFlowReturn
+gst_video_inference_batch_send (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GPtrArray * frames, guint64 seq)
+{
+  g_return_val_if_fail (self, GST_FLOW_ERROR);
+  g_return_val_if_fail (klass, GST_FLOW_ERROR);
+  g_return_val_if_fail (priv, GST_FLOW_ERROR);
+
+  if (NULL == frames) {
+    return GST_FLOW_OK;
+  }
+
+  /* Only the collect pads thread dispatches in sync mode */
+  if (!priv->async_enabled) {
+    return gst_video_inference_process_batch (self, klass, priv, frames);
+  }
+
+  /* Blocks while the predict queue is full. Batches sent out of order
+   * by the timeout are put back in order by the reorder queue.
+   */
+  if (!gst_video_inference_async_push (self, priv->predict_queue, frames,
+          seq)) {
+    return GST_FLOW_FLUSHING;
+  }
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_video_inference_batch_add (GstVideoInference * self,
+    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
+    GPtrArray * frames)
+{
+  GstVideoInferenceFrame *frame;
+  GPtrArray *batch = NULL;
+  guint64 seq = 0;
+  guint i;
+
+  g_return_val_if_fail (self, GST_FLOW_ERROR);
+  g_return_val_if_fail (klass, GST_FLOW_ERROR);
+  g_return_val_if_fail (priv, GST_FLOW_ERROR);
+  g_return_val_if_fail (frames, GST_FLOW_ERROR);
+
+  if (0 == frames->len) {
+    return GST_FLOW_OK;
+  }
+
+  g_mutex_lock (&priv->batch_mutex);
+
+  if (0 == priv->batch->len) {
+    priv->batch_deadline = g_get_monotonic_time () +
+        (gint64) priv->batch_timeout * G_TIME_SPAN_MILLISECOND;
+    g_cond_signal (&priv->batch_cond);
+  }
+
+  /* Frames collected together from all the streams share the batch */
+  for (i = 0; i < frames->len; ++i) {
+    frame = (GstVideoInferenceFrame *) g_ptr_array_index (frames, i);
+
+    g_ptr_array_add (priv->batch, frame);
+    priv->batch_inferred += video_inference_frame_num_tensors (frame);
+  }
+
+  /* Frames without inference don't need to wait unless they are queued
+   * behind frames that do, otherwise they would be sent out of order
+   */
+  if (0 == priv->batch_inferred || priv->batch_inferred >= priv->batch_size) {
+    batch = gst_video_inference_batch_take (self, priv, NULL, &seq);
+  }
+
+  g_mutex_unlock (&priv->batch_mutex);
+
+  return gst_video_inference_batch_send (self, klass, priv, batch, seq);
+}
+
+/* Dispatch the frames of the stream waiting for the batch to fill, or
+ * drop them when discarding. A NULL stream dispatches every frame.
+ */
+static void
+gst_video_inference_batch_flush (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream,
+    gboolean discard)
+{
+  GstVideoInferenceClass *klass = GST_VIDEO_INFERENCE_GET_CLASS (self);
+  GstVideoInferenceFrame *frame;
+  GstFlowReturn ret;
+  GPtrArray *batch = NULL;
+  guint64 seq = 0;
+  guint i;
+
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
+
+  g_mutex_lock (&priv->batch_mutex);
+
+  if (!discard) {
+    batch = gst_video_inference_batch_take (self, priv, stream, &seq);
+    goto out;
+  }
+
+  for (i = 0; i < priv->batch->len;) {
+    frame = (GstVideoInferenceFrame *) g_ptr_array_index (priv->batch, i);
+
+    if (NULL != stream && frame->stream != stream) {
+      ++i;
+      continue;
+    }
+
+    priv->batch_inferred -= video_inference_frame_num_tensors (frame);
+    g_ptr_array_remove_index (priv->batch, i);
+    gst_video_inference_frame_free (frame);
+  }
+
+out:
+  g_mutex_unlock (&priv->batch_mutex);
+
+  ret = gst_video_inference_batch_send (self, klass, priv, batch, seq);
+  video_inference_store_flow_return (self, priv, NULL, ret);
+}
+
+static gpointer
+gst_video_inference_batch_loop (gpointer user_data)
+{
+  GstVideoInference *self = GST_VIDEO_INFERENCE (user_data);
+  GstVideoInferenceClass *klass = GST_VIDEO_INFERENCE_GET_CLASS (self);
+  GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+  GstFlowReturn ret;
+  GPtrArray *batch;
+  guint64 seq = 0;
+
+  GST_DEBUG_OBJECT (self, "Batch timeout started");
+
+  g_mutex_lock (&priv->batch_mutex);
+  while (priv->batch_running) {
+    if (0 == priv->batch->len) {
+      g_cond_wait (&priv->batch_cond, &priv->batch_mutex);
+    } else if (g_get_monotonic_time () < priv->batch_deadline) {
+      g_cond_wait_until (&priv->batch_cond, &priv->batch_mutex,
+          priv->batch_deadline);
+    } else {
+      GST_LOG_OBJECT (self, "Batch timed out with %u frames",
+          priv->batch->len);
+      batch = gst_video_inference_batch_take (self, priv, NULL, &seq);
+
+      /* Never wait on the predict queue with the batch locked */
+      g_mutex_unlock (&priv->batch_mutex);
+      ret = gst_video_inference_batch_send (self, klass, priv, batch, seq);
+      video_inference_store_flow_return (self, priv, NULL, ret);
+      g_mutex_lock (&priv->batch_mutex);
+    }
+  }
+  g_mutex_unlock (&priv->batch_mutex);
+
+  GST_DEBUG_OBJECT (self, "Batch timeout stopped");
+
+  return NULL;
+}
+
+static gboolean
+gst_video_inference_batch_start (GstVideoInference * self,
+    GstVideoInferencePrivate * priv)
+{
+  GError *error = NULL;
+
+  g_return_val_if_fail (self, FALSE);
+  g_return_val_if_fail (priv, FALSE);
+
+  /* Without a timeout batches are only completed or flushed by events */
+  if (priv->batch_size <= 1 || 0 == priv->batch_timeout) {
+    return TRUE;
+  }
+
+  GST_INFO_OBJECT (self, "Starting batch timeout of %u ms",
+      priv->batch_timeout);
+
+  priv->batch_running = TRUE;
+  priv->batch_thread = g_thread_try_new ("vinference-batch",
+      gst_video_inference_batch_loop, self, &error);
+  if (NULL == priv->batch_thread) {
+    GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+        ("Unable to create batch timeout thread: (%s)", error->message),
+        (NULL));
+    g_error_free (error);
+    priv->batch_running = FALSE;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+gst_video_inference_batch_stop (GstVideoInference * self,
+    GstVideoInferencePrivate * priv)
+{
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
+
+  g_mutex_lock (&priv->batch_mutex);
+  priv->batch_running = FALSE;
+  g_cond_broadcast (&priv->batch_cond);
+  g_mutex_unlock (&priv->batch_mutex);
+}
+
+static void
+gst_video_inference_batch_join (GstVideoInference * self,
+    GstVideoInferencePrivate * priv)
+{
+  GstVideoInferenceFrame *frame;
+  guint i;
+
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
+
+  if (NULL != priv->batch_thread) {
+    g_thread_join (priv->batch_thread);
+    priv->batch_thread = NULL;
+  }
+
+  /* Discard any frame left behind */
+  g_mutex_lock (&priv->batch_mutex);
+  for (i = 0; i < priv->batch->len; ++i) {
+    frame = (GstVideoInferenceFrame *) g_ptr_array_index (priv->batch, i);
+    gst_video_inference_frame_free (frame);
+  }
+  g_ptr_array_set_size (priv->batch, 0);
+  priv->batch_inferred = 0;
+  g_mutex_unlock (&priv->batch_mutex);
+}
+
+static void
+video_inference_store_flow_return (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream,
+    GstFlowReturn ret)
+{
+  if (GST_FLOW_OK == ret) {
+    return;
+  }
+
+  /* Errors stop every stream, other conditions only the given one */
+  g_mutex_lock (&priv->async_mutex);
+  if (NULL == stream || ret < GST_FLOW_EOS) {
+    if (GST_FLOW_OK == priv->async_ret) {
+      GST_DEBUG_OBJECT (self, "Deferred processing returned: (%d) %s", ret,
+          gst_flow_get_name (ret));
+      priv->async_ret = ret;
+    }
+  } else if (GST_FLOW_OK == stream->ret) {
+    GST_DEBUG_OBJECT (self, "Stream %u returned: (%d) %s", stream->index, ret,
+        gst_flow_get_name (ret));
+    stream->ret = ret;
+  }
+  g_mutex_unlock (&priv->async_mutex);
+}
+
+static GstFlowReturn
+gst_video_inference_collected (GstCollectPads * pads, gpointer user_data)
+{
+  GstVideoInference *self = GST_VIDEO_INFERENCE (user_data);
+  GstVideoInferenceClass *klass = GST_VIDEO_INFERENCE_GET_CLASS (self);
+  GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstFlowReturn stream_ret;
+  GstVideoInferenceStream *stream;
+  GstVideoInferenceFrame *frame;
+  GPtrArray *streams;
+  GPtrArray *frames;
+  gboolean any_ok = FALSE;
+  gboolean any_flushing = FALSE;
+  gboolean all_eos = TRUE;
+  guint interval;
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  interval = priv->inference_interval;
+  GST_OBJECT_UNLOCK (self);
+
+  streams = gst_video_inference_ref_streams (self, priv);
+  frames = g_ptr_array_new ();
+
+  for (i = 0; i < streams->len; ++i) {
+    stream = (GstVideoInferenceStream *) g_ptr_array_index (streams, i);
+
+    frame = gst_video_inference_pop_frame (self, priv, pads, stream,
+        &stream_ret);
+
+    if (GST_FLOW_CUSTOM_SUCCESS == stream_ret) {
+      continue;
+    }
+
+    if (GST_FLOW_OK == stream_ret) {
+      any_ok = TRUE;
+    }
+    if (GST_FLOW_FLUSHING == stream_ret) {
+      any_flushing = TRUE;
+    }
+    if (GST_FLOW_EOS != stream_ret) {
+      all_eos = FALSE;
+    }
+
+    if (NULL == frame) {
+      continue;
+    }
+
+    if (NULL != frame->buffer_model) {
+      frame->skip = 0 != (stream->frame_count++ % interval);
+    }
+
+    /* Preprocess runs here, while previous frames are being predicted */
+    if (!gst_video_inference_frame_preprocess (self, klass, priv, frame)) {
+      gst_video_inference_frame_free (frame);
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+
+    g_ptr_array_add (frames, frame);
+  }
+
+  if (GST_FLOW_OK == ret) {
+    ret = gst_video_inference_batch_add (self, klass, priv, frames);
+  } else {
+    /* Frames are only owned by the batch once added */
+    g_ptr_array_foreach (frames, (GFunc) gst_video_inference_frame_free,
+        NULL);
+  }
+  g_ptr_array_unref (frames);
+  g_ptr_array_unref (streams);
+
+  if (GST_FLOW_OK != ret) {
+    return ret;
+  }
+
+  /* Report errors from frames processed outside of this thread */
+  g_mutex_lock (&priv->async_mutex);
+  ret = priv->async_ret;
+  g_mutex_unlock (&priv->async_mutex);
+
+  if (GST_FLOW_OK != ret || any_ok) {
+    return ret;
+  }
+
+  /* No stream can take more data, combine their conditions */
+  if (any_flushing) {
+    ret = GST_FLOW_FLUSHING;
+  } else if (all_eos) {
+    ret = GST_FLOW_EOS;
+  } else {
+    ret = GST_FLOW_NOT_LINKED;
+  }
+
+  return ret;
+}
+
+static GstVideoInferenceFrame *
+gst_video_inference_pop_frame (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstCollectPads * pads,
+    GstVideoInferenceStream * stream, GstFlowReturn * stream_ret)
+{
+  GstVideoInferencePad *model_data;
+  GstVideoInferencePad *bypass_data;
+  GstBuffer *buffer_model = NULL;
+  GstBuffer *buffer_bypass = NULL;
+  GstFlowReturn ret;
+
+  GST_OBJECT_LOCK (self);
+  model_data = stream->sink_model_data;
+  bypass_data = stream->sink_bypass_data;
+  GST_OBJECT_UNLOCK (self);
+
+  /* Stream without sink pads, nothing to collect */
+  if (NULL == model_data && NULL == bypass_data) {
+    *stream_ret = GST_FLOW_CUSTOM_SUCCESS;
+    return NULL;
+  }
+
+  ret =
+      gst_video_inference_pop_buffer (self, pads,
+      (GstCollectData *) model_data, &buffer_model);
+  if (GST_FLOW_OK != ret) {
+    goto out;
+  }
+
+  ret =
+      gst_video_inference_pop_buffer (self, pads,
+      (GstCollectData *) bypass_data, &buffer_bypass);
+  if (GST_FLOW_OK != ret) {
+    goto model_free;
+  }
+
+  /* Drop the buffers of streams that can't take more data */
+  g_mutex_lock (&priv->async_mutex);
+  ret = stream->ret;
+  g_mutex_unlock (&priv->async_mutex);
+
+  if (GST_FLOW_OK != ret) {
+    GST_LOG_OBJECT (self, "Dropping buffers of stream %u: (%d) %s",
+        stream->index, ret, gst_flow_get_name (ret));
+    video_inference_buffer_unref (buffer_bypass);
+    goto model_free;
+  }
+
+  *stream_ret = ret;
+
+  /* The frame owns the buffers from now on */
+  return gst_video_inference_frame_new (self, stream, buffer_model,
+      buffer_bypass);
+
+model_free:
+  video_inference_buffer_unref (buffer_model);
+
+out:
+  *stream_ret = ret;
+  return NULL;
+}
+
+static gboolean
+video_inference_queue_check_full (GstDataQueue * queue, guint visible,
+    guint bytes, guint64 time, gpointer checkdata)
+{
+  GstVideoInferencePrivate *priv = (GstVideoInferencePrivate *) checkdata;
+
+  return visible >= priv->queue_size;
+}
+
+static void
+video_inference_queue_item_free (GstVideoInferenceQueueItem * qitem)
+{
+  GstVideoInference *self;
+  guint i;
+
+  g_return_if_fail (qitem);
+
+  self = qitem->self;
+
+  /* The frames were never processed, they are being flushed */
+  if (NULL != qitem->frames) {
+    for (i = 0; i < qitem->frames->len; ++i) {
+      gst_video_inference_async_frame_done (self,
+          GST_VIDEO_INFERENCE_PRIVATE (self),
+          (GstVideoInferenceFrame *) g_ptr_array_index (qitem->frames, i),
+          GST_FLOW_FLUSHING);
+    }
+    g_ptr_array_unref (qitem->frames);
+  }
+
+  g_slice_free (GstVideoInferenceQueueItem, qitem);
 }
 
 static gboolean
-gst_video_inference_predict (GstVideoInference * self,
-    GstVideoInferencePrivate * priv, GstVideoFrame * frame, gpointer * pred,
-    gsize * pred_size)
+gst_video_inference_async_push (GstVideoInference * self,
+    GstDataQueue * queue, GPtrArray * frames, guint64 seq)
 {
-  GError *error = NULL;
+  GstVideoInferenceQueueItem *qitem;
 
   g_return_val_if_fail (self, FALSE);
-  g_return_val_if_fail (priv, FALSE);
-  g_return_val_if_fail (frame, FALSE);
-  g_return_val_if_fail (pred, FALSE);
-  g_return_val_if_fail (pred_size, FALSE);
-
-  GST_LOG_OBJECT (self, "Running prediction on frame");
-
-  if (!gst_backend_process_frame (priv->backend, frame, pred, pred_size,
-          &error)) {
-    GST_ELEMENT_ERROR (self, STREAM, FAILED,
-        ("Could not process using the selected backend: (%s)", error->message),
-        (NULL));
-    g_error_free (error);
+  g_return_val_if_fail (queue, FALSE);
+  g_return_val_if_fail (frames, FALSE);
+
+  qitem = g_slice_new0 (GstVideoInferenceQueueItem);
+  qitem->item.visible = TRUE;
+  qitem->item.destroy = (GDestroyNotify) video_inference_queue_item_free;
+  qitem->self = self;
+  qitem->frames = frames;
+  qitem->seq = seq;
+
+  if (!gst_data_queue_push (queue, &qitem->item)) {
+    GST_DEBUG_OBJECT (self, "Queue is flushing, dropping frames");
+    video_inference_queue_item_free (qitem);
     return FALSE;
   }
 
   return TRUE;
 }
 
-static gboolean
-gst_video_inference_model_buffer_process (GstVideoInference * self,
-    GstVideoInferenceClass * klass, GstVideoInferencePrivate * priv,
-    GstBuffer * buffer, gpointer * prediction_data, gsize * prediction_size)
+static GPtrArray *
+gst_video_inference_async_pop (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstDataQueue * queue, guint64 * seq)
 {
-  GstVideoFrame inframe, outframe;
-  GstBuffer *outbuf;
-  gboolean ret;
-
-  g_return_val_if_fail (self, FALSE);
-  g_return_val_if_fail (klass, FALSE);
-  g_return_val_if_fail (priv, FALSE);
-  g_return_val_if_fail (buffer, FALSE);
-  g_return_val_if_fail (prediction_data, FALSE);
-  g_return_val_if_fail (prediction_size, FALSE);
+  GstDataQueueItem *item;
+  GstVideoInferenceQueueItem *qitem;
+  GPtrArray *frames;
 
-  video_inference_map_buffers (priv->sink_model_data, buffer, &inframe,
-      &outframe);
-  outbuf = outframe.buffer;
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (priv, NULL);
+  g_return_val_if_fail (queue, NULL);
 
-  if (!gst_video_inference_preprocess (self, klass, &inframe, &outframe)) {
-    ret = FALSE;
-    goto free_frames;
+  /* Pop only fails when stopping */
+  if (!gst_data_queue_pop (queue, &item)) {
+    return NULL;
   }
 
-  if (!gst_video_inference_predict (self, priv, &outframe, prediction_data,
-          prediction_size)) {
-    ret = FALSE;
-    goto free_frames;
+  qitem = (GstVideoInferenceQueueItem *) item;
+  frames = qitem->frames;
+  qitem->frames = NULL;
+  if (NULL != seq) {
+    *seq = qitem->seq;
   }
+  item->destroy (item);
 
-  ret = TRUE;
-
-free_frames:
-  gst_video_frame_unmap (&inframe);
-  gst_video_frame_unmap (&outframe);
-  gst_buffer_unref (outbuf);
-
-  return ret;
+  return frames;
 }
 
-static gboolean
-video_inference_prepare_postprocess (const GstMetaInfo * meta_info,
-    GstBuffer * buffer, GstVideoInfo * video_info, GstVideoFrame * out_frame,
-    GstMeta ** out_meta)
+static void
+gst_video_inference_async_frame_done (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceFrame * frame,
+    GstFlowReturn ret)
 {
-  GstMapFlags flags;
+  GstVideoInferenceStream *stream;
 
-  g_return_val_if_fail (meta_info, FALSE);
-  g_return_val_if_fail (out_frame, FALSE);
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
+  g_return_if_fail (frame);
 
-  /* No pad requested, continue without meta */
-  if (NULL == buffer || NULL == video_info) {
-    return TRUE;
-  }
+  stream = video_inference_stream_ref (frame->stream);
+  gst_video_inference_frame_free (frame);
 
-  if (out_meta) {
-    g_return_val_if_fail (gst_buffer_is_writable (buffer), FALSE);
-    *out_meta = gst_buffer_add_meta (buffer, meta_info, NULL);
-  }
+  video_inference_store_flow_return (self, priv, stream, ret);
 
-  flags = (GstMapFlags) (GST_MAP_READ | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
-  gst_video_frame_map (out_frame, video_info, buffer, flags);
+  g_mutex_lock (&priv->async_mutex);
+  stream->pending--;
+  g_cond_broadcast (&priv->async_cond);
+  g_mutex_unlock (&priv->async_mutex);
 
-  return TRUE;
+  video_inference_stream_unref (stream);
 }
 
-static void
-video_inference_frame_unmap (GstBuffer * buffer, GstVideoFrame * frame)
+static gpointer
+gst_video_inference_predict_loop (gpointer user_data)
 {
-  g_return_if_fail (frame);
+  GstVideoInference *self = GST_VIDEO_INFERENCE (user_data);
+  GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+  GPtrArray *frames;
+  guint64 seq;
+  guint i;
+
+  GST_DEBUG_OBJECT (self, "Predict stage started");
+
+  while ((frames =
+          gst_video_inference_async_pop (self, priv, priv->predict_queue,
+              &seq))) {
+    if (!gst_video_inference_batch_predict (self, priv, frames)) {
+      for (i = 0; i < frames->len; ++i) {
+        gst_video_inference_async_frame_done (self, priv,
+            (GstVideoInferenceFrame *) g_ptr_array_index (frames, i),
+            GST_FLOW_ERROR);
+      }
+      /* Keep the place of the batch so the following ones can go on */
+      g_ptr_array_set_size (frames, 0);
+    }
 
-  if (NULL != buffer) {
-    gst_video_frame_unmap (frame);
+    gst_video_inference_async_reorder (self, priv, frames, seq);
   }
+
+  GST_DEBUG_OBJECT (self, "Predict stage stopped");
+
+  return NULL;
 }
 
-static void
-video_inference_remove_meta (GstBuffer * buffer, GstMeta * meta)
+static gint
+video_inference_queue_item_compare (gconstpointer a, gconstpointer b,
+    gpointer user_data)
 {
-  if (NULL != buffer && NULL != meta) {
-    g_return_if_fail (gst_buffer_is_writable (buffer));
-    gst_buffer_remove_meta (buffer, meta);
-  }
+  const GstVideoInferenceQueueItem *qa = (const GstVideoInferenceQueueItem *) a;
+  const GstVideoInferenceQueueItem *qb = (const GstVideoInferenceQueueItem *) b;
+
+  return qa->seq < qb->seq ? -1 : qa->seq > qb->seq;
 }
 
-static GstMeta *
-video_inference_transform_meta (GstBuffer * buffer_model,
-    GstVideoInfo * info_model, GstMeta * meta_model, GstBuffer * buffer_bypass,
-    GstVideoInfo * info_bypass)
+static void
+gst_video_inference_async_reorder (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GPtrArray * frames, guint64 seq)
 {
-  GstMeta *meta_bypass = NULL;
-  const GstMetaInfo *info;
-  GQuark size_quark = g_quark_from_static_string (GST_META_TAG_VIDEO_SIZE_STR);
-  GQuark orientation_quark =
-      g_quark_from_static_string (GST_META_TAG_VIDEO_ORIENTATION_STR);
-  GQuark scale_quark = gst_video_meta_transform_scale_get_quark ();
-  GQuark copy_quark = g_quark_from_static_string ("gst-copy");
-
-  g_return_val_if_fail (buffer_model, NULL);
-  g_return_val_if_fail (info_model, NULL);
-  g_return_val_if_fail (meta_model, NULL);
+  GstVideoInferenceQueueItem *qitem;
 
-  if (NULL == info_bypass || NULL == buffer_bypass) {
-    return meta_bypass;
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
+  g_return_if_fail (frames);
+
+  qitem = g_slice_new0 (GstVideoInferenceQueueItem);
+  qitem->item.visible = TRUE;
+  qitem->item.destroy = (GDestroyNotify) video_inference_queue_item_free;
+  qitem->self = self;
+  qitem->frames = frames;
+  qitem->seq = seq;
+
+  /* Workers may finish out of order, only release batches once all the
+   * ones dispatched before them are done. If flushing, the frames are
+   * released by the queue item.
+   */
+  g_mutex_lock (&priv->reorder_mutex);
+  g_queue_insert_sorted (&priv->reorder, qitem,
+      video_inference_queue_item_compare, NULL);
+
+  while ((qitem = (GstVideoInferenceQueueItem *)
+          g_queue_peek_head (&priv->reorder))
+      && qitem->seq == priv->reorder_next) {
+    g_queue_pop_head (&priv->reorder);
+    priv->reorder_next++;
+
+    if (!gst_data_queue_push (priv->postprocess_queue, &qitem->item)) {
+      GST_DEBUG_OBJECT (self, "Queue is flushing, dropping frames");
+      video_inference_queue_item_free (qitem);
+    }
   }
+  g_mutex_unlock (&priv->reorder_mutex);
+}
 
-  info = meta_model->info;
-
-  if (gst_meta_api_type_has_tag (info->api, size_quark) ||
-      gst_meta_api_type_has_tag (info->api, orientation_quark)) {
-    GstVideoMetaTransform trans = { info_model, info_bypass };
-
-    info->transform_func (buffer_bypass, meta_model, buffer_model,
-        scale_quark, &trans);
-  } else {
-    info->transform_func (buffer_bypass, meta_model, buffer_model,
-        copy_quark, NULL);
+static gpointer
+gst_video_inference_postprocess_loop (gpointer user_data)
+{
+  GstVideoInference *self = GST_VIDEO_INFERENCE (user_data);
+  GstVideoInferenceClass *klass = GST_VIDEO_INFERENCE_GET_CLASS (self);
+  GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+  GstVideoInferenceFrame *frame;
+  GPtrArray *frames;
+  GstFlowReturn ret;
+  guint i;
+
+  GST_DEBUG_OBJECT (self, "Postprocess stage started");
+
+  while ((frames =
+          gst_video_inference_async_pop (self, priv,
+              priv->postprocess_queue, NULL))) {
+    for (i = 0; i < frames->len; ++i) {
+      frame = (GstVideoInferenceFrame *) g_ptr_array_index (frames, i);
+      ret = gst_video_inference_frame_finish (self, klass, priv, frame);
+      gst_video_inference_async_frame_done (self, priv, frame, ret);
+    }
+    g_ptr_array_unref (frames);
   }
-  meta_bypass = gst_buffer_get_meta (buffer_bypass, info->api);
 
-  return meta_bypass;
+  GST_DEBUG_OBJECT (self, "Postprocess stage stopped");
+
+  return NULL;
 }
 
 static gboolean
-gst_video_inference_postprocess (GstVideoInference * self,
-    GstVideoInferenceClass * klass, const gpointer prediction_data,
-    gsize prediction_size, GstBuffer * buffer_model,
-    GstVideoInferencePad * pad_model, GstBuffer * buffer_bypass,
-    GstVideoInferencePad * pad_bypass)
+gst_video_inference_async_start (GstVideoInference * self,
+    GstVideoInferencePrivate * priv)
 {
-  GstMeta *meta_model = NULL;
-  GstMeta *meta_bypass = NULL;
-  GstVideoFrame frame_model;
-  GstVideoFrame frame_bypass;
-  GstVideoInfo *info_model = NULL;
-  GstVideoInfo *info_bypass = NULL;
-  gboolean pred_valid = FALSE;
+  GError *error = NULL;
+  GThread *thread;
+  guint i;
 
   g_return_val_if_fail (self, FALSE);
-  g_return_val_if_fail (klass, FALSE);
-  g_return_val_if_fail (prediction_data, FALSE);
-  g_return_val_if_fail (prediction_size, FALSE);
-  g_return_val_if_fail (buffer_model, FALSE);
-  g_return_val_if_fail (pad_model, FALSE);
+  g_return_val_if_fail (priv, FALSE);
 
-  /* Subclass didn't implement a post-process, dont fail, just ignore */
-  if (NULL == klass->postprocess) {
-    return TRUE;
-  }
+  GST_INFO_OBJECT (self, "Starting async stages with queue size %u and %u "
+      "workers", priv->queue_size, priv->num_workers);
 
-  info_model = &(pad_model->info);
-  info_bypass = pad_bypass ? &(pad_bypass->info) : NULL;
+  g_mutex_lock (&priv->async_mutex);
+  priv->async_running = TRUE;
+  priv->async_ret = GST_FLOW_OK;
+  g_mutex_unlock (&priv->async_mutex);
 
-  if (!video_inference_prepare_postprocess (klass->inference_meta_info,
-          buffer_model, info_model, &frame_model, &meta_model)) {
-    return FALSE;
-  }
+  gst_data_queue_set_flushing (priv->predict_queue, FALSE);
+  gst_data_queue_set_flushing (priv->postprocess_queue, FALSE);
 
-  if (!video_inference_prepare_postprocess (klass->inference_meta_info,
-          buffer_bypass, info_bypass, &frame_bypass, NULL)) {
-    return FALSE;
-  }
+  priv->dispatch_seq = 0;
+  priv->reorder_next = 0;
 
-  GST_LOG_OBJECT (self, "Calling frame postprocess");
-  if (!klass->postprocess (self, prediction_data, prediction_size, meta_model,
-          info_model, &pred_valid)) {
-    GST_ELEMENT_ERROR (self, STREAM, FAILED, ("Subclass failed at preprocess"),
-        (NULL));
-    return FALSE;
+  for (i = 0; i < priv->num_workers; ++i) {
+    thread = g_thread_try_new ("vinference-predict",
+        gst_video_inference_predict_loop, self, &error);
+    if (NULL == thread) {
+      goto error;
+    }
+    g_ptr_array_add (priv->predict_threads, thread);
   }
 
-  if (pred_valid) {
-    GstVideoFrame *pbpass = buffer_bypass ? &frame_bypass : NULL;
-
-    meta_bypass =
-        video_inference_transform_meta (buffer_model, info_model, meta_model,
-        buffer_bypass, info_bypass);
-    g_signal_emit (self, gst_video_inference_signals[NEW_PREDICTION_SIGNAL], 0,
-        meta_model, &frame_bypass, meta_bypass, pbpass);
-  } else {
-    video_inference_remove_meta (buffer_model, meta_model);
-    video_inference_remove_meta (buffer_bypass, meta_bypass);
+  priv->postprocess_thread = g_thread_try_new ("vinference-postprocess",
+      gst_video_inference_postprocess_loop, self, &error);
+  if (NULL == priv->postprocess_thread) {
+    goto error;
   }
 
-  video_inference_frame_unmap (buffer_model, &frame_model);
-  video_inference_frame_unmap (buffer_bypass, &frame_bypass);
-
   return TRUE;
+
+error:
+  GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+      ("Unable to create async stage thread: (%s)", error->message), (NULL));
+  g_error_free (error);
+  gst_video_inference_async_stop (self, priv);
+  gst_video_inference_async_join (self, priv);
+  return FALSE;
 }
 
-static GstFlowReturn
-gst_video_inference_pop_buffer (GstVideoInference * self,
-    GstCollectPads * cpads, GstCollectData * data, GstBuffer ** buffer)
+static void
+gst_video_inference_async_stop (GstVideoInference * self,
+    GstVideoInferencePrivate * priv)
 {
-  g_return_val_if_fail (self, GST_FLOW_ERROR);
-  g_return_val_if_fail (buffer, GST_FLOW_ERROR);
-
-  *buffer = NULL;
-
-  if (NULL == data) {
-    return GST_FLOW_OK;
-  }
-
-  *buffer = gst_collect_pads_pop (cpads, data);
-  if (NULL == *buffer) {
-    GST_INFO_OBJECT (self, "EOS requested on %" GST_PTR_FORMAT, data->pad);
-    return GST_FLOW_EOS;
-  }
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
 
-  *buffer = gst_buffer_make_writable (*buffer);
+  g_mutex_lock (&priv->async_mutex);
+  priv->async_running = FALSE;
+  g_cond_broadcast (&priv->async_cond);
+  g_mutex_unlock (&priv->async_mutex);
 
-  GST_LOG_OBJECT (self, "Popped %" GST_PTR_FORMAT " from %" GST_PTR_FORMAT,
-      *buffer, data->pad);
-  return GST_FLOW_OK;
+  /* Unblock the stages and release any frame still queued */
+  gst_data_queue_set_flushing (priv->predict_queue, TRUE);
+  gst_data_queue_set_flushing (priv->postprocess_queue, TRUE);
+  gst_data_queue_flush (priv->predict_queue);
+  gst_data_queue_flush (priv->postprocess_queue);
 }
 
 static void
-video_inference_buffer_unref (GstBuffer * buffer)
+gst_video_inference_async_join (GstVideoInference * self,
+    GstVideoInferencePrivate * priv)
 {
-  if (NULL != buffer) {
-    gst_buffer_unref (buffer);
-  }
-}
+  GstVideoInferenceQueueItem *qitem;
+  guint i;
 
-static GstFlowReturn
-gst_video_inference_collected (GstCollectPads * pads, gpointer user_data)
-{
-  GstVideoInference *self = GST_VIDEO_INFERENCE (user_data);
-  GstVideoInferenceClass *klass = GST_VIDEO_INFERENCE_GET_CLASS (self);
-  GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstBuffer *buffer_model = NULL;
-  GstBuffer *buffer_bypass = NULL;
-  gpointer prediction_data = NULL;
-  gsize prediction_size;
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
 
-  ret =
-      gst_video_inference_pop_buffer (self, pads,
-      (GstCollectData *) priv->sink_model_data, &buffer_model);
-  if (GST_FLOW_OK != ret) {
-    goto out;
+  for (i = 0; i < priv->predict_threads->len; ++i) {
+    g_thread_join ((GThread *) g_ptr_array_index (priv->predict_threads, i));
   }
+  g_ptr_array_set_size (priv->predict_threads, 0);
 
-  ret =
-      gst_video_inference_pop_buffer (self, pads,
-      (GstCollectData *) priv->sink_bypass_data, &buffer_bypass);
-  if (GST_FLOW_OK != ret) {
-    goto model_free;
+  if (NULL != priv->postprocess_thread) {
+    g_thread_join (priv->postprocess_thread);
+    priv->postprocess_thread = NULL;
   }
 
-  if (buffer_model) {
-    /* Run preprocess and inference on the model and generate prediction */
-    if (!gst_video_inference_model_buffer_process (self, klass, priv,
-            buffer_model, &prediction_data, &prediction_size)) {
-      ret = GST_FLOW_ERROR;
-      goto bypass_free;
-    }
+  /* Frames popped right before stopping may have been left behind */
+  gst_data_queue_flush (priv->predict_queue);
+  gst_data_queue_flush (priv->postprocess_queue);
 
-    /* Have the subclass analyze the prediction and generate model and bypass metas */
-    if (!gst_video_inference_postprocess (self, klass, prediction_data,
-            prediction_size, buffer_model, priv->sink_model_data, buffer_bypass,
-            priv->sink_bypass_data)) {
-      ret = GST_FLOW_ERROR;
-      goto bypass_free;
-    }
+  g_mutex_lock (&priv->reorder_mutex);
+  while ((qitem = (GstVideoInferenceQueueItem *)
+          g_queue_pop_head (&priv->reorder))) {
+    video_inference_queue_item_free (qitem);
   }
+  g_mutex_unlock (&priv->reorder_mutex);
+}
 
-  /* Forward buffer to model src pad */
-  ret = gst_video_inference_forward_buffer (self, buffer_model,
-      priv->src_model);
+static void
+gst_video_inference_async_drain (GstVideoInference * self,
+    GstVideoInferencePrivate * priv, GstVideoInferenceStream * stream)
+{
+  g_return_if_fail (self);
+  g_return_if_fail (priv);
 
-  /* We don't own this buffer anymore, don't free it */
-  buffer_model = NULL;
-  if (GST_FLOW_OK != ret) {
-    goto bypass_free;
+  if (NULL == stream) {
+    return;
   }
 
-  /* Forward buffer to bypass src pad */
-  ret = gst_video_inference_forward_buffer (self,
-      buffer_bypass, priv->src_bypass);
-
-  /* We don't own this buffer anymore, don't free it */
-  buffer_bypass = NULL;
-
-  goto out;
-
-bypass_free:
-  video_inference_buffer_unref (buffer_bypass);
-
-model_free:
-  video_inference_buffer_unref (buffer_model);
-
-out:
-  g_free (prediction_data);
-
-  return ret;
+  g_mutex_lock (&priv->async_mutex);
+  while (stream->pending > 0 && priv->async_running) {
+    GST_LOG_OBJECT (self, "Waiting for %u frames of stream %u in the async "
+        "stages", stream->pending, stream->index);
+    g_cond_wait (&priv->async_cond, &priv->async_mutex);
+  }
+  g_mutex_unlock (&priv->async_mutex);
 }
 
 static GstPad *
 gst_video_inference_get_src_pad (GstVideoInference * self,
     GstVideoInferencePrivate * priv, GstPad * sinkpad)
 {
+  GstVideoInferenceStream *stream;
   GstPad *pad;
 
-  if (sinkpad == priv->sink_model) {
-    pad = priv->src_model;
-  } else if (sinkpad == priv->sink_bypass) {
-    pad = priv->src_bypass;
+  /* Called with the object lock held */
+  stream = gst_video_inference_find_stream (self, priv, sinkpad);
+  if (NULL == stream) {
+    return NULL;
+  }
+
+  if (sinkpad == stream->sink_model) {
+    pad = stream->src_model;
+  } else if (sinkpad == stream->sink_bypass) {
+    pad = stream->src_bypass;
   } else {
     g_return_val_if_reached (NULL);
   }
@@ -1023,12 +3511,19 @@ static GstPad *
 gst_video_inference_get_sink_pad (GstVideoInference * self,
     GstVideoInferencePrivate * priv, GstPad * srcpad)
 {
+  GstVideoInferenceStream *stream;
   GstPad *pad;
 
-  if (srcpad == priv->src_model) {
-    pad = priv->sink_model;
-  } else if (srcpad == priv->src_bypass) {
-    pad = priv->sink_bypass;
+  /* Called with the object lock held */
+  stream = gst_video_inference_find_stream (self, priv, srcpad);
+  if (NULL == stream) {
+    return NULL;
+  }
+
+  if (srcpad == stream->src_model) {
+    pad = stream->sink_model;
+  } else if (srcpad == stream->src_bypass) {
+    pad = stream->sink_bypass;
   } else {
     g_return_val_if_reached (NULL);
   }
@@ -1060,6 +3555,10 @@ gst_video_inference_set_caps (GstVideoInference * self,
         caps);
     gst_video_info_init (info);
     gst_video_info_from_caps (info, caps);
+
+    if (cpad == cpad->stream->sink_model_data) {
+      gst_video_inference_tensor_pool_configure (self, cpad->stream, info);
+    }
   }
 }
 
@@ -1105,18 +3604,42 @@ gst_video_inference_sink_event (GstCollectPads * pads, GstCollectData * pad,
 {
   GstVideoInference *self = GST_VIDEO_INFERENCE (user_data);
   GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
+  GstVideoInferenceStream *stream;
   gboolean ret = FALSE;
-  GstPad *srcpad;
+  GstPad *srcpad = NULL;
 
   GST_LOG_OBJECT (self, "Received event %s from %" GST_PTR_FORMAT,
       GST_EVENT_TYPE_NAME (event), pad->pad);
 
+  stream = ((GstVideoInferencePad *) pad)->stream;
+
+  GST_OBJECT_LOCK (self);
   srcpad = gst_video_inference_get_src_pad (self, priv, pad->pad);
+  if (NULL != srcpad) {
+    gst_object_ref (srcpad);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  /* Serialized events must not overtake frames of their stream still being
+   * batched or in the async stages. Frames from before a flush are
+   * discarded instead.
+   */
+  if (GST_EVENT_IS_SERIALIZED (event)) {
+    gst_video_inference_batch_flush (self, priv, stream,
+        GST_EVENT_FLUSH_STOP == GST_EVENT_TYPE (event));
+    gst_video_inference_async_drain (self, priv, stream);
+  }
 
   switch (GST_EVENT_TYPE (event)) {
     case GST_EVENT_CAPS:
       gst_video_inference_set_caps (self, priv, pad, event);
       break;
+    case GST_EVENT_FLUSH_START:
+      gst_video_inference_stream_set_flushing (self, priv, stream, TRUE);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_video_inference_stream_set_flushing (self, priv, stream, FALSE);
+      break;
     default:
       break;
   }
@@ -1139,6 +3662,10 @@ gst_video_inference_sink_event (GstCollectPads * pads, GstCollectData * pad,
   ret = gst_collect_pads_event_default (priv->cpads, pad, event, FALSE);
 
 out:
+  if (NULL != srcpad) {
+    gst_object_unref (srcpad);
+  }
+
   return ret;
 }
 
@@ -1159,18 +3686,25 @@ gst_video_inference_finalize (GObject * object)
   GstVideoInferencePrivate *priv = GST_VIDEO_INFERENCE_PRIVATE (self);
 
   g_clear_object (&(priv->cpads));
-  g_clear_object (&(priv->sink_bypass));
-  g_clear_object (&(priv->sink_model));
-  g_clear_object (&(priv->src_bypass));
-  g_clear_object (&(priv->src_model));
+  g_list_free_full (priv->streams,
+      (GDestroyNotify) video_inference_stream_unref);
+  priv->streams = NULL;
 
-  priv->sink_bypass_data = NULL;
-  priv->sink_model_data = NULL;
   g_free (priv->model_location);
   priv->model_location = NULL;
 
   g_clear_object (&priv->backend);
 
+  g_clear_object (&priv->predict_queue);
+  g_clear_object (&priv->postprocess_queue);
+  g_ptr_array_unref (priv->batch);
+  g_mutex_clear (&priv->batch_mutex);
+  g_cond_clear (&priv->batch_cond);
+  g_mutex_clear (&priv->async_mutex);
+  g_cond_clear (&priv->async_cond);
+  g_ptr_array_unref (priv->predict_threads);
+  g_mutex_clear (&priv->reorder_mutex);
+
   G_OBJECT_CLASS (gst_video_inference_parent_class)->finalize (object);
 }
 
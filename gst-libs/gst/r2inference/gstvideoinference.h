@@ -24,6 +24,7 @@
 
 #include <gst/gst.h>
 #include <gst/video/video.h>
+#include <gst/r2inference/gstinferencemeta.h>
 
 G_BEGIN_DECLS
 
@@ -43,8 +44,40 @@ struct _GstVideoInferenceClass
     gsize size, GstMeta *meta_model, GstVideoInfo *info_model, gboolean *valid_prediction);
 
   const GstMetaInfo *inference_meta_info;
+  gint model_channels;
+  /* Size of the model input, buffers of other sizes are scaled into it
+   * while preprocessing. Zero keeps the size of the negotiated caps.
+   * Elements can override it on start with
+   * gst_video_inference_set_model_size.
+   */
+  gint model_width;
+  gint model_height;
+  /* Order the model expects the tensor components in. Starting fails if
+   * the backend can't take it.
+   */
+  GstInferenceTensorLayout tensor_layout;
+  /* Mask of the tensor types the model takes, as 1 << type. The
+   * narrowest one the backend also takes is used, starting fails if
+   * there is none.
+   */
+  guint tensor_types;
+  /* Quantization of the model input, for the 8 bit tensor types */
+  gdouble tensor_scale;
+  gint tensor_zero_point;
 };
 
+/**
+ * \brief Set the model input size of an element, for models that only
+ * know it once started. Call it from the start vmethod, it overrides the
+ * model_width and model_height of the class.
+ *
+ * \param self The element
+ * \param width Width of the model input, zero keeps the caps width
+ * \param height Height of the model input, zero keeps the caps height
+ */
+
+void gst_video_inference_set_model_size (GstVideoInference *self, gint width, gint height);
+
 G_END_DECLS
 
 #endif //__GST_VIDEO_INFERENCE_H__
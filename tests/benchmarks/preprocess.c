@@ -0,0 +1,281 @@
+/*
+ * GStreamer
+ * Copyright (C) 2019 RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+
+/* Times the preprocess functions for every supported format at the
+ * model sizes of the elements in ext/r2inference. Prints one line per
+ * case so the output of two commits can be diffed.
+ */
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/r2inference/gstinferencepreprocess.h>
+#include <string.h>
+
+#define MODEL_CHANNELS 3
+/* Pixels processed per measurement, the best of the repeats is kept */
+#define PIXELS_PER_MEASUREMENT (20 * 1000 * 1000)
+#define DEFAULT_REPEATS 3
+
+typedef gboolean (*PreprocessFunc) (GstVideoFrame * inframe,
+    GstVideoFrame * outframe);
+
+typedef struct _Function Function;
+struct _Function
+{
+  const gchar *name;
+  PreprocessFunc func;
+};
+
+typedef struct _Size Size;
+struct _Size
+{
+  gint in_width;
+  gint in_height;
+  gint out_width;
+  gint out_height;
+};
+
+static gboolean run_normalize (GstVideoFrame * inframe,
+    GstVideoFrame * outframe);
+static gboolean run_normalize_face (GstVideoFrame * inframe,
+    GstVideoFrame * outframe);
+static gboolean run_subtract_mean (GstVideoFrame * inframe,
+    GstVideoFrame * outframe);
+static gboolean run_pixel_to_float (GstVideoFrame * inframe,
+    GstVideoFrame * outframe);
+static gboolean run_normalize_with_lut (GstVideoFrame * inframe,
+    GstVideoFrame * outframe);
+static gboolean benchmark (const Function * function, GstVideoFormat format,
+    const Size * size, gint repeats);
+
+static const Function functions[] = {
+  {"normalize", run_normalize},
+  {"normalize_face", run_normalize_face},
+  {"subtract_mean", run_subtract_mean},
+  {"pixel_to_float", run_pixel_to_float},
+  {"normalize_lut", run_normalize_with_lut},
+};
+
+/* The InceptionV1 table, as the elements normalize through tables */
+static GstNormalizeLut *lut = NULL;
+
+static const GstVideoFormat formats[] = {
+  GST_VIDEO_FORMAT_RGB, GST_VIDEO_FORMAT_RGBx, GST_VIDEO_FORMAT_RGBA,
+  GST_VIDEO_FORMAT_BGR, GST_VIDEO_FORMAT_BGRx, GST_VIDEO_FORMAT_BGRA,
+  GST_VIDEO_FORMAT_xRGB, GST_VIDEO_FORMAT_ARGB, GST_VIDEO_FORMAT_xBGR,
+  GST_VIDEO_FORMAT_ABGR, GST_VIDEO_FORMAT_NV12, GST_VIDEO_FORMAT_I420,
+  GST_VIDEO_FORMAT_YUY2,
+};
+
+/* Frames already at the model size, and 1080p scaled to it */
+static const Size sizes[] = {
+  {224, 224, 224, 224},
+  {299, 299, 299, 299},
+  {416, 416, 416, 416},
+  {1920, 1080, 1920, 1080},
+  {1920, 1080, 224, 224},
+  {1920, 1080, 299, 299},
+  {1920, 1080, 416, 416},
+};
+
+static gboolean
+run_normalize (GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  /* InceptionV1 mean and std */
+  return gst_normalize (inframe, outframe, 128.0, 1 / 128.0, MODEL_CHANNELS);
+}
+
+static gboolean
+run_normalize_face (GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  return gst_normalize_face (inframe, outframe, MODEL_CHANNELS);
+}
+
+static gboolean
+run_subtract_mean (GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  /* ResNet50 means */
+  return gst_subtract_mean (inframe, outframe, 123.68, 116.78, 103.94,
+      MODEL_CHANNELS);
+}
+
+static gboolean
+run_pixel_to_float (GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  return gst_pixel_to_float (inframe, outframe, MODEL_CHANNELS);
+}
+
+static gboolean
+run_normalize_with_lut (GstVideoFrame * inframe, GstVideoFrame * outframe)
+{
+  return gst_normalize_with_lut (inframe, outframe, lut, MODEL_CHANNELS);
+}
+
+static gboolean
+benchmark (const Function * function, GstVideoFormat format,
+    const Size * size, gint repeats)
+{
+  GstVideoInfo in_info, out_info;
+  GstVideoFrame inframe, outframe;
+  GstBuffer *inbuf, *outbuf;
+  GstMapInfo map;
+  gsize k, out_size, bytes;
+  gint64 start, elapsed, best = G_MAXINT64;
+  gint i, r, iterations, pixels;
+  gboolean ret = TRUE;
+
+  gst_video_info_set_format (&in_info, format, size->in_width,
+      size->in_height);
+  /* The output is only read as a float tensor of the model size */
+  gst_video_info_set_format (&out_info, GST_VIDEO_FORMAT_RGB,
+      size->out_width, size->out_height);
+  out_size = (gsize) size->out_width * size->out_height * MODEL_CHANNELS *
+      sizeof (gfloat);
+
+  inbuf = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&in_info),
+      NULL);
+  outbuf = gst_buffer_new_allocate (NULL, out_size, NULL);
+
+  /* A fixed pattern, so every run reads the same image */
+  gst_buffer_map (inbuf, &map, GST_MAP_WRITE);
+  for (k = 0; k < map.size; ++k) {
+    map.data[k] = (k * 7 + k / 251) & 0xff;
+  }
+  gst_buffer_unmap (inbuf, &map);
+
+  if (!gst_video_frame_map (&inframe, &in_info, inbuf, GST_MAP_READ)) {
+    g_printerr ("Could not map the %s input frame\n",
+        gst_video_format_to_string (format));
+    ret = FALSE;
+    goto out;
+  }
+  if (!gst_video_frame_map (&outframe, &out_info, outbuf, GST_MAP_WRITE)) {
+    g_printerr ("Could not map the output frame\n");
+    gst_video_frame_unmap (&inframe);
+    ret = FALSE;
+    goto out;
+  }
+
+  pixels = size->out_width * size->out_height;
+  iterations = MAX (PIXELS_PER_MEASUREMENT / pixels, 1);
+
+  /* Warm up the caches and the lazily initialized kernels */
+  ret = function->func (&inframe, &outframe);
+
+  for (r = 0; ret && r < repeats; ++r) {
+    start = g_get_monotonic_time ();
+    for (i = 0; i < iterations; ++i) {
+      function->func (&inframe, &outframe);
+    }
+    elapsed = g_get_monotonic_time () - start;
+    best = MIN (best, elapsed);
+  }
+
+  if (ret) {
+    gdouble seconds = best / (gdouble) G_USEC_PER_SEC / iterations;
+
+    bytes = GST_VIDEO_INFO_SIZE (&in_info) + out_size;
+    g_print ("%-15s %-5s %4dx%-4d %4dx%-4d %10.3f %10.3f\n", function->name,
+        gst_video_format_to_string (format), size->in_width, size->in_height,
+        size->out_width, size->out_height, seconds * 1e9 / pixels,
+        bytes / seconds / 1e9);
+  } else {
+    g_printerr ("%s failed on %s\n", function->name,
+        gst_video_format_to_string (format));
+  }
+
+  gst_video_frame_unmap (&outframe);
+  gst_video_frame_unmap (&inframe);
+
+out:
+  gst_buffer_unref (inbuf);
+  gst_buffer_unref (outbuf);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  gchar *function_filter = NULL;
+  gchar *format_filter = NULL;
+  gint repeats = DEFAULT_REPEATS;
+  gint threads = GST_PREPROCESS_DEFAULT_THREADS;
+  gint f, v, s;
+  gboolean ret = TRUE;
+  GOptionEntry entries[] = {
+    {"function", 'f', 0, G_OPTION_ARG_STRING, &function_filter,
+        "Only time this function, e.g. normalize", "NAME"},
+    {"format", 'p', 0, G_OPTION_ARG_STRING, &format_filter,
+        "Only time this pixel format, e.g. BGRx", "FORMAT"},
+    {"repeats", 'r', 0, G_OPTION_ARG_INT, &repeats,
+        "Measurements per case, the best one is reported", "N"},
+    {"threads", 't', 0, G_OPTION_ARG_INT, &threads,
+        "Preprocess threads, 0 for one per CPU", "N"},
+    {NULL}
+  };
+
+  context = g_option_context_new ("- time the preprocess functions");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    g_error_free (error);
+    g_option_context_free (context);
+    return 1;
+  }
+  g_option_context_free (context);
+
+  repeats = MAX (repeats, 1);
+  gst_preprocess_set_threads (MAX (threads, 0),
+      GST_PREPROCESS_DEFAULT_MIN_PIXELS);
+  lut = gst_normalize_lut_get (128.0, 128.0, 128.0, 1 / 128.0, 1 / 128.0,
+      1 / 128.0);
+
+  /* ns/pixel is per tensor pixel, GB/s counts the input frame read
+   * and the float tensor written.
+   */
+  g_print ("%-15s %-5s %-9s %-9s %10s %10s\n", "# function", "format",
+      "input", "output", "ns/pixel", "GB/s");
+
+  for (f = 0; f < G_N_ELEMENTS (functions); ++f) {
+    if (function_filter && g_strcmp0 (function_filter, functions[f].name)) {
+      continue;
+    }
+    for (v = 0; v < G_N_ELEMENTS (formats); ++v) {
+      if (format_filter && g_strcmp0 (format_filter,
+              gst_video_format_to_string (formats[v]))) {
+        continue;
+      }
+      for (s = 0; s < G_N_ELEMENTS (sizes); ++s) {
+        ret &= benchmark (&functions[f], formats[v], &sizes[s], repeats);
+      }
+    }
+  }
+
+  gst_normalize_lut_unref (lut);
+  g_free (function_filter);
+  g_free (format_filter);
+
+  return ret ? 0 : 1;
+}
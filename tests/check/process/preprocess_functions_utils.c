@@ -21,6 +21,8 @@
 
 #include "preprocess_functions_utils.h"
 
+#include <string.h>
+
 void
 gst_check_output_pixels (GstVideoFrame * outframe, gfloat expected_value_red,
     gfloat expected_value_green, gfloat expected_value_blue, gint first_index,
@@ -74,10 +76,11 @@ gst_create_test_frames (GstVideoFrame * inframe, GstVideoFrame * outframe,
   gboolean ret = FALSE;
   GstAllocationParams params;
   GstMapFlags flags;
-  guint pixel_stride;
+  guint stride;
   guint channels;
   gint frame_width;
   gint frame_height;
+  guchar *pixel;
 
   GstVideoInfo *info = gst_video_info_new ();
   GstBuffer *buffer = gst_buffer_new ();
@@ -112,23 +115,191 @@ gst_create_test_frames (GstVideoFrame * inframe, GstVideoFrame * outframe,
   fail_if (ret == FALSE);
 
   channels = GST_VIDEO_FRAME_COMP_PSTRIDE (inframe, 0);
-  pixel_stride = GST_VIDEO_FRAME_COMP_STRIDE (inframe, 0) / channels;
+  stride = GST_VIDEO_FRAME_PLANE_STRIDE (inframe, 0);
   frame_width = GST_VIDEO_FRAME_WIDTH (inframe);
   frame_height = GST_VIDEO_FRAME_HEIGHT (inframe);
 
   fail_if (frame_width == 0);
   fail_if (frame_height == 0);
 
+  /* Rows may be padded, they start every stride bytes */
   for (gint i = 0; i < frame_height; ++i) {
     for (gint j = 0; j < frame_width; ++j) {
-      ((guchar *) inframe->data[0])[(i * pixel_stride + j) * channels + 0 +
-          offset] = value_red;
-      ((guchar *) inframe->data[0])[(i * pixel_stride + j) * channels + 1 +
-          offset] = value_green;
-      ((guchar *) inframe->data[0])[(i * pixel_stride + j) * channels + 2 +
-          offset] = value_blue;
+      pixel = (guchar *) inframe->data[0] + i * stride + j * channels + offset;
+      pixel[0] = value_red;
+      pixel[1] = value_green;
+      pixel[2] = value_blue;
+    }
+  }
+  gst_video_info_free (info);
+  gst_video_frame_unmap (inframe);
+  gst_video_frame_unmap (outframe);
+}
+
+void
+gst_create_test_scaled_frame (GstVideoFrame * outframe, gint width,
+    gint height, GstVideoFormat format)
+{
+  gboolean ret = FALSE;
+  GstAllocationParams params;
+  GstMapFlags flags;
+  GstBuffer *buffer_out;
+  GstVideoInfo *info = gst_video_info_new ();
+
+  fail_if (outframe == NULL);
+
+  gst_video_info_init (info);
+  gst_video_info_set_format (info, format, width, height);
+
+  /* Room for one float per pixel component, at a size other than the input */
+  gst_allocation_params_init (&params);
+  buffer_out =
+      gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (info) * sizeof (float),
+      &params);
+
+  fail_if (buffer_out == NULL);
+
+  flags = (GstMapFlags) (GST_MAP_WRITE | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
+
+  ret = gst_video_frame_map (outframe, info, buffer_out, flags);
+
+  fail_if (ret == FALSE);
+
+  gst_video_info_free (info);
+  gst_video_frame_unmap (outframe);
+}
+
+void
+gst_create_test_yuv_frames (GstVideoFrame * inframe, GstVideoFrame * outframe,
+    guchar value_y, guchar value_u, guchar value_v, gint width, gint height,
+    GstVideoFormat format)
+{
+  gboolean ret = FALSE;
+  GstAllocationParams params;
+  GstMapFlags flags;
+  GstBuffer *buffer;
+  GstBuffer *buffer_out;
+  guchar *data;
+  const guchar values[3] = { value_y, value_u, value_v };
+  GstVideoInfo *info = gst_video_info_new ();
+
+  fail_if (inframe == NULL);
+  fail_if (outframe == NULL);
+
+  gst_video_info_init (info);
+  gst_video_info_set_format (info, format, width, height);
+
+  /* Room for the three float channels of every pixel */
+  gst_allocation_params_init (&params);
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (info), &params);
+  buffer_out =
+      gst_buffer_new_allocate (NULL, width * height * 3 * sizeof (float),
+      &params);
+
+  fail_if (buffer == NULL);
+  fail_if (buffer_out == NULL);
+
+  flags = (GstMapFlags) (GST_MAP_WRITE | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
+
+  ret = gst_video_frame_map (inframe, info, buffer, flags);
+
+  fail_if (ret == FALSE);
+
+  ret = gst_video_frame_map (outframe, info, buffer_out, flags);
+
+  fail_if (ret == FALSE);
+
+  for (gint c = 0; c < 3; ++c) {
+    data = GST_VIDEO_FRAME_COMP_DATA (inframe, c);
+    for (gint i = 0; i < GST_VIDEO_FRAME_COMP_HEIGHT (inframe, c); ++i) {
+      for (gint j = 0; j < GST_VIDEO_FRAME_COMP_WIDTH (inframe, c); ++j) {
+        data[i * GST_VIDEO_FRAME_COMP_STRIDE (inframe, c) +
+            j * GST_VIDEO_FRAME_COMP_PSTRIDE (inframe, c)] = values[c];
+      }
     }
   }
+
+  gst_video_info_free (info);
+  gst_video_frame_unmap (inframe);
+  gst_video_frame_unmap (outframe);
+}
+
+void
+gst_create_test_padded_frames (GstVideoFrame * inframe,
+    GstVideoFrame * outframe, guchar value_0, guchar value_1, guchar value_2,
+    gint width, gint height, gint padding, GstVideoFormat format)
+{
+  gboolean ret = FALSE;
+  GstAllocationParams params;
+  GstMapFlags flags;
+  GstBuffer *buffer;
+  GstBuffer *buffer_out;
+  GstMapInfo map;
+  guchar *data;
+  gsize offsets[GST_VIDEO_MAX_PLANES];
+  gint strides[GST_VIDEO_MAX_PLANES];
+  gsize size, end;
+  guint planes;
+  const guchar values[3] = { value_0, value_1, value_2 };
+  GstVideoInfo *info = gst_video_info_new ();
+
+  fail_if (inframe == NULL);
+  fail_if (outframe == NULL);
+
+  gst_video_info_init (info);
+  gst_video_info_set_format (info, format, width, height);
+
+  /* Every plane starts after some padding bytes and its rows are padded
+   * as well, as hardware buffers described by a GstVideoMeta may be.
+   */
+  planes = GST_VIDEO_INFO_N_PLANES (info);
+  size = padding;
+  for (guint p = 0; p < planes; ++p) {
+    end = p + 1 < planes ? GST_VIDEO_INFO_PLANE_OFFSET (info, p + 1) :
+        GST_VIDEO_INFO_SIZE (info);
+    offsets[p] = size;
+    strides[p] = GST_VIDEO_INFO_PLANE_STRIDE (info, p) + padding;
+    size += strides[p] * ((end - GST_VIDEO_INFO_PLANE_OFFSET (info, p)) /
+        GST_VIDEO_INFO_PLANE_STRIDE (info, p)) + padding;
+  }
+
+  gst_allocation_params_init (&params);
+  buffer = gst_buffer_new_allocate (NULL, size, &params);
+  buffer_out =
+      gst_buffer_new_allocate (NULL, width * height * 3 * sizeof (float),
+      &params);
+
+  fail_if (buffer == NULL);
+  fail_if (buffer_out == NULL);
+
+  /* The padding must never be read */
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, 0xff, map.size);
+  gst_buffer_unmap (buffer, &map);
+
+  gst_buffer_add_video_meta_full (buffer, GST_VIDEO_FRAME_FLAG_NONE, format,
+      width, height, planes, offsets, strides);
+
+  flags = (GstMapFlags) (GST_MAP_WRITE | GST_VIDEO_FRAME_MAP_FLAG_NO_REF);
+
+  ret = gst_video_frame_map (inframe, info, buffer, flags);
+
+  fail_if (ret == FALSE);
+
+  ret = gst_video_frame_map (outframe, info, buffer_out, flags);
+
+  fail_if (ret == FALSE);
+
+  for (gint c = 0; c < 3; ++c) {
+    data = GST_VIDEO_FRAME_COMP_DATA (inframe, c);
+    for (gint i = 0; i < GST_VIDEO_FRAME_COMP_HEIGHT (inframe, c); ++i) {
+      for (gint j = 0; j < GST_VIDEO_FRAME_COMP_WIDTH (inframe, c); ++j) {
+        data[i * GST_VIDEO_FRAME_COMP_STRIDE (inframe, c) +
+            j * GST_VIDEO_FRAME_COMP_PSTRIDE (inframe, c)] = values[c];
+      }
+    }
+  }
+
   gst_video_info_free (info);
   gst_video_frame_unmap (inframe);
   gst_video_frame_unmap (outframe);
@@ -29,6 +29,17 @@ void gst_create_test_frames (GstVideoFrame * inframe,
     GstVideoFrame * outframe, guchar value_red, guchar value_green, guchar value_blue, gint buffer_size, gint width,
     gint height, gint offset, GstVideoFormat format);
 
+void gst_create_test_scaled_frame (GstVideoFrame * outframe, gint width,
+    gint height, GstVideoFormat format);
+
+void gst_create_test_yuv_frames (GstVideoFrame * inframe,
+    GstVideoFrame * outframe, guchar value_y, guchar value_u, guchar value_v,
+    gint width, gint height, GstVideoFormat format);
+
+void gst_create_test_padded_frames (GstVideoFrame * inframe,
+    GstVideoFrame * outframe, guchar value_0, guchar value_1, guchar value_2,
+    gint width, gint height, gint padding, GstVideoFormat format);
+
 void gst_check_output_pixels (GstVideoFrame * outframe,
     gfloat expected_value_red, gfloat expected_value_green,
     gfloat expected_value_blue, gint first_index, gint last_index,
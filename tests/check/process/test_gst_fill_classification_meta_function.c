@@ -21,18 +21,21 @@
 #include <gst/check/gstcheck.h>
 #include "gst/r2inference/gstinferencepostprocess.h"
 #include "gst/r2inference/gstinferencemeta.h"
+#include <math.h>
 
 GST_START_TEST (test_gst_fill_classification_meta)
 {
   GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
   gpointer prediction;
   gsize predsize;
   gfloat values[2] = { 0.15, 0.75 };
 
   prediction = values;
   predsize = sizeof (values);
-  class_meta =
-      (GstClassificationMeta *) gst_classification_meta_api_get_type ();
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
 
   gst_fill_classification_meta (class_meta, prediction, predsize);
 
@@ -41,6 +44,8 @@ GST_START_TEST (test_gst_fill_classification_meta)
   for (gint i = 0; i < class_meta->num_labels; i++) {
     fail_if (class_meta->label_probs[i] != values[i]);
   }
+
+  gst_buffer_unref (buffer);
 }
 
 GST_END_TEST;
@@ -48,18 +53,22 @@ GST_END_TEST;
 GST_START_TEST (test_gst_fill_classification_meta_zero_size)
 {
   GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
   gpointer prediction;
   gsize predsize;
   gfloat values[2] = { 0.15, 0.75 };
 
   prediction = values;
   predsize = 0;
-  class_meta =
-      (GstClassificationMeta *) gst_classification_meta_api_get_type ();
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
 
   gst_fill_classification_meta (class_meta, prediction, predsize);
 
   fail_if (class_meta->num_labels != 0);
+
+  gst_buffer_unref (buffer);
 }
 
 GST_END_TEST;
@@ -81,13 +90,250 @@ GST_END_TEST;
 GST_START_TEST (test_gst_fill_classification_meta_null_predictions)
 {
   GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
   gsize predsize;
 
   predsize = 2;
-  class_meta =
-      (GstClassificationMeta *) gst_classification_meta_api_get_type ();
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
 
   ASSERT_CRITICAL (gst_fill_classification_meta (class_meta, NULL, predsize));
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_fill_classification_meta_top_k)
+{
+  GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
+  gfloat values[8] = { 0.05, 0.30, 0.01, 0.25, 0.02, 0.20, 0.07, 0.10 };
+  gint labels[3] = { 1, 3, 5 };
+
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
+
+  fail_unless (gst_fill_classification_meta_top_k (class_meta, values,
+          sizeof (values), 3));
+
+  fail_unless_equals_int (class_meta->num_labels, 0);
+  fail_unless (class_meta->label_probs == NULL);
+  fail_unless_equals_int (class_meta->num_top, 3);
+  for (gint i = 0; i < class_meta->num_top; i++) {
+    fail_unless_equals_int (class_meta->top[i].label, labels[i]);
+    fail_unless_equals_float (class_meta->top[i].prob, values[labels[i]]);
+  }
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_fill_classification_meta_top_k_ties)
+{
+  GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
+  gfloat values[5] = { 0.5, NAN, 0.1, 0.5, 0.1 };
+  gint labels[4] = { 0, 3, 2, 4 };
+
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
+
+  /* Ties keep the lower label first and NaN is left out */
+  fail_unless (gst_fill_classification_meta_top_k (class_meta, values,
+          sizeof (values), 5));
+
+  fail_unless_equals_int (class_meta->num_top, 4);
+  for (gint i = 0; i < class_meta->num_top; i++) {
+    fail_unless_equals_int (class_meta->top[i].label, labels[i]);
+  }
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_fill_classification_meta_top_k_zero)
+{
+  GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
+  gfloat values[2] = { 0.15, 0.75 };
+
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
+
+  /* No top labels, the probability of every label is kept */
+  fail_unless (gst_fill_classification_meta_top_k (class_meta, values,
+          sizeof (values), 0));
+
+  fail_unless_equals_int (class_meta->num_top, 0);
+  fail_unless_equals_int (class_meta->num_labels, 2);
+  for (gint i = 0; i < class_meta->num_labels; i++) {
+    fail_unless_equals_float (class_meta->label_probs[i], values[i]);
+  }
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_fill_classification_meta_top_k_copy)
+{
+  GstClassificationMeta *class_meta, *copy_meta;
+  GstBuffer *buffer, *copy;
+  gfloat values[4] = { 0.1, 0.4, 0.3, 0.2 };
+
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
+  class_meta->box_index = 2;
+
+  fail_unless (gst_fill_classification_meta_top_k (class_meta, values,
+          sizeof (values), 2));
+
+  copy = gst_buffer_copy (buffer);
+  copy_meta = (GstClassificationMeta *) gst_buffer_get_meta (copy,
+      GST_CLASSIFICATION_META_API_TYPE);
+
+  fail_unless (copy_meta != NULL);
+  fail_unless_equals_int (copy_meta->box_index, 2);
+  fail_unless_equals_int (copy_meta->num_labels, 0);
+  fail_unless (copy_meta->label_probs == NULL);
+  fail_unless_equals_int (copy_meta->num_top, 2);
+  fail_unless_equals_int (copy_meta->top[0].label, 1);
+  fail_unless_equals_int (copy_meta->top[1].label, 2);
+
+  gst_buffer_unref (copy);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_fill_classification_meta_top_k_too_large)
+{
+  GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
+  gfloat values[2] = { 0.15, 0.75 };
+
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
+
+  ASSERT_CRITICAL (gst_fill_classification_meta_top_k (class_meta, values,
+          sizeof (values), GST_CLASSIFICATION_META_MAX_TOP + 1));
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+/* Labels of the ImageNet models, more than one block of the selection */
+#define MANY_LABELS 1001
+
+/* Orders labels by decreasing probability and increasing label */
+static gint
+compare_labels (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const gfloat *values = (const gfloat *) user_data;
+  gint label_a = *(const gint *) a;
+  gint label_b = *(const gint *) b;
+
+  if (values[label_a] != values[label_b]) {
+    return values[label_a] > values[label_b] ? -1 : 1;
+  }
+  return label_a - label_b;
+}
+
+GST_START_TEST (test_gst_fill_classification_meta_top_k_many_labels)
+{
+  GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
+  gfloat values[MANY_LABELS];
+  gint labels[MANY_LABELS];
+  /* The first and last labels of blocks, and the last label */
+  gint edges[] = { 15, 16, 31, 32, 495, 496, 991, 992, 1000 };
+  gint top_k[] = { 1, 5, GST_CLASSIFICATION_META_MAX_TOP };
+  guint32 seed = 1;
+  gint num_labels;
+
+  for (gint run = 0; run < 60; run++) {
+    gint k = top_k[run % G_N_ELEMENTS (top_k)];
+
+    /* Few distinct values, so most of the top labels are ties */
+    for (gint i = 0; i < MANY_LABELS; i++) {
+      seed = seed * 1103515245 + 12345;
+      values[i] = ((seed >> 16) % 32) / 32.0;
+    }
+    /* Every third run ties or hides the highest values on block edges */
+    for (gint i = 0; i < G_N_ELEMENTS (edges); i++) {
+      if (run % 3 == 1) {
+        values[edges[i]] = 1;
+      } else if (run % 3 == 2) {
+        values[edges[i]] = (i % 2) ? NAN : 1;
+      }
+    }
+
+    num_labels = 0;
+    for (gint i = 0; i < MANY_LABELS; i++) {
+      if (!isnan (values[i])) {
+        labels[num_labels++] = i;
+      }
+    }
+    g_qsort_with_data (labels, num_labels, sizeof (gint), compare_labels,
+        values);
+
+    buffer = gst_buffer_new ();
+    class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+        GST_CLASSIFICATION_META_INFO, NULL);
+
+    fail_unless (gst_fill_classification_meta_top_k (class_meta, values,
+            sizeof (values), k));
+
+    fail_unless_equals_int (class_meta->num_top, k);
+    for (gint i = 0; i < k; i++) {
+      fail_unless_equals_int (class_meta->top[i].label, labels[i]);
+      fail_unless_equals_float (class_meta->top[i].prob, values[labels[i]]);
+    }
+
+    gst_buffer_unref (buffer);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_fill_classification_meta_refill)
+{
+  GstClassificationMeta *class_meta;
+  GstBuffer *buffer;
+  gfloat values[4] = { 0.1, 0.4, 0.3, 0.2 };
+
+  buffer = gst_buffer_new ();
+  class_meta = (GstClassificationMeta *) gst_buffer_add_meta (buffer,
+      GST_CLASSIFICATION_META_INFO, NULL);
+
+  /* Each fill replaces what the previous one left in the meta */
+  fail_unless (gst_fill_classification_meta_top_k (class_meta, values,
+          sizeof (values), 2));
+  fail_unless (gst_fill_classification_meta (class_meta, values,
+          sizeof (values)));
+
+  fail_unless_equals_int (class_meta->num_top, 0);
+  fail_unless_equals_int (class_meta->num_labels, 4);
+
+  fail_unless (gst_fill_classification_meta_top_k (class_meta, values,
+          sizeof (values), 1));
+
+  fail_unless_equals_int (class_meta->num_labels, 0);
+  fail_unless (class_meta->label_probs == NULL);
+  fail_unless_equals_int (class_meta->num_top, 1);
+  fail_unless_equals_int (class_meta->top[0].label, 1);
+
+  gst_buffer_unref (buffer);
 }
 
 GST_END_TEST;
@@ -104,6 +350,13 @@ gst_fill_classification_meta_suite (void)
   tcase_add_test (tc, test_gst_fill_classification_meta_zero_size);
   tcase_add_test (tc, test_gst_fill_classification_meta_null_meta);
   tcase_add_test (tc, test_gst_fill_classification_meta_null_predictions);
+  tcase_add_test (tc, test_gst_fill_classification_meta_top_k);
+  tcase_add_test (tc, test_gst_fill_classification_meta_top_k_ties);
+  tcase_add_test (tc, test_gst_fill_classification_meta_top_k_zero);
+  tcase_add_test (tc, test_gst_fill_classification_meta_top_k_copy);
+  tcase_add_test (tc, test_gst_fill_classification_meta_top_k_too_large);
+  tcase_add_test (tc, test_gst_fill_classification_meta_top_k_many_labels);
+  tcase_add_test (tc, test_gst_fill_classification_meta_refill);
 
   return suite;
 }
@@ -0,0 +1,254 @@
+/*
+ * GStreamer
+ * Copyright (C) 2019 RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <math.h>
+#include "preprocess_functions_utils.c"
+#include "gst/r2inference/gstinferencepreprocess.h"
+
+static void
+check_output_pixels_near (GstVideoFrame * outframe, gfloat expected_value_red,
+    gfloat expected_value_green, gfloat expected_value_blue, gint first_index,
+    gint last_index, gint model_channels)
+{
+  gfloat *out = (gfloat *) outframe->data[0];
+  gint pixels = GST_VIDEO_FRAME_WIDTH (outframe) *
+      GST_VIDEO_FRAME_HEIGHT (outframe);
+
+  for (gint i = 0; i < pixels; ++i) {
+    fail_if (fabs (out[i * model_channels + first_index] -
+            expected_value_red) > 1e-5);
+    fail_if (fabs (out[i * model_channels + 1] - expected_value_green) >
+        1e-5);
+    fail_if (fabs (out[i * model_channels + last_index] -
+            expected_value_blue) > 1e-5);
+  }
+}
+
+GST_START_TEST (test_gst_normalize_face_RGB)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, buffer_size, first_index, last_index, offset,
+      model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  GstVideoFormat format;
+  gdouble std;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 24;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGB;
+  offset = 0;
+
+  /* Mean 150, variance (50^2 + 50^2 + 0^2) / 3 */
+  std = 1 / sqrt (5000 / 3.0);
+  first_index = 0;
+  last_index = 2;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  fail_if (!gst_normalize_face (&inframe, &outframe, model_channels));
+
+  check_output_pixels_near (&outframe, 50 * std, -50 * std, 0, first_index,
+      last_index, model_channels);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_face_xBGR)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, buffer_size, first_index, last_index, offset,
+      model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  GstVideoFormat format;
+  gdouble std;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 32;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_xBGR;
+  offset = 1;
+
+  /* The padding byte is not part of the statistics */
+  std = 1 / sqrt (5000 / 3.0);
+  first_index = 2;
+  last_index = 0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  fail_if (!gst_normalize_face (&inframe, &outframe, model_channels));
+
+  check_output_pixels_near (&outframe, 50 * std, -50 * std, 0, first_index,
+      last_index, model_channels);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_face_flat)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, buffer_size, first_index, last_index, offset,
+      model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  GstVideoFormat format;
+
+  frame_pixel_value_red = 100;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 100;
+  buffer_size = 24;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGB;
+  offset = 0;
+  first_index = 0;
+  last_index = 2;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  /* No variance, the output must still be finite */
+  fail_if (!gst_normalize_face (&inframe, &outframe, model_channels));
+
+  gst_check_output_pixels (&outframe, 0, 0, 0, first_index, last_index,
+      model_channels);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_face_scaled)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, buffer_size, offset, model_channels, size;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  guchar *pixel;
+  GstVideoFormat format;
+  gdouble sum, sumsq, mean, variance;
+  gfloat *out;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 24;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGB;
+  offset = 0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+  gst_create_test_scaled_frame (&outframe, 7, 5, format);
+
+  /* A different second row, so the rows interpolated in between change
+   * the statistics of the tensor from those of the input
+   */
+  for (gint j = 0; j < width; ++j) {
+    pixel = (guchar *) GST_VIDEO_FRAME_PLANE_DATA (&inframe, 0) +
+        GST_VIDEO_FRAME_PLANE_STRIDE (&inframe, 0) + j * 3;
+    pixel[0] = 0;
+    pixel[1] = 50;
+    pixel[2] = 250;
+  }
+
+  fail_if (!gst_normalize_face (&inframe, &outframe, model_channels));
+
+  /* The whole tensor is prewhitened, not the input */
+  out = (gfloat *) outframe.data[0];
+  size = 7 * 5 * model_channels;
+  sum = 0;
+  sumsq = 0;
+  for (gint i = 0; i < size; ++i) {
+    sum += out[i];
+    sumsq += out[i] * out[i];
+  }
+  mean = sum / size;
+  variance = sumsq / size - mean * mean;
+
+  fail_if (fabs (mean) > 1e-4);
+  fail_if (fabs (variance - 1) > 1e-4);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_face_null_inframe)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, buffer_size, offset, model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  GstVideoFormat format;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 24;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGB;
+  offset = 0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  ASSERT_CRITICAL (gst_normalize_face (NULL, &outframe, model_channels));
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_normalize_face_suite (void)
+{
+  Suite *suite = suite_create ("GstInference");
+  TCase *tc = tcase_create ("gst_normalize_face");
+
+  suite_add_tcase (suite, tc);
+
+  tcase_add_test (tc, test_gst_normalize_face_RGB);
+  tcase_add_test (tc, test_gst_normalize_face_xBGR);
+  tcase_add_test (tc, test_gst_normalize_face_flat);
+  tcase_add_test (tc, test_gst_normalize_face_scaled);
+  tcase_add_test (tc, test_gst_normalize_face_null_inframe);
+
+  return suite;
+}
+
+GST_CHECK_MAIN (gst_normalize_face);
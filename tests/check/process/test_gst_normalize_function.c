@@ -21,6 +21,7 @@
 #include <gst/check/gstcheck.h>
 #include "preprocess_functions_utils.c"
 #include "gst/r2inference/gstinferencepreprocess.h"
+#include "gst/r2inference/gstinferencemeta.h"
 
 GST_START_TEST (test_gst_normalize_RGBA)
 {
@@ -1221,6 +1222,374 @@ GST_START_TEST (test_gst_normalize_zero_mean_null_outframe)
 
 GST_END_TEST;
 
+GST_START_TEST (test_gst_normalize_scaled)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, buffer_size, first_index, last_index, offset,
+      model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+  gfloat expected_value_red, expected_value_green, expected_value_blue;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 32;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGBA;
+  offset = 0;
+
+  mean = 0;
+  std = 1 / 255.0;
+
+  expected_value_red = 200.0 / 255.0;
+  expected_value_green = 100.0 / 255.0;
+  expected_value_blue = 150.0 / 255.0;
+  first_index = 0;
+  last_index = 2;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+  gst_create_test_scaled_frame (&outframe, 7, 5, format);
+
+  fail_if (!gst_normalize (&inframe, &outframe, mean, std, model_channels));
+
+  gst_check_output_pixels (&outframe, expected_value_red, expected_value_green,
+      expected_value_blue, first_index, last_index, model_channels);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_letterbox)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstVideoCropMeta *crop;
+  gint width, height, buffer_size, offset, model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+  gfloat expected_value_red, expected_value_pad, out_value;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 32;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGBA;
+  offset = 0;
+
+  mean = 128;
+  std = 1 / 128.0;
+
+  expected_value_red = (200.0 - 128.0) / 128.0;
+  expected_value_pad = -1;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+  gst_create_test_scaled_frame (&outframe, 8, 8, format);
+
+  /* A 4x2 image fits an 8x8 tensor in its 4 middle rows */
+  crop = gst_buffer_add_video_crop_meta (outframe.buffer);
+  crop->x = 0;
+  crop->y = 2;
+  crop->width = 8;
+  crop->height = 4;
+
+  fail_if (!gst_normalize (&inframe, &outframe, mean, std, model_channels));
+
+  for (gint i = 0; i < 8; ++i) {
+    for (gint j = 0; j < 8; ++j) {
+      out_value = ((gfloat *) outframe.data[0])[(i * 8 + j) * model_channels];
+      if (i < 2 || i >= 6) {
+        fail_if (out_value != expected_value_pad);
+      } else {
+        fail_if (out_value != expected_value_red);
+      }
+    }
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_invalid_crop)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstVideoCropMeta *crop;
+  gint width, height, buffer_size, offset, model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 32;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGBA;
+  offset = 0;
+
+  mean = 128;
+  std = 1 / 128.0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+  gst_create_test_scaled_frame (&outframe, 8, 8, format);
+
+  /* The region goes past the bottom of the tensor, nothing is written */
+  crop = gst_buffer_add_video_crop_meta (outframe.buffer);
+  crop->x = 0;
+  crop->y = 6;
+  crop->width = 8;
+  crop->height = 4;
+
+  ASSERT_CRITICAL (fail_if (gst_normalize (&inframe, &outframe, mean, std,
+              model_channels)));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_planar)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstInferenceTensorMeta *tensor_meta;
+  gint width, height, buffer_size, offset, model_channels, plane;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+  gfloat expected_value_red, expected_value_green, expected_value_blue;
+  gfloat *out;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 64;
+  width = 8;
+  height = 2;
+  format = GST_VIDEO_FORMAT_BGRx;
+  offset = 0;
+
+  mean = 0;
+  std = 1 / 255.0;
+
+  expected_value_red = 200.0 / 255.0;
+  expected_value_green = 100.0 / 255.0;
+  expected_value_blue = 150.0 / 255.0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_blue,
+      frame_pixel_value_green, frame_pixel_value_red, buffer_size, width,
+      height, offset, format);
+
+  tensor_meta = (GstInferenceTensorMeta *) gst_buffer_add_meta
+      (outframe.buffer, GST_INFERENCE_TENSOR_META_INFO, NULL);
+  tensor_meta->layout = GST_INFERENCE_TENSOR_LAYOUT_NCHW;
+
+  fail_if (!gst_normalize (&inframe, &outframe, mean, std, model_channels));
+
+  /* Red, green and blue planes one after the other */
+  out = (gfloat *) outframe.data[0];
+  plane = width * height;
+  for (gint i = 0; i < plane; ++i) {
+    fail_if (out[i] != expected_value_red);
+    fail_if (out[plane + i] != expected_value_green);
+    fail_if (out[2 * plane + i] != expected_value_blue);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_uint8)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstInferenceTensorMeta *tensor_meta;
+  gint width, height, buffer_size, offset, model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+  guint8 *out;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 64;
+  width = 8;
+  height = 2;
+  format = GST_VIDEO_FORMAT_BGRx;
+  offset = 0;
+
+  mean = 0;
+  std = 1 / 255.0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_blue,
+      frame_pixel_value_green, frame_pixel_value_red, buffer_size, width,
+      height, offset, format);
+
+  /* Quantized back to the original pixel values */
+  tensor_meta = (GstInferenceTensorMeta *) gst_buffer_add_meta
+      (outframe.buffer, GST_INFERENCE_TENSOR_META_INFO, NULL);
+  tensor_meta->type = GST_INFERENCE_TENSOR_TYPE_UINT8;
+  tensor_meta->scale = 1 / 255.0;
+  tensor_meta->zero_point = 0;
+
+  fail_if (!gst_normalize (&inframe, &outframe, mean, std, model_channels));
+
+  out = (guint8 *) outframe.data[0];
+  for (gint i = 0; i < width * height; ++i) {
+    fail_if (out[i * model_channels + 0] != frame_pixel_value_red);
+    fail_if (out[i * model_channels + 1] != frame_pixel_value_green);
+    fail_if (out[i * model_channels + 2] != frame_pixel_value_blue);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_uint8_zero_scale)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstInferenceTensorMeta *tensor_meta;
+  gint width, height, buffer_size, offset, model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 64;
+  width = 8;
+  height = 2;
+  format = GST_VIDEO_FORMAT_BGRx;
+  offset = 0;
+
+  mean = 0;
+  std = 1 / 255.0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_blue,
+      frame_pixel_value_green, frame_pixel_value_red, buffer_size, width,
+      height, offset, format);
+
+  /* Values are divided by the scale, it can't be zero */
+  tensor_meta = (GstInferenceTensorMeta *) gst_buffer_add_meta
+      (outframe.buffer, GST_INFERENCE_TENSOR_META_INFO, NULL);
+  tensor_meta->type = GST_INFERENCE_TENSOR_TYPE_UINT8;
+  tensor_meta->scale = 0;
+  tensor_meta->zero_point = 0;
+
+  ASSERT_CRITICAL (fail_if (gst_normalize (&inframe, &outframe, mean, std,
+              model_channels)));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_padded)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, padding, model_channels;
+  gint first_index, last_index;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+  gfloat expected_value_red, expected_value_green, expected_value_blue;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  width = 5;
+  height = 3;
+  padding = 12;
+  format = GST_VIDEO_FORMAT_BGRx;
+
+  mean = 0;
+  std = 1 / 255.0;
+
+  expected_value_red = 200.0 / 255.0;
+  expected_value_green = 100.0 / 255.0;
+  expected_value_blue = 150.0 / 255.0;
+  model_channels = 3;
+  first_index = 0;
+  last_index = 2;
+
+  gst_create_test_padded_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, width, height, padding,
+      format);
+
+  fail_if (!gst_normalize (&inframe, &outframe, mean, std, model_channels));
+
+  gst_check_output_pixels (&outframe, expected_value_red,
+      expected_value_green, expected_value_blue, first_index, last_index,
+      model_channels);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_threads)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, buffer_size, offset, model_channels;
+  gint first_index, last_index;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+  gfloat expected_value_red, expected_value_green, expected_value_blue;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 32 * 8 * 4;
+  width = 32;
+  height = 8;
+  format = GST_VIDEO_FORMAT_RGBx;
+  offset = 0;
+
+  mean = 0;
+  std = 1 / 255.0;
+
+  expected_value_red = 200.0 / 255.0;
+  expected_value_green = 100.0 / 255.0;
+  expected_value_blue = 150.0 / 255.0;
+  model_channels = 3;
+  first_index = 0;
+  last_index = 2;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  /* Split in bands of two rows */
+  gst_preprocess_set_threads (4, 2 * width);
+
+  fail_if (!gst_normalize (&inframe, &outframe, mean, std, model_channels));
+
+  gst_preprocess_set_threads (GST_PREPROCESS_DEFAULT_THREADS,
+      GST_PREPROCESS_DEFAULT_MIN_PIXELS);
+
+  gst_check_output_pixels (&outframe, expected_value_red,
+      expected_value_green, expected_value_blue, first_index, last_index,
+      model_channels);
+}
+
+GST_END_TEST;
+
 static Suite *
 gst_normalize_suite (void)
 {
@@ -1242,6 +1611,14 @@ gst_normalize_suite (void)
   tcase_add_test (tc, test_gst_normalize_invalid_format);
   tcase_add_test (tc, test_gst_normalize_odd_width);
   tcase_add_test (tc, test_gst_normalize_odd_height);
+  tcase_add_test (tc, test_gst_normalize_scaled);
+  tcase_add_test (tc, test_gst_normalize_letterbox);
+  tcase_add_test (tc, test_gst_normalize_invalid_crop);
+  tcase_add_test (tc, test_gst_normalize_planar);
+  tcase_add_test (tc, test_gst_normalize_uint8);
+  tcase_add_test (tc, test_gst_normalize_uint8_zero_scale);
+  tcase_add_test (tc, test_gst_normalize_padded);
+  tcase_add_test (tc, test_gst_normalize_threads);
   tcase_add_test (tc, test_gst_normalize_null_inframe);
   tcase_add_test (tc, test_gst_normalize_null_outframe);
   tcase_add_test (tc, test_gst_normalize_zero_mean_RGBA);
@@ -0,0 +1,287 @@
+/*
+ * GStreamer
+ * Copyright (C) 2019 RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <math.h>
+#include "preprocess_functions_utils.c"
+#include "gst/r2inference/gstinferencepreprocess.h"
+
+GST_START_TEST (test_gst_normalize_with_lut_RGBA)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstNormalizeLut *lut;
+  gint width, height, buffer_size, first_index, last_index, offset,
+      model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+  gfloat expected_value_red, expected_value_green, expected_value_blue;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 32;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGBA;
+  offset = 0;
+
+  mean = 0;
+  std = 1 / 255.0;
+
+  expected_value_red = 200.0 / 255.0;
+  expected_value_green = 100.0 / 255.0;
+  expected_value_blue = 150.0 / 255.0;
+  first_index = 0;
+  last_index = 2;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  lut = gst_normalize_lut_get (mean, mean, mean, std, std, std);
+  fail_if (!gst_normalize_with_lut (&inframe, &outframe, lut, model_channels));
+  gst_normalize_lut_unref (lut);
+
+  gst_check_output_pixels (&outframe, expected_value_red, expected_value_green,
+      expected_value_blue, first_index, last_index, model_channels);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_with_lut_BGR)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstNormalizeLut *lut;
+  gint width, height, buffer_size, first_index, last_index, offset,
+      model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean_red, mean_green, mean_blue, std;
+  GstVideoFormat format;
+  gfloat expected_value_red, expected_value_green, expected_value_blue;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 24;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_BGR;
+  offset = 0;
+
+  mean_red = 123.68;
+  mean_green = 116.78;
+  mean_blue = 103.94;
+  std = 1;
+
+  expected_value_red = 200 - 123.68;
+  expected_value_green = 100 - 116.78;
+  expected_value_blue = 150 - 103.94;
+  first_index = 2;
+  last_index = 0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  lut = gst_normalize_lut_get (mean_red, mean_green, mean_blue, std, std, std);
+  fail_if (!gst_normalize_with_lut (&inframe, &outframe, lut, model_channels));
+  gst_normalize_lut_unref (lut);
+
+  gst_check_output_pixels (&outframe, expected_value_red, expected_value_green,
+      expected_value_blue, first_index, last_index, model_channels);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_with_lut_xRGB)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstNormalizeLut *lut;
+  gint width, height, buffer_size, first_index, last_index, offset,
+      model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  gdouble mean, std;
+  GstVideoFormat format;
+  gfloat expected_value_red, expected_value_green, expected_value_blue;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 32;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_xRGB;
+  offset = 1;
+
+  mean = 128;
+  std = 1 / 128.0;
+
+  expected_value_red = (200.0 - 128.0) / 128.0;
+  expected_value_green = (100.0 - 128.0) / 128.0;
+  expected_value_blue = (150.0 - 128.0) / 128.0;
+  first_index = 0;
+  last_index = 2;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  lut = gst_normalize_lut_get (mean, mean, mean, std, std, std);
+  fail_if (!gst_normalize_with_lut (&inframe, &outframe, lut, model_channels));
+  gst_normalize_lut_unref (lut);
+
+  gst_check_output_pixels (&outframe, expected_value_red, expected_value_green,
+      expected_value_blue, first_index, last_index, model_channels);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_with_lut_scaled)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  GstVideoFrame expectedframe;
+  GstNormalizeLut *lut;
+  gint width, height, buffer_size, offset, model_channels, size;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  guchar *pixel;
+  GstVideoFormat format;
+  gfloat *out, *expected;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 24;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGB;
+  offset = 0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+  gst_create_test_scaled_frame (&outframe, 7, 5, format);
+  gst_create_test_scaled_frame (&expectedframe, 7, 5, format);
+
+  /* A different second row, so the rows in between interpolate to
+   * values off the 8 bit steps
+   */
+  for (gint j = 0; j < width; ++j) {
+    pixel = (guchar *) GST_VIDEO_FRAME_PLANE_DATA (&inframe, 0) +
+        GST_VIDEO_FRAME_PLANE_STRIDE (&inframe, 0) + j * 3;
+    pixel[0] = 0;
+    pixel[1] = 55;
+    pixel[2] = 255;
+  }
+
+  lut = gst_normalize_lut_get (0, 0, 0, 1, 1, 1);
+  fail_if (!gst_normalize_with_lut (&inframe, &outframe, lut, model_channels));
+  gst_normalize_lut_unref (lut);
+
+  fail_if (!gst_normalize (&inframe, &expectedframe, 0, 1, model_channels));
+
+  /* The tables are looked up with the interpolation rounded to 8 bits */
+  out = (gfloat *) outframe.data[0];
+  expected = (gfloat *) expectedframe.data[0];
+  size = 7 * 5 * model_channels;
+  for (gint i = 0; i < size; ++i) {
+    fail_if (fabs (out[i] - floor (expected[i] + 0.5)) > 1e-4);
+  }
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_lut_shared)
+{
+  GstNormalizeLut *first;
+  GstNormalizeLut *second;
+  GstNormalizeLut *other;
+
+  first = gst_normalize_lut_get (128, 128, 128, 1 / 128.0, 1 / 128.0,
+      1 / 128.0);
+  second = gst_normalize_lut_get (128, 128, 128, 1 / 128.0, 1 / 128.0,
+      1 / 128.0);
+  other = gst_normalize_lut_get (0, 0, 0, 1 / 255.0, 1 / 255.0, 1 / 255.0);
+
+  fail_if (first != second);
+  fail_if (first == other);
+
+  gst_normalize_lut_unref (first);
+  gst_normalize_lut_unref (second);
+  gst_normalize_lut_unref (other);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_with_lut_null_lut)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, buffer_size, offset, model_channels;
+  guchar frame_pixel_value_red, frame_pixel_value_green, frame_pixel_value_blue;
+  GstVideoFormat format;
+
+  frame_pixel_value_red = 200;
+  frame_pixel_value_green = 100;
+  frame_pixel_value_blue = 150;
+  buffer_size = 32;
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_RGBA;
+  offset = 0;
+  model_channels = 3;
+
+  gst_create_test_frames (&inframe, &outframe, frame_pixel_value_red,
+      frame_pixel_value_green, frame_pixel_value_blue, buffer_size, width,
+      height, offset, format);
+
+  ASSERT_CRITICAL (gst_normalize_with_lut (&inframe, &outframe, NULL,
+          model_channels));
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_normalize_with_lut_suite (void)
+{
+  Suite *suite = suite_create ("GstInference");
+  TCase *tc = tcase_create ("gst_normalize_with_lut");
+
+  suite_add_tcase (suite, tc);
+
+  tcase_add_test (tc, test_gst_normalize_with_lut_RGBA);
+  tcase_add_test (tc, test_gst_normalize_with_lut_BGR);
+  tcase_add_test (tc, test_gst_normalize_with_lut_xRGB);
+  tcase_add_test (tc, test_gst_normalize_with_lut_scaled);
+  tcase_add_test (tc, test_gst_normalize_lut_shared);
+  tcase_add_test (tc, test_gst_normalize_with_lut_null_lut);
+
+  return suite;
+}
+
+GST_CHECK_MAIN (gst_normalize_with_lut);
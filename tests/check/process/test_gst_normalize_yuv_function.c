@@ -0,0 +1,181 @@
+/*
+ * GStreamer
+ * Copyright (C) 2019 RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include <math.h>
+#include "preprocess_functions_utils.c"
+#include "gst/r2inference/gstinferencepreprocess.h"
+
+/* The conversion is done in fixed point, allow for its rounding */
+static void
+check_output_pixels_near (GstVideoFrame * outframe, gfloat expected_value_red,
+    gfloat expected_value_green, gfloat expected_value_blue,
+    gfloat tolerance)
+{
+  gfloat *out = (gfloat *) outframe->data[0];
+  gint pixels = GST_VIDEO_FRAME_WIDTH (outframe) *
+      GST_VIDEO_FRAME_HEIGHT (outframe);
+
+  for (gint i = 0; i < pixels; ++i) {
+    fail_if (fabs (out[i * 3] - expected_value_red) > tolerance);
+    fail_if (fabs (out[i * 3 + 1] - expected_value_green) > tolerance);
+    fail_if (fabs (out[i * 3 + 2] - expected_value_blue) > tolerance);
+  }
+}
+
+GST_START_TEST (test_gst_pixel_to_float_NV12)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, model_channels;
+  GstVideoFormat format;
+
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_NV12;
+  model_channels = 3;
+
+  /* BT.601 limited range gray: 1.164 * (126 - 16) */
+  gst_create_test_yuv_frames (&inframe, &outframe, 126, 128, 128, width,
+      height, format);
+
+  fail_if (!gst_pixel_to_float (&inframe, &outframe, model_channels));
+
+  check_output_pixels_near (&outframe, 128, 128, 128, 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_pixel_to_float_I420)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, model_channels;
+  GstVideoFormat format;
+
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_I420;
+  model_channels = 3;
+
+  /* BT.601 limited range red */
+  gst_create_test_yuv_frames (&inframe, &outframe, 81, 90, 240, width,
+      height, format);
+
+  fail_if (!gst_pixel_to_float (&inframe, &outframe, model_channels));
+
+  check_output_pixels_near (&outframe, 254.4, 0, 0, 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_YUY2)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, model_channels;
+  gdouble mean, std;
+  GstVideoFormat format;
+
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_YUY2;
+  model_channels = 3;
+  mean = 128;
+  std = 1 / 128.0;
+
+  gst_create_test_yuv_frames (&inframe, &outframe, 126, 128, 128, width,
+      height, format);
+
+  fail_if (!gst_normalize (&inframe, &outframe, mean, std, model_channels));
+
+  check_output_pixels_near (&outframe, 0, 0, 0, 1 / 128.0);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_normalize_NV12_scaled)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, model_channels;
+  gdouble mean, std;
+  GstVideoFormat format;
+
+  width = 4;
+  height = 2;
+  format = GST_VIDEO_FORMAT_NV12;
+  model_channels = 3;
+  mean = 0;
+  std = 1;
+
+  gst_create_test_yuv_frames (&inframe, &outframe, 81, 90, 240, width,
+      height, format);
+  gst_create_test_scaled_frame (&outframe, 8, 6, GST_VIDEO_FORMAT_RGB);
+
+  fail_if (!gst_normalize (&inframe, &outframe, mean, std, model_channels));
+
+  check_output_pixels_near (&outframe, 254.4, 0, 0, 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_pixel_to_float_NV12_padded)
+{
+  GstVideoFrame inframe;
+  GstVideoFrame outframe;
+  gint width, height, padding, model_channels;
+  GstVideoFormat format;
+
+  width = 6;
+  height = 4;
+  padding = 10;
+  format = GST_VIDEO_FORMAT_NV12;
+  model_channels = 3;
+
+  /* Both planes at offsets and with strides other than the default */
+  gst_create_test_padded_frames (&inframe, &outframe, 126, 128, 128, width,
+      height, padding, format);
+
+  fail_if (!gst_pixel_to_float (&inframe, &outframe, model_channels));
+
+  check_output_pixels_near (&outframe, 128, 128, 128, 1);
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_normalize_yuv_suite (void)
+{
+  Suite *suite = suite_create ("GstInference");
+  TCase *tc = tcase_create ("gst_normalize_yuv");
+
+  suite_add_tcase (suite, tc);
+
+  tcase_add_test (tc, test_gst_pixel_to_float_NV12);
+  tcase_add_test (tc, test_gst_pixel_to_float_I420);
+  tcase_add_test (tc, test_gst_normalize_YUY2);
+  tcase_add_test (tc, test_gst_normalize_NV12_scaled);
+  tcase_add_test (tc, test_gst_pixel_to_float_NV12_padded);
+
+  return suite;
+}
+
+GST_CHECK_MAIN (gst_normalize_yuv);
@@ -0,0 +1,526 @@
+/*
+ * GStreamer
+ * Copyright (C) 2019 RidgeRun
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ *
+ */
+#include <gst/check/gstcheck.h>
+#include "gst/r2inference/gstinferencepostprocess.h"
+#include "gst/r2inference/gstinferencemeta.h"
+#include <string.h>
+
+#define CLASSES 2
+#define BOX_SIZE (5 + CLASSES)
+
+/* A 2x2 grid over a 64x64 input, so every cell is 32 pixels wide */
+static const GstYoloModel cell_model = {
+  64, 64, CLASSES, GST_YOLO_BOX_FORMAT_CELL, 1,
+  {
+        {2, 2, 1, {1.0, 2.0}},
+      }
+};
+
+static const GstYoloModel corners_model = {
+  64, 64, CLASSES, GST_YOLO_BOX_FORMAT_CORNERS, 1,
+  {
+        {2, 1, 1},
+      }
+};
+
+/* More boxes than a detection meta holds inline */
+static const GstYoloModel large_model = {
+  64, 64, CLASSES, GST_YOLO_BOX_FORMAT_CORNERS, 1,
+  {
+        {5, 4, 1},
+      }
+};
+
+/* Enough boxes for several words of the suppression mask */
+#define RANDOM_BOXES 256
+static const GstYoloModel random_model = {
+  64, 64, CLASSES, GST_YOLO_BOX_FORMAT_CORNERS, 1,
+  {
+        {16, 16, 1},
+      }
+};
+
+/* The 20 VOC classes, more than one block of class scores */
+#define VOC_CLASSES 20
+#define VOC_BOX_SIZE (5 + VOC_CLASSES)
+static const GstYoloModel voc_model = {
+  64, 64, VOC_CLASSES, GST_YOLO_BOX_FORMAT_CORNERS, 1,
+  {
+        {4, 1, 1},
+      }
+};
+
+static GstDetectionMeta *
+add_detection_meta (GstBuffer * buffer)
+{
+  return (GstDetectionMeta *) gst_buffer_add_meta (buffer,
+      GST_DETECTION_META_INFO, NULL);
+}
+
+GST_START_TEST (test_gst_yolo_decoder_cell)
+{
+  GstYoloDecoder *decoder;
+  GstBuffer *buffer;
+  GstDetectionMeta *meta;
+  gfloat prediction[4 * BOX_SIZE] = { 0 };
+  gfloat *box;
+
+  buffer = gst_buffer_new ();
+  meta = add_detection_meta (buffer);
+  decoder = gst_yolo_decoder_new (&cell_model);
+  fail_if (decoder == NULL);
+
+  /* The cell at row 1 and column 0, centered and with the anchor size */
+  box = prediction + 2 * BOX_SIZE;
+  box[4] = 0.9;
+  box[5] = 0.2;
+  box[6] = 0.7;
+
+  fail_unless (gst_yolo_decoder_create_boxes (decoder, prediction,
+          sizeof (prediction), meta, 0.5, 0.5, 0.5));
+
+  fail_unless_equals_int (meta->num_boxes, 1);
+  fail_unless_equals_int (meta->boxes[0].label, 1);
+  fail_unless_equals_float (meta->boxes[0].prob, 0.7f);
+  fail_unless_equals_float (meta->boxes[0].width, 32);
+  fail_unless_equals_float (meta->boxes[0].height, 64);
+  fail_unless_equals_float (meta->boxes[0].x, 0);
+  fail_unless_equals_float (meta->boxes[0].y, 16);
+
+  gst_yolo_decoder_free (decoder);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_yolo_decoder_corners)
+{
+  GstYoloDecoder *decoder;
+  GstBuffer *buffer;
+  GstDetectionMeta *meta;
+  gfloat prediction[2 * BOX_SIZE] = {
+    10, 20, 30, 60, 0.9, 0.8, 0.1,
+    12, 20, 32, 60, 0.9, 0.6, 0.1,
+  };
+
+  buffer = gst_buffer_new ();
+  meta = add_detection_meta (buffer);
+  decoder = gst_yolo_decoder_new (&corners_model);
+  fail_if (decoder == NULL);
+
+  /* Both boxes overlap, only the most probable one is kept */
+  fail_unless (gst_yolo_decoder_create_boxes (decoder, prediction,
+          sizeof (prediction), meta, 0.5, 0.5, 0.5));
+
+  fail_unless_equals_int (meta->num_boxes, 1);
+  fail_unless_equals_int (meta->boxes[0].label, 0);
+  fail_unless_equals_float (meta->boxes[0].prob, 0.8f);
+  fail_unless_equals_float (meta->boxes[0].x, 10);
+  fail_unless_equals_float (meta->boxes[0].y, 20);
+  fail_unless_equals_float (meta->boxes[0].width, 20);
+  fail_unless_equals_float (meta->boxes[0].height, 40);
+
+  gst_yolo_decoder_free (decoder);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_yolo_decoder_many_boxes)
+{
+  GstYoloDecoder *decoder;
+  GstBuffer *buffer;
+  GstDetectionMeta *meta;
+  gfloat prediction[20 * BOX_SIZE];
+  gfloat *box;
+  gint i;
+
+  decoder = gst_yolo_decoder_new (&large_model);
+
+  /* Separate boxes along a row, none of them is a duplicate */
+  for (i = 0; i < 20; i++) {
+    box = prediction + i * BOX_SIZE;
+    box[0] = 10 * i;
+    box[1] = 0;
+    box[2] = 10 * i + 5;
+    box[3] = 5;
+    box[4] = 0.9;
+    box[5] = 0.8;
+    box[6] = 0.1;
+  }
+
+  /* Decode twice, so the scratch memory of the decoder is reused */
+  for (i = 0; i < 2; i++) {
+    buffer = gst_buffer_new ();
+    meta = add_detection_meta (buffer);
+
+    fail_unless (gst_yolo_decoder_create_boxes (decoder, prediction,
+            sizeof (prediction), meta, 0.5, 0.5, 0.5));
+    fail_unless_equals_int (meta->num_boxes, 20);
+    fail_unless_equals_float (meta->boxes[19].x, 190);
+
+    gst_buffer_unref (buffer);
+  }
+
+  gst_yolo_decoder_free (decoder);
+}
+
+GST_END_TEST;
+
+/* The duplicate removal the decoder had before it used a sweep, every
+ * pair of boxes of a label is compared and the list is compacted after
+ * every suppression. The decoder must keep the same boxes in the same
+ * order.
+ */
+static gdouble
+reference_intersection_over_union (BBox box_1, BBox box_2)
+{
+  gdouble intersection_dim_1;
+  gdouble intersection_dim_2;
+  gdouble intersection_area;
+  gdouble union_area;
+
+  intersection_dim_1 =
+      MIN (box_1.x + box_1.width, box_2.x + box_2.width) - MAX (box_1.x,
+      box_2.x);
+  intersection_dim_2 =
+      MIN (box_1.y + box_1.height, box_2.y + box_2.height) - MAX (box_1.y,
+      box_2.y);
+
+  if ((intersection_dim_1 < 0) || (intersection_dim_2 < 0)) {
+    intersection_area = 0;
+  } else {
+    intersection_area = intersection_dim_1 * intersection_dim_2;
+  }
+  union_area = box_1.width * box_1.height + box_2.width * box_2.height -
+      intersection_area;
+  return intersection_area / union_area;
+}
+
+static void
+reference_delete_box (BBox * boxes, gint * num_boxes, gint index)
+{
+  gint i;
+
+  for (i = index; i < *num_boxes - 1; i++) {
+    boxes[i] = boxes[i + 1];
+  }
+  *num_boxes -= 1;
+}
+
+static void
+reference_remove_duplicated_boxes (gfloat iou_thresh, BBox * boxes,
+    gint * num_boxes)
+{
+  gdouble iou;
+  gint it1, it2;
+
+  for (it1 = 0; it1 < *num_boxes - 1; it1++) {
+    for (it2 = it1 + 1; it2 < *num_boxes; it2++) {
+      if (boxes[it1].label == boxes[it2].label) {
+        iou = reference_intersection_over_union (boxes[it1], boxes[it2]);
+        if (iou > iou_thresh) {
+          if (boxes[it1].prob > boxes[it2].prob) {
+            reference_delete_box (boxes, num_boxes, it2);
+            it2--;
+          } else {
+            reference_delete_box (boxes, num_boxes, it1);
+            it1--;
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+static guint32
+random_next (guint32 * seed, guint32 range)
+{
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 16) % range;
+}
+
+GST_START_TEST (test_gst_yolo_decoder_duplicates_reference)
+{
+  GstYoloDecoder *decoder;
+  GstBuffer *buffer;
+  GstDetectionMeta *meta;
+  gfloat prediction[RANDOM_BOXES * BOX_SIZE];
+  BBox expected[RANDOM_BOXES];
+  gfloat thresholds[] = { 0.5, 0.3, 0, 1, -0.5 };
+  /* Few distinct probabilities, so many duplicates tie */
+  gfloat probs[] = { 0.6, 0.7, 0.8, 0.9 };
+  guint32 seed = 7;
+  gfloat *box;
+  gint num_expected, centers, spread, i;
+
+  decoder = gst_yolo_decoder_new (&random_model);
+
+  for (gint run = 0; run < 100; run++) {
+    gfloat iou_thresh = thresholds[run % G_N_ELEMENTS (thresholds)];
+
+    /* From a few crowded spots to boxes spread over the whole input */
+    centers = 1 + random_next (&seed, 8);
+    spread = 1 + random_next (&seed, 16);
+
+    for (i = 0; i < RANDOM_BOXES; i++) {
+      gfloat x, y;
+      gint label = random_next (&seed, CLASSES);
+      gint center = random_next (&seed, centers);
+
+      box = prediction + i * BOX_SIZE;
+      x = (center * 23) % 56 + random_next (&seed, spread);
+      y = (center * 37) % 56 + random_next (&seed, spread);
+      box[0] = x;
+      box[1] = y;
+      box[2] = x + random_next (&seed, 12);
+      box[3] = y + random_next (&seed, 12);
+      /* Some cells hold no object */
+      box[4] = random_next (&seed, 10) ? 0.9 : 0;
+      box[5 + label] = probs[random_next (&seed, G_N_ELEMENTS (probs))];
+      box[5 + (label + 1) % CLASSES] = 0.1;
+    }
+
+    /* No box is above this threshold, all of them are kept */
+    buffer = gst_buffer_new ();
+    meta = add_detection_meta (buffer);
+    fail_unless (gst_yolo_decoder_create_boxes (decoder, prediction,
+            sizeof (prediction), meta, 0.5, 0.5, G_MAXFLOAT));
+    num_expected = meta->num_boxes;
+    memcpy (expected, meta->boxes, num_expected * sizeof (BBox));
+    gst_buffer_unref (buffer);
+
+    reference_remove_duplicated_boxes (iou_thresh, expected, &num_expected);
+
+    buffer = gst_buffer_new ();
+    meta = add_detection_meta (buffer);
+    fail_unless (gst_yolo_decoder_create_boxes (decoder, prediction,
+            sizeof (prediction), meta, 0.5, 0.5, iou_thresh));
+
+    fail_unless_equals_int (meta->num_boxes, num_expected);
+    for (i = 0; i < num_expected; i++) {
+      fail_unless_equals_int (meta->boxes[i].label, expected[i].label);
+      fail_unless (meta->boxes[i].prob == expected[i].prob);
+      fail_unless (meta->boxes[i].x == expected[i].x);
+      fail_unless (meta->boxes[i].y == expected[i].y);
+      fail_unless (meta->boxes[i].width == expected[i].width);
+      fail_unless (meta->boxes[i].height == expected[i].height);
+    }
+
+    gst_buffer_unref (buffer);
+  }
+
+  gst_yolo_decoder_free (decoder);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_yolo_decoder_classes)
+{
+  GstYoloDecoder *decoder;
+  GstBuffer *buffer;
+  GstDetectionMeta *meta;
+  gfloat prediction[4 * VOC_BOX_SIZE] = { 0 };
+  gint i;
+
+  decoder = gst_yolo_decoder_new (&voc_model);
+
+  /* Separate boxes with their best class in the first block, in the
+   * classes after the last block, in a later block and none at all
+   */
+  for (i = 0; i < 4; i++) {
+    gfloat *box = prediction + i * VOC_BOX_SIZE;
+
+    box[0] = 16 * i;
+    box[2] = 16 * i + 8;
+    box[3] = 8;
+    box[4] = 0.9;
+  }
+  prediction[5 + 3] = 0.6;
+  prediction[5 + 2] = 0.2;
+  prediction[VOC_BOX_SIZE + 5 + 19] = 0.7;
+  prediction[2 * VOC_BOX_SIZE + 5 + 12] = 0.8;
+  prediction[2 * VOC_BOX_SIZE + 5 + 10] = 0.1;
+
+  buffer = gst_buffer_new ();
+  meta = add_detection_meta (buffer);
+  fail_unless (gst_yolo_decoder_create_boxes (decoder, prediction,
+          sizeof (prediction), meta, 0.5, 0.5, 0.5));
+
+  fail_unless_equals_int (meta->num_boxes, 3);
+  fail_unless_equals_int (meta->boxes[0].label, 3);
+  fail_unless_equals_float (meta->boxes[0].prob, 0.6f);
+  fail_unless_equals_int (meta->boxes[1].label, 19);
+  fail_unless_equals_float (meta->boxes[1].prob, 0.7f);
+  fail_unless_equals_int (meta->boxes[2].label, 12);
+  fail_unless_equals_float (meta->boxes[2].prob, 0.8f);
+  gst_buffer_unref (buffer);
+
+  /* A negative threshold also reports the box without a class */
+  buffer = gst_buffer_new ();
+  meta = add_detection_meta (buffer);
+  fail_unless (gst_yolo_decoder_create_boxes (decoder, prediction,
+          sizeof (prediction), meta, 0.5, -0.1, 0.5));
+
+  fail_unless_equals_int (meta->num_boxes, 4);
+  fail_unless_equals_int (meta->boxes[3].label, 0);
+  fail_unless_equals_float (meta->boxes[3].prob, 0);
+  gst_buffer_unref (buffer);
+
+  gst_yolo_decoder_free (decoder);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_yolo_decoder_short_prediction)
+{
+  GstYoloDecoder *decoder;
+  GstBuffer *buffer;
+  GstDetectionMeta *meta;
+  gfloat prediction[2 * BOX_SIZE] = { 0 };
+
+  buffer = gst_buffer_new ();
+  meta = add_detection_meta (buffer);
+  decoder = gst_yolo_decoder_new (&corners_model);
+
+  fail_if (gst_yolo_decoder_create_boxes (decoder, prediction,
+          sizeof (prediction) - sizeof (gfloat), meta, 0.5, 0.5, 0.5));
+  fail_unless_equals_int (meta->num_boxes, 0);
+
+  gst_yolo_decoder_free (decoder);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_yolo_decoder_null_decoder)
+{
+  GstBuffer *buffer;
+  GstDetectionMeta *meta;
+  gfloat prediction[2 * BOX_SIZE] = { 0 };
+
+  buffer = gst_buffer_new ();
+  meta = add_detection_meta (buffer);
+
+  ASSERT_CRITICAL (gst_yolo_decoder_create_boxes (NULL, prediction,
+          sizeof (prediction), meta, 0.5, 0.5, 0.5));
+
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_yolo_decoder_too_large)
+{
+  GstYoloDecoder *decoder = NULL;
+  GstYoloModel model;
+
+  model = cell_model;
+  model.classes = GST_YOLO_MAX_CLASSES + 1;
+  ASSERT_CRITICAL (decoder = gst_yolo_decoder_new (&model));
+  fail_if (decoder != NULL);
+
+  model = cell_model;
+  model.input_width = GST_YOLO_MAX_INPUT_SIZE + 1;
+  ASSERT_CRITICAL (decoder = gst_yolo_decoder_new (&model));
+  fail_if (decoder != NULL);
+
+  model = cell_model;
+  model.grids[0].height = GST_YOLO_MAX_GRID_SIZE + 1;
+  ASSERT_CRITICAL (decoder = gst_yolo_decoder_new (&model));
+  fail_if (decoder != NULL);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_yolo_model_set_grids)
+{
+  GstYoloModel model = { 64, 64, CLASSES, GST_YOLO_BOX_FORMAT_CELL };
+
+  fail_unless (gst_yolo_model_set_grids (&model, "2x2", "1,2"));
+  fail_unless_equals_int (model.num_grids, 1);
+  fail_if (memcmp (&model.grids[0], &cell_model.grids[0],
+          sizeof (GstYoloGrid)));
+
+  fail_unless (gst_yolo_model_set_grids (&model, "13x13; 26x13",
+          "1, 2, 3, 4;0.5,1"));
+  fail_unless_equals_int (model.num_grids, 2);
+  fail_unless_equals_int (model.grids[0].width, 13);
+  fail_unless_equals_int (model.grids[0].height, 13);
+  fail_unless_equals_int (model.grids[0].num_anchors, 2);
+  fail_unless_equals_float (model.grids[0].anchors[3], 4);
+  fail_unless_equals_int (model.grids[1].width, 26);
+  fail_unless_equals_int (model.grids[1].height, 13);
+  fail_unless_equals_int (model.grids[1].num_anchors, 1);
+  fail_unless_equals_float (model.grids[1].anchors[0], 0.5);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_gst_yolo_model_set_grids_invalid)
+{
+  GstYoloModel model = cell_model;
+
+  /* One group of anchors per grid */
+  fail_if (gst_yolo_model_set_grids (&model, "13x13;26x26", "1,2"));
+  /* Anchors in width and height pairs */
+  fail_if (gst_yolo_model_set_grids (&model, "13x13", "1,2,3"));
+  fail_if (gst_yolo_model_set_grids (&model, "13", "1,2"));
+  fail_if (gst_yolo_model_set_grids (&model, "13x0", "1,2"));
+  /* Sizes out of range, including the ones that wrap around a gint */
+  fail_if (gst_yolo_model_set_grids (&model, "1025x1", "1,2"));
+  fail_if (gst_yolo_model_set_grids (&model, "4294967297x1", "1,2"));
+  fail_if (gst_yolo_model_set_grids (&model, "1x-4294967295", "1,2"));
+  fail_if (gst_yolo_model_set_grids (&model, "13x13", "1,a"));
+  fail_if (gst_yolo_model_set_grids (&model, "", ""));
+  fail_if (gst_yolo_model_set_grids (&model, "1x1;1x1;1x1;1x1",
+          "1,1;1,1;1,1;1,1"));
+
+  /* Failures leave the model as it was */
+  fail_if (memcmp (&model, &cell_model, sizeof (GstYoloModel)));
+}
+
+GST_END_TEST;
+
+static Suite *
+gst_yolo_decoder_suite (void)
+{
+  Suite *suite = suite_create ("GstInference");
+  TCase *tc = tcase_create ("gst_yolo_decoder");
+
+  suite_add_tcase (suite, tc);
+
+  tcase_add_test (tc, test_gst_yolo_decoder_cell);
+  tcase_add_test (tc, test_gst_yolo_decoder_corners);
+  tcase_add_test (tc, test_gst_yolo_decoder_many_boxes);
+  tcase_add_test (tc, test_gst_yolo_decoder_duplicates_reference);
+  tcase_add_test (tc, test_gst_yolo_decoder_classes);
+  tcase_add_test (tc, test_gst_yolo_decoder_short_prediction);
+  tcase_add_test (tc, test_gst_yolo_decoder_null_decoder);
+  tcase_add_test (tc, test_gst_yolo_decoder_too_large);
+  tcase_add_test (tc, test_gst_yolo_model_set_grids);
+  tcase_add_test (tc, test_gst_yolo_model_set_grids_invalid);
+
+  return suite;
+}
+
+GST_CHECK_MAIN (gst_yolo_decoder);